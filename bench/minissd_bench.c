@@ -0,0 +1,1459 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "minissd.h"
+
+#include <stdlib.h>
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef NAME_MAX
+#define NAME_MAX 255
+#endif
+#endif
+
+#define SCHEMA_BLOCKS 4000
+#define REPETITIONS 5
+
+typedef struct Buffer
+{
+    char*  data;
+    size_t length;
+    size_t capacity;
+} Buffer;
+
+static void
+append(Buffer* b, const char* s)
+{
+    size_t len = strlen(s);
+    if (b->length + len + 1 > b->capacity)
+    {
+        b->capacity = (b->length + len + 1) * 2;
+        b->data     = (char*)realloc(b->data, b->capacity);
+    }
+    memcpy(b->data + b->length, s, len + 1);
+    b->length += len;
+}
+
+// Builds an attribute-heavy schema made of `blocks` enums, data and services
+static char*
+generate_schema(size_t blocks, size_t* length)
+{
+    Buffer b = { 0 };
+    char   line[256];
+    for (size_t i = 0; i < blocks; i++)
+    {
+        snprintf(line, sizeof(line), "import lib::module%zu::Thing;\n", i);
+        append(&b, line);
+
+        snprintf(line, sizeof(line), "#[repr(C)]\nenum Kind%zu {\n", i);
+        append(&b, line);
+        append(&b, "    First,\n    Second = 42,\n    Third,\n};\n\n");
+
+        snprintf(line, sizeof(line), "#[table(name=\"table_%zu\")]\n", i);
+        append(&b, line);
+        snprintf(line, sizeof(line), "data Record%zu {\n", i);
+        append(&b, line);
+        append(&b,
+               "    // primary key\n"
+               "    #[column(name=\"id\", type=\"int\")]\n"
+               "    id: int,\n"
+               "    #[column(name=\"name\", type=\"string\")]\n"
+               "    name: string,\n"
+               "    #[column(name=\"tags\")]\n"
+               "    tags: list of string,\n"
+               "    hash: 32 of byte,\n");
+        snprintf(line, sizeof(line), "    kind: Kind%zu,\n};\n\n", i);
+        append(&b, line);
+
+        snprintf(line, sizeof(line), "service Service%zu {\n", i);
+        append(&b, line);
+        append(&b,
+               "    depends on lib::storage;\n"
+               "    #[cached]\n"
+               "    fn get(id: int) -> Record;\n"
+               "    fn put(#[validate] record: Record, force: bool);\n"
+               "    event changed(id: int);\n"
+               "};\n\n");
+    }
+    *length = b.length;
+    return b.data;
+}
+
+static double
+now_seconds(void)
+{
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+static void
+bench_arena(const char* source, size_t length)
+{
+    const unsigned modes[] = { MINISSD_PARSE_DEFAULT,
+                               MINISSD_PARSE_ARENA,
+                               MINISSD_PARSE_ZERO_COPY,
+                               MINISSD_PARSE_ARENA | MINISSD_PARSE_ZERO_COPY };
+    const char*    names[] = { "heap", "arena", "views", "arena+views" };
+
+    printf("arena: %zu bytes of input\n", length);
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+    {
+        double best_parse  = 0;
+        double best_free   = 0;
+        size_t allocations = 0;
+        for (int r = 0; r < REPETITIONS; r++)
+        {
+            double  start = now_seconds();
+            Parser* p     = minissd_create_parser(source);
+            minissd_set_parser_flags(p, modes[m]);
+            AstNode* ast    = minissd_parse(p);
+            double   parsed = now_seconds();
+            if (!ast)
+            {
+                printf("  %s: %s\n", names[m], p->error);
+                minissd_free_parser(p);
+                return;
+            }
+            allocations = p->allocation_count + p->owned_arena.block_count;
+            minissd_free_ast(ast);
+            minissd_free_parser(p);
+            double freed = now_seconds();
+            if (r == 0 || parsed - start < best_parse)
+            {
+                best_parse = parsed - start;
+            }
+            if (r == 0 || freed - parsed < best_free)
+            {
+                best_free = freed - parsed;
+            }
+        }
+        printf("  %-12s %10zu allocations %9.2f ms parse %9.3f ms free\n",
+               names[m],
+               allocations,
+               best_parse * 1000.0,
+               best_free * 1000.0);
+    }
+}
+
+typedef struct NameStats
+{
+    size_t count;
+    size_t bytes;
+} NameStats;
+
+static void
+count_name(NameStats* stats, size_t length)
+{
+    stats->count++;
+    stats->bytes += length + 1;
+}
+
+static void
+count_attributes(NameStats* stats, Attribute const* attr)
+{
+    for (; attr; attr = minissd_get_next_attribute(attr))
+    {
+        count_name(stats, minissd_get_attribute_name_length(attr));
+        for (AttributeParameter const* param =
+                 minissd_get_attribute_parameters(attr);
+             param;
+             param = minissd_get_next_attribute_parameter(param))
+        {
+            count_name(stats,
+                       minissd_get_attribute_parameter_name_length(param));
+        }
+    }
+}
+
+static void
+count_arguments(NameStats* stats, Argument const* arg)
+{
+    for (; arg; arg = minissd_get_next_argument(arg))
+    {
+        count_attributes(stats, minissd_get_argument_attributes(arg));
+        count_name(stats, minissd_get_argument_name_length(arg));
+        Type const* type = minissd_get_argument_type(arg);
+        count_name(stats, minissd_get_type_name_length(type));
+    }
+}
+
+// Counts every identifier, path, type name and attribute name/key
+static NameStats
+count_names(AstNode const* ast)
+{
+    NameStats stats = { 0 };
+    for (AstNode const* node = ast; node; node = minissd_get_next_node(node))
+    {
+        count_attributes(&stats, minissd_get_attributes(node));
+        switch (*minissd_get_node_type(node))
+        {
+        case NODE_IMPORT:
+            count_name(&stats, minissd_get_import_path_length(node));
+            break;
+        case NODE_DATA:
+            count_name(&stats, minissd_get_data_name_length(node));
+            for (Property const* prop = minissd_get_properties(node); prop;
+                 prop                 = minissd_get_next_property(prop))
+            {
+                count_attributes(&stats, minissd_get_property_attributes(prop));
+                count_name(&stats, minissd_get_property_name_length(prop));
+                count_name(&stats,
+                           minissd_get_type_name_length(
+                               minissd_get_property_type(prop)));
+            }
+            break;
+        case NODE_ENUM:
+            count_name(&stats, minissd_get_enum_name_length(node));
+            for (EnumVariant const* variant = minissd_get_enum_variants(node);
+                 variant;
+                 variant = minissd_get_next_enum_variant(variant))
+            {
+                count_attributes(&stats,
+                                 minissd_get_enum_variant_attributes(variant));
+                count_name(&stats,
+                           minissd_get_enum_variant_name_length(variant));
+            }
+            break;
+        case NODE_SERVICE:
+            count_name(&stats, minissd_get_service_name_length(node));
+            for (Dependency const* dep = minissd_get_dependencies(node); dep;
+                 dep                   = minissd_get_next_dependency(dep))
+            {
+                count_attributes(&stats, dep->opt_ll_attributes);
+                count_name(&stats, minissd_get_dependency_path_length(dep));
+            }
+            for (Handler const* handler = minissd_get_handlers(node); handler;
+                 handler = minissd_get_next_handler(handler))
+            {
+                count_attributes(&stats,
+                                 minissd_get_handler_attributes(handler));
+                count_name(&stats, minissd_get_handler_name_length(handler));
+                count_arguments(&stats, minissd_get_handler_arguments(handler));
+                Type const* ret = minissd_get_handler_return_type(handler);
+                if (ret)
+                {
+                    count_name(&stats, minissd_get_type_name_length(ret));
+                }
+            }
+            for (Event const* event = minissd_get_events(node); event;
+                 event              = minissd_get_next_event(event))
+            {
+                count_attributes(&stats, event->opt_ll_attributes);
+                count_name(&stats, minissd_get_event_name_length(event));
+                count_arguments(&stats, minissd_get_event_arguments(event));
+            }
+            break;
+        }
+    }
+    return stats;
+}
+
+// Counts properties typed `string`, comparing by content or by pointer
+static size_t
+count_string_properties(AstNode const* ast, char const* interned)
+{
+    size_t matches = 0;
+    for (AstNode const* node = ast; node; node = minissd_get_next_node(node))
+    {
+        for (Property const* prop = minissd_get_properties(node); prop;
+             prop                 = minissd_get_next_property(prop))
+        {
+            char const* name =
+                minissd_get_type_name(minissd_get_property_type(prop));
+            if (interned ? name == interned : strcmp(name, "string") == 0)
+            {
+                matches++;
+            }
+        }
+    }
+    return matches;
+}
+
+static void
+bench_intern(const char* source, size_t length)
+{
+    printf("intern: %zu bytes of input\n", length);
+
+    Parser*  copied     = minissd_create_parser(source);
+    AstNode* copied_ast = minissd_parse(copied);
+    Parser*  interned   = minissd_create_parser(source);
+    minissd_set_parser_flags(interned, MINISSD_PARSE_INTERN);
+    AstNode* interned_ast = minissd_parse(interned);
+    if (!copied_ast || !interned_ast)
+    {
+        printf("  parse failed\n");
+        return;
+    }
+
+    NameStats names        = count_names(copied_ast);
+    size_t    unique_bytes = 0;
+    for (size_t id = 0; id < minissd_intern_count(interned); id++)
+    {
+        unique_bytes += strlen(minissd_intern_string(interned, (int)id)) + 1;
+    }
+    printf("  copied   %8zu names %9zu bytes\n", names.count, names.bytes);
+    printf("  interned %8zu names %9zu bytes\n",
+           minissd_intern_count(interned),
+           unique_bytes);
+
+    char const* string_name = minissd_intern_string(
+        interned, minissd_intern_lookup(interned, "string", 6));
+    size_t matches = 0;
+    double start   = now_seconds();
+    for (int r = 0; r < 100; r++)
+    {
+        matches += count_string_properties(copied_ast, NULL);
+    }
+    double compared = now_seconds();
+    for (int r = 0; r < 100; r++)
+    {
+        matches += count_string_properties(interned_ast, string_name);
+    }
+    double done = now_seconds();
+    printf("  100 type scans: strcmp %.2f ms, pointer %.2f ms (%zu matches)\n",
+           (compared - start) * 1000.0,
+           (done - compared) * 1000.0,
+           matches);
+
+    minissd_free_ast(copied_ast);
+    minissd_free_parser(copied);
+    minissd_free_ast(interned_ast);
+    minissd_free_parser(interned);
+}
+
+// Best of three parses, in seconds
+static double
+parse_seconds(const char* source)
+{
+    double best = 0;
+    for (int run = 0; run < 3; run++)
+    {
+        double   start  = now_seconds();
+        Parser*  parser = minissd_create_parser(source);
+        AstNode* ast    = minissd_parse(parser);
+        double   took   = now_seconds() - start;
+        minissd_free_ast(ast);
+        minissd_free_parser(parser);
+        if (run == 0 || took < best)
+        {
+            best = took;
+        }
+    }
+    return best;
+}
+
+// Parses a 16th of the input and the whole input. A linear parser spends
+// the same time per byte on both, a quadratic one about 16 times as much
+static void
+bench_scaling(const char* source, size_t length)
+{
+    size_t small_length = 0;
+    char*  small        = generate_schema(SCHEMA_BLOCKS / 16, &small_length);
+    printf("scaling: %zu and %zu bytes of input\n", small_length, length);
+
+    double small_time = parse_seconds(small);
+    double large_time = parse_seconds(source);
+    printf("  %.2f ns/byte small, %.2f ns/byte large, ratio %.2f\n",
+           small_time * 1e9 / small_length,
+           large_time * 1e9 / length,
+           (large_time / length) / (small_time / small_length));
+    free(small);
+}
+
+// The position lookup error() used to perform
+static int
+scan_line(const char* source, size_t offset)
+{
+    int line = 1;
+    for (size_t i = 0; i < offset; i++)
+    {
+        if (source[i] == '\n')
+        {
+            line++;
+        }
+    }
+    return line;
+}
+
+static void
+bench_lines(const char* source, size_t length)
+{
+    const size_t lookups = 1000;
+
+    printf("lines: %zu bytes of input, %zu lookups\n", length, lookups);
+    Parser* p = minissd_create_parser(source);
+
+    long   checksum = 0;
+    double start    = now_seconds();
+    for (size_t i = 0; i < lookups; i++)
+    {
+        checksum += scan_line(source, (i * 7919) % length);
+    }
+    double scanned = now_seconds();
+    for (size_t i = 0; i < lookups; i++)
+    {
+        int line = 0;
+        minissd_offset_to_line_col(p, (i * 7919) % length, &line, NULL);
+        checksum -= line;
+    }
+    double indexed = now_seconds();
+
+    printf("  prefix scan %9.3f ms\n  line index  %9.3f ms (incl. build)\n",
+           (scanned - start) * 1000.0,
+           (indexed - scanned) * 1000.0);
+    if (checksum != 0)
+    {
+        printf("  mismatch between scan and index\n");
+    }
+    minissd_free_parser(p);
+}
+
+static void
+bench_lexer(const char* source, size_t length)
+{
+    printf("lexer: %zu bytes of input\n", length);
+
+    double best_lex   = 0;
+    double best_parse = 0;
+    size_t tokens     = 0;
+    for (int r = 0; r < REPETITIONS; r++)
+    {
+        double start = now_seconds();
+        Lexer  lexer;
+        minissd_init_lexer(&lexer, source, length);
+        tokens = 0;
+        while (minissd_next_token(&lexer).kind != MINISSD_TOKEN_EOF)
+        {
+            tokens++;
+        }
+        double lexed = now_seconds();
+
+        Parser* p = minissd_create_parser_n(source, length);
+        minissd_set_parser_flags(
+            p, MINISSD_PARSE_ARENA | MINISSD_PARSE_ZERO_COPY);
+        AstNode* ast    = minissd_parse(p);
+        double   parsed = now_seconds();
+        minissd_free_ast(ast);
+        minissd_free_parser(p);
+
+        if (r == 0 || lexed - start < best_lex)
+        {
+            best_lex = lexed - start;
+        }
+        if (r == 0 || parsed - lexed < best_parse)
+        {
+            best_parse = parsed - lexed;
+        }
+    }
+    printf("  %zu tokens, lex %.2f ms (%.0f MB/s), lex+parse %.2f ms\n",
+           tokens,
+           best_lex * 1000.0,
+           length / best_lex / 1e6,
+           best_parse * 1000.0);
+}
+
+// Byte-at-a-time tokenizer with ctype calls, like the scanner used to be
+static size_t
+count_tokens_bytewise(const char* s, size_t length)
+{
+    size_t tokens = 0;
+    size_t i      = 0;
+    while (i < length)
+    {
+        if (isspace((unsigned char)s[i]))
+        {
+            i++;
+        }
+        else if (s[i] == '/' && i + 1 < length && s[i + 1] == '/')
+        {
+            while (i < length && s[i] != '\n')
+            {
+                i++;
+            }
+        }
+        else if (isalnum((unsigned char)s[i]) || s[i] == '_')
+        {
+            while (i < length && (isalnum((unsigned char)s[i]) || s[i] == '_'))
+            {
+                i++;
+            }
+            tokens++;
+        }
+        else if (s[i] == '"')
+        {
+            for (i++; i < length && s[i] != '"'; i++)
+            {
+            }
+            i++;
+            tokens++;
+        }
+        else
+        {
+            i++;
+            tokens++;
+        }
+    }
+    return tokens;
+}
+
+static size_t
+count_tokens(const char* source, size_t length, ScanKernels kernels)
+{
+    Lexer lexer;
+    minissd_init_lexer(&lexer, source, length);
+    lexer.kernels = kernels;
+    size_t tokens = 0;
+    while (minissd_next_token(&lexer).kind != MINISSD_TOKEN_EOF)
+    {
+        tokens++;
+    }
+    return tokens;
+}
+
+static void
+scan_input(const char* label, const char* source, size_t length)
+{
+    const char* names[] = { "scalar", "sse2", "avx2" };
+
+    printf("  %s: %zu bytes\n", label, length);
+    for (int k = -1; k <= (int)minissd_detect_scan_kernels(); k++)
+    {
+        double best   = 0;
+        size_t tokens = 0;
+        for (int r = 0; r < REPETITIONS; r++)
+        {
+            double start = now_seconds();
+            tokens       = k < 0 ? count_tokens_bytewise(source, length)
+                                 : count_tokens(source, length, (ScanKernels)k);
+            double done  = now_seconds();
+            if (r == 0 || done - start < best)
+            {
+                best = done - start;
+            }
+        }
+        printf("    %-8s %8zu tokens %8.2f ms %8.0f MB/s\n",
+               k < 0 ? "bytewise" : names[k],
+               tokens,
+               best * 1000.0,
+               length / best / 1e6);
+    }
+}
+
+// Long doc comments, indentation and embedded SQL in attribute values
+static char*
+generate_documented_schema(size_t blocks, size_t* length)
+{
+    Buffer b = { 0 };
+    char   line[256];
+    for (size_t i = 0; i < blocks; i++)
+    {
+        append(&b,
+               "        // Rows are written by the ingest job and read by the "
+               "reporting service, keep the column order stable.\n"
+               "        #[query(sql=\"SELECT id, name, created_at, updated_at "
+               "FROM records WHERE owner_id = ? AND deleted_at IS NULL "
+               "ORDER BY created_at DESC LIMIT 100\")]\n");
+        snprintf(line,
+                 sizeof(line),
+                 "        data DocumentedRecordWithAVeryLongName%zu {\n"
+                 "                identifier_of_the_record: int\n"
+                 "        };\n\n",
+                 i);
+        append(&b, line);
+    }
+    *length = b.length;
+    return b.data;
+}
+
+static void
+bench_scan(const char* source, size_t length)
+{
+    printf("scan:\n");
+    scan_input("schema", source, length);
+
+    size_t documented_length = 0;
+    char*  documented =
+        generate_documented_schema(length / 300, &documented_length);
+    scan_input("documented", documented, documented_length);
+    free(documented);
+}
+
+// Sums what a generator reads from every property: name and type
+static size_t
+walk_linked_properties(AstNode const* ast)
+{
+    size_t sum = 0;
+    for (AstNode const* node = ast; node; node = minissd_get_next_node(node))
+    {
+        for (Property const* prop = minissd_get_properties(node); prop;
+             prop                 = minissd_get_next_property(prop))
+        {
+            Type const* type = minissd_get_property_type(prop);
+            sum += minissd_get_property_name_length(prop) +
+                   minissd_get_type_name_length(type) +
+                   minissd_get_type_is_list(type);
+        }
+    }
+    return sum;
+}
+
+static size_t
+walk_flat_properties(FlatAst const* flat)
+{
+    size_t sum = 0;
+    for (uint32_t i = 0; i < flat->property_count; i++)
+    {
+        FlatProperty const* prop = &flat->properties[i];
+        sum += prop->name.length + prop->type.name.length + prop->type.is_list;
+    }
+    return sum;
+}
+
+static void
+bench_flat(const char* source, size_t length)
+{
+    printf("flat: %zu bytes of input\n", length);
+
+    Parser*  parser = minissd_create_parser(source);
+    AstNode* ast    = minissd_parse(parser);
+    if (!ast)
+    {
+        printf("  parse failed\n");
+        return;
+    }
+
+    double   start     = now_seconds();
+    FlatAst* flat      = minissd_flatten_ast(ast);
+    double   flattened = now_seconds();
+    printf("  flatten %.2f ms, %u nodes %u properties %u string bytes\n",
+           (flattened - start) * 1000.0,
+           flat->node_count,
+           flat->property_count,
+           flat->string_size);
+
+    size_t sum = 0;
+    start      = now_seconds();
+    for (int r = 0; r < 100; r++)
+    {
+        sum += walk_linked_properties(ast);
+    }
+    double linked = now_seconds();
+    for (int r = 0; r < 100; r++)
+    {
+        sum += walk_flat_properties(flat);
+    }
+    double done = now_seconds();
+    printf("  100 property walks: linked %.2f ms, flat %.2f ms (%zu)\n",
+           (linked - start) * 1000.0,
+           (done - linked) * 1000.0,
+           sum);
+
+    minissd_free_flat_ast(flat);
+    minissd_free_ast(ast);
+    minissd_free_parser(parser);
+}
+
+static bool
+count_column(void* userdata, StringView name)
+{
+    bool column = name.length == 6 && memcmp(name.data, "column", 6) == 0;
+    *(size_t*)userdata += column;
+    return true;
+}
+
+// Counts the #[column] attributes of properties, from an AST and from events
+static void
+bench_events(const char* source, size_t length)
+{
+    printf("events: %zu bytes of input\n", length);
+
+    double   start   = now_seconds();
+    size_t   columns = 0;
+    Parser*  parser  = minissd_create_parser(source);
+    AstNode* ast     = minissd_parse(parser);
+    for (AstNode const* node = ast; node; node = node->next)
+    {
+        Property const* property = minissd_get_properties(node);
+        for (; property; property = property->next)
+        {
+            Attribute const* attribute = property->attributes;
+            for (; attribute; attribute = attribute->next)
+            {
+                columns += strcmp(attribute->name, "column") == 0;
+            }
+        }
+    }
+    minissd_free_ast(ast);
+    minissd_free_parser(parser);
+    double tree = now_seconds() - start;
+
+    ParseCallbacks callbacks = { 0 };
+    size_t         events    = 0;
+    callbacks.on_attribute   = count_column;
+
+    start   = now_seconds();
+    parser  = minissd_create_parser(source);
+    bool ok = minissd_parse_events(parser, &callbacks, &events);
+    minissd_free_parser(parser);
+    double streamed = now_seconds() - start;
+
+    printf("  AST %.2f ms, events %.2f ms, %zu / %zu columns%s\n",
+           tree * 1000.0,
+           streamed * 1000.0,
+           columns,
+           events,
+           ok ? "" : " (failed)");
+}
+
+// Feeds the input in 4 KiB pieces, as if read from a pipe
+static void
+bench_push(const char* source, size_t length)
+{
+    printf("push: %zu bytes of input\n", length);
+
+    double   start  = now_seconds();
+    Parser*  parser = minissd_create_parser(source);
+    AstNode* ast    = minissd_parse(parser);
+    minissd_free_ast(ast);
+    minissd_free_parser(parser);
+    double whole = now_seconds() - start;
+
+    size_t nodes = 0;
+    bool   ok    = true;
+    start        = now_seconds();
+    parser       = minissd_create_push_parser();
+    for (size_t i = 0; ok && i <= length; i += 4096)
+    {
+        size_t size = length - i < 4096 ? length - i : 4096;
+        ok          = minissd_parser_feed(parser, source + i, size);
+        if (ok && i + 4096 > length)
+        {
+            ok = minissd_parser_finish(parser);
+        }
+        for (AstNode* node; (node = minissd_parser_next_node(parser));)
+        {
+            minissd_free_ast(node);
+            nodes++;
+        }
+    }
+    minissd_free_parser(parser);
+    double pushed = now_seconds() - start;
+
+    printf("  whole input %.2f ms, 4 KiB pieces %.2f ms, %zu nodes%s\n",
+           whole * 1000.0,
+           pushed * 1000.0,
+           nodes,
+           ok ? "" : " (failed)");
+}
+
+// Finds the declaration of a type name by walking the AST
+static AstNode const*
+find_linear(AstNode const* ast, Type const* type)
+{
+    for (; ast; ast = ast->next)
+    {
+        char const* name = minissd_get_data_name(ast);
+        name             = name ? name : minissd_get_enum_name(ast);
+        if (name && strcmp(name, type->name) == 0)
+        {
+            return ast;
+        }
+    }
+    return NULL;
+}
+
+// Resolves the types of properties, by walking the AST for a sample of them
+// and through the index for all
+static void
+bench_index(const char* source, size_t length)
+{
+    printf("index: %zu bytes of input\n", length);
+
+    Parser*  parser = minissd_create_parser(source);
+    AstNode* ast    = minissd_parse(parser);
+    if (!ast)
+    {
+        printf("  parse failed\n");
+        return;
+    }
+
+    size_t         linear_found = 0;
+    size_t         linear_count = 0;
+    AstNode const* node         = ast;
+    double         start        = now_seconds();
+    for (; node && linear_count < 200; node = node->next)
+    {
+        Property const* property = minissd_get_properties(node);
+        for (; property && linear_count < 200; property = property->next)
+        {
+            linear_found += find_linear(ast, &property->type) != NULL;
+            linear_count++;
+        }
+    }
+    double linear = now_seconds() - start;
+
+    size_t    found = 0;
+    size_t    count = 0;
+    AstIndex* index;
+    start        = now_seconds();
+    index        = minissd_build_index(ast);
+    double built = now_seconds();
+    for (node = ast; node; node = node->next)
+    {
+        Property const* property = minissd_get_properties(node);
+        for (; property; property = property->next)
+        {
+            Type const* type = &property->type;
+            found += minissd_find_any(index, type->name, type->name_length) !=
+                     NULL;
+            count++;
+        }
+    }
+    double done = now_seconds();
+    printf("  build %.2f ms; per lookup: linear %.0f ns (%zu/%zu found), "
+           "index %.0f ns (%zu/%zu found)\n",
+           (built - start) * 1000.0,
+           linear * 1e9 / linear_count,
+           linear_found,
+           linear_count,
+           (done - built) * 1e9 / count,
+           found,
+           count);
+
+    minissd_free_index(index);
+    minissd_free_ast(ast);
+    minissd_free_parser(parser);
+}
+
+// Counts the elements of nodes, properties and handlers with their arguments
+// that carry the attribute, walking the whole AST
+static size_t
+count_attribute_linear(AstNode const* ast, char const* name, size_t length)
+{
+    size_t count = 0;
+    for (; ast; ast = ast->next)
+    {
+        count += minissd_get_attribute(ast->opt_ll_attributes, name, length) !=
+                 NULL;
+        Property const* property = minissd_get_properties(ast);
+        for (; property; property = property->next)
+        {
+            count += minissd_get_attribute(
+                         property->attributes, name, length) != NULL;
+        }
+        if (ast->type != NODE_SERVICE)
+        {
+            continue;
+        }
+        Handler const* handler = ast->node.service_node.opt_ll_handlers;
+        for (; handler; handler = handler->next)
+        {
+            count += minissd_get_attribute(
+                         handler->opt_ll_attributes, name, length) != NULL;
+            Argument const* argument = handler->opt_ll_arguments;
+            for (; argument; argument = argument->next)
+            {
+                count += minissd_get_attribute(
+                             argument->attributes, name, length) != NULL;
+            }
+        }
+    }
+    return count;
+}
+
+// Finds the elements with each attribute by walking the AST and from the
+// attribute index
+static void
+bench_attributes(const char* source, size_t length)
+{
+    static char const* const names[] = { "column", "cached", "validate",
+                                         "missing" };
+    size_t                   name_count = sizeof(names) / sizeof(names[0]);
+    printf("attributes: %zu bytes of input\n", length);
+
+    Parser*  parser = minissd_create_parser(source);
+    AstNode* ast    = minissd_parse(parser);
+    if (!ast)
+    {
+        printf("  parse failed\n");
+        return;
+    }
+
+    size_t linear_found = 0;
+    size_t i;
+    double start = now_seconds();
+    for (i = 0; i < name_count; i++)
+    {
+        linear_found +=
+            count_attribute_linear(ast, names[i], strlen(names[i]));
+    }
+    double linear = now_seconds() - start;
+
+    size_t          found = 0;
+    AttributeIndex* index;
+    start        = now_seconds();
+    index        = minissd_build_attribute_index(ast);
+    double built = now_seconds();
+    for (i = 0; i < name_count; i++)
+    {
+        size_t count = 0;
+        minissd_find_attribute(index, names[i], strlen(names[i]), &count);
+        found += count;
+    }
+    double done = now_seconds();
+    printf("  %zu queries: linear %.3f ms (%zu found), index build %.2f ms, "
+           "queries %.3f ms (%zu found)\n",
+           name_count,
+           linear * 1000.0,
+           linear_found,
+           (built - start) * 1000.0,
+           (done - built) * 1000.0,
+           found);
+
+    minissd_free_attribute_index(index);
+    minissd_free_ast(ast);
+    minissd_free_parser(parser);
+}
+
+// Resolves every type once, then follows the links like a generator would
+static void
+bench_resolve(const char* source, size_t length)
+{
+    printf("resolve: %zu bytes of input\n", length);
+
+    Parser*  parser = minissd_create_parser(source);
+    AstNode* ast    = minissd_parse(parser);
+    if (!ast)
+    {
+        printf("  parse failed\n");
+        return;
+    }
+
+    Diagnostics diagnostics = { 0 };
+    double      start       = now_seconds();
+    minissd_resolve_types(ast, &diagnostics);
+    double resolved = now_seconds();
+
+    size_t         types  = 0;
+    size_t         linked = 0;
+    AstNode const* node   = ast;
+    for (; node; node = node->next)
+    {
+        Property const* property = minissd_get_properties(node);
+        for (; property; property = property->next)
+        {
+            linked += property->type.kind != MINISSD_TYPE_UNRESOLVED;
+            types++;
+        }
+    }
+    double done = now_seconds();
+    printf("  resolve %.2f ms (%zu unresolved), follow %zu property types "
+           "%.3f ms (%zu linked)\n",
+           (resolved - start) * 1000.0,
+           diagnostics.count,
+           types,
+           (done - resolved) * 1000.0,
+           linked);
+
+    minissd_free_diagnostics(&diagnostics);
+    minissd_free_ast(ast);
+    minissd_free_parser(parser);
+}
+
+// Validates the whole input, which declares every name once
+static void
+bench_validate(const char* source, size_t length)
+{
+    printf("validate: %zu bytes of input\n", length);
+
+    Parser*  parser = minissd_create_parser(source);
+    AstNode* ast    = minissd_parse(parser);
+    if (!ast)
+    {
+        printf("  parse failed\n");
+        return;
+    }
+
+    Diagnostics diagnostics = { 0 };
+    double      start       = now_seconds();
+    bool        valid       = minissd_validate(ast, &diagnostics);
+    double      done        = now_seconds();
+    printf("  %.2f ms, %s (%zu diagnostics)\n",
+           (done - start) * 1000.0,
+           valid ? "valid" : "invalid",
+           diagnostics.count);
+
+    minissd_free_diagnostics(&diagnostics);
+    minissd_free_ast(ast);
+    minissd_free_parser(parser);
+}
+
+// Looks every variant up by value, walking the variants and from enum tables
+static void
+bench_enums(const char* source, size_t length)
+{
+    printf("enums: %zu bytes of input\n", length);
+
+    Parser*  parser = minissd_create_parser(source);
+    AstNode* ast    = minissd_parse(parser);
+    if (!ast)
+    {
+        printf("  parse failed\n");
+        return;
+    }
+
+    size_t         linear_found = 0;
+    size_t         lookups      = 0;
+    AstNode const* node;
+    double         start = now_seconds();
+    for (node = ast; node; node = node->next)
+    {
+        EnumVariant const* variant = minissd_get_enum_variants(node);
+        for (; variant; variant = variant->next)
+        {
+            EnumVariant const* other = minissd_get_enum_variants(node);
+            while (other && other->value != variant->value)
+            {
+                other = other->next;
+            }
+            linear_found += other != NULL;
+            lookups++;
+        }
+    }
+    double linear = now_seconds() - start;
+
+    size_t found  = 0;
+    size_t dense  = 0;
+    size_t tables = 0;
+    start         = now_seconds();
+    for (node = ast; node; node = node->next)
+    {
+        EnumTable* table = minissd_build_enum_table(node);
+        if (!table)
+        {
+            continue;
+        }
+        size_t i;
+        for (i = 0; i < table->count; i++)
+        {
+            found +=
+                minissd_enum_find_value(table, table->by_name[i].value) != NULL;
+        }
+        dense += table->dense;
+        tables++;
+        minissd_free_enum_table(table);
+    }
+    double done = now_seconds();
+    printf("  %zu lookups: linear %.3f ms (%zu found), %zu tables (%zu dense) "
+           "built and searched %.3f ms (%zu found)\n",
+           lookups,
+           linear * 1000.0,
+           linear_found,
+           tables,
+           dense,
+           (done - start) * 1000.0,
+           found);
+
+    minissd_free_ast(ast);
+    minissd_free_parser(parser);
+}
+
+// Edits one byte in the middle of the input, once by a full parse and once
+// by a reparse of the previous AST
+static void
+bench_reparse(const char* source, size_t length)
+{
+    printf("reparse: %zu bytes of input\n", length);
+
+    // The two buffers take turns being the current input
+    char* buffers[2] = { (char*)malloc(length + 1), (char*)malloc(length + 1) };
+    memcpy(buffers[0], source, length + 1);
+    memcpy(buffers[1], source, length + 1);
+    char const* middle = strstr(source + length / 2, "= 42");
+    size_t      digit  = middle ? (size_t)(middle - source) + 3 : 0;
+
+    double   start  = now_seconds();
+    Parser*  parser = minissd_create_parser(buffers[0]);
+    AstNode* ast    = minissd_parse(parser);
+    double   full   = now_seconds() - start;
+
+    start = now_seconds();
+    for (int r = 1; ast && r <= REPETITIONS; r++)
+    {
+        char*     input = buffers[r % 2];
+        EditRange edit  = { digit, digit + 1, digit + 1 };
+        input[digit]    = (char)('0' + r % 10);
+        ast = minissd_reparse(parser, ast, input, length, edit);
+    }
+    double reparse = (now_seconds() - start) / REPETITIONS;
+    printf("  full parse %.3f ms, reparse %.3f ms, speedup %.0f%s\n",
+           full * 1000.0,
+           reparse * 1000.0,
+           full / reparse,
+           ast ? "" : " (failed)");
+
+    minissd_free_ast(ast);
+    minissd_free_parser(parser);
+    free(buffers[0]);
+    free(buffers[1]);
+}
+
+static void
+bench_load(const char* source, size_t length)
+{
+    printf("load: %zu bytes of input\n", length);
+
+    Parser*  parser = minissd_create_parser(source);
+    AstNode* ast    = minissd_parse(parser);
+    if (!ast)
+    {
+        printf("  parse failed\n");
+        return;
+    }
+    size_t size = 0;
+    void*  data = minissd_serialize_ast(ast, &size);
+    minissd_free_ast(ast);
+    minissd_free_parser(parser);
+    printf("  serialized %zu bytes\n", size);
+
+    size_t nodes = 0;
+    double start = now_seconds();
+    for (int r = 0; r < REPETITIONS; r++)
+    {
+        parser = minissd_create_parser(source);
+        ast    = minissd_parse(parser);
+        nodes += ast != NULL;
+        minissd_free_ast(ast);
+        minissd_free_parser(parser);
+    }
+    double parsed = now_seconds();
+    for (int r = 0; r < REPETITIONS; r++)
+    {
+        FlatAst* flat = minissd_load_ast(data, size, MINISSD_LOAD_DEFAULT);
+        nodes += flat->node_count;
+        minissd_free_flat_ast(flat);
+    }
+    double loaded = now_seconds();
+    for (int r = 0; r < REPETITIONS; r++)
+    {
+        FlatAst* flat = minissd_load_ast(data, size, MINISSD_LOAD_VERIFY);
+        nodes += flat->node_count;
+        minissd_free_flat_ast(flat);
+    }
+    double verified = now_seconds();
+    printf("  per run: parse %.3f ms, load %.3f ms, verified load %.3f ms "
+           "(%zu)\n",
+           (parsed - start) * 1000.0 / REPETITIONS,
+           (loaded - parsed) * 1000.0 / REPETITIONS,
+           (verified - loaded) * 1000.0 / REPETITIONS,
+           nodes);
+
+    minissd_free_serialized_ast(data);
+}
+
+#ifndef _WIN32
+static double
+wall_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Parses files of very different sizes with 1, 2, 4, ... up to every core
+static void
+bench_files(const char* source, size_t length)
+{
+    (void)source;
+    char directory[] = "/tmp/minissd_bench_XXXXXX";
+    if (!mkdtemp(directory))
+    {
+        printf("  no temporary directory\n");
+        return;
+    }
+    size_t       count = 256;
+    size_t       total = 0;
+    char**       paths = (char**)calloc(count, sizeof(char*));
+    const char** names = (const char**)calloc(count, sizeof(char*));
+    for (size_t i = 0; i < count; i++)
+    {
+        // A few big files among many small ones
+        size_t blocks = i % 32 == 0 ? length / 5000 : 1 + i % 16;
+        size_t size   = 0;
+        char*  schema = generate_schema(blocks, &size);
+        paths[i]      = (char*)malloc(strlen(directory) + 32);
+        names[i]      = paths[i];
+        sprintf(paths[i], "%s/%zu.ssd", directory, i);
+        FILE* f = fopen(paths[i], "wb");
+        fwrite(schema, 1, size, f);
+        fclose(f);
+        free(schema);
+        total += size;
+    }
+    printf("files: %zu files, %zu bytes\n", count, total);
+
+    long         cores   = sysconf(_SC_NPROCESSORS_ONLN);
+    double       single  = 0;
+    ParseResult* results = (ParseResult*)calloc(count, sizeof(ParseResult));
+    for (long threads = 1; threads <= cores;)
+    {
+        double start  = wall_seconds();
+        size_t failed = minissd_parse_files(
+            names, count, (unsigned)threads, MINISSD_PARSE_ARENA, results);
+        double seconds = wall_seconds() - start;
+        single         = threads == 1 ? seconds : single;
+        minissd_free_parse_results(results, count);
+        printf("  %2ld threads %8.2f ms, speedup %.2f (%zu failed)\n",
+               threads,
+               seconds * 1000.0,
+               single / seconds,
+               failed);
+        // Ends with exactly as many threads as cores
+        threads = threads < cores && threads * 2 > cores ? cores : threads * 2;
+    }
+    free(results);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        unlink(paths[i]);
+        free(paths[i]);
+    }
+    free(paths);
+    free(names);
+    rmdir(directory);
+}
+
+// One large input, split at top-level declarations across 1 to every core
+static void
+bench_parallel(const char* source, size_t length)
+{
+    size_t big_length = 0;
+    char*  big        = generate_schema(SCHEMA_BLOCKS * 10, &big_length);
+    (void)source;
+    (void)length;
+    printf("parallel: %zu bytes of input\n", big_length);
+
+    long   cores  = sysconf(_SC_NPROCESSORS_ONLN);
+    double single = 0;
+    for (long threads = 1; threads <= cores;)
+    {
+        double   start  = wall_seconds();
+        Parser*  parser = minissd_create_parser_n(big, big_length);
+        minissd_set_parser_flags(parser, MINISSD_PARSE_ARENA);
+        AstNode* ast     = minissd_parse_parallel(parser, (unsigned)threads);
+        double   seconds = wall_seconds() - start;
+        single           = threads == 1 ? seconds : single;
+        printf("  %2ld threads %8.2f ms, speedup %.2f%s\n",
+               threads,
+               seconds * 1000.0,
+               single / seconds,
+               ast ? "" : " (failed)");
+        minissd_free_ast(ast);
+        minissd_free_parser(parser);
+        threads = threads < cores && threads * 2 > cores ? cores : threads * 2;
+    }
+    free(big);
+}
+
+// Loads a root module whose imports fan out to many library modules, which
+// import each other again, with 1, 2, 4, ... up to every core
+static void
+bench_modules(const char* source, size_t length)
+{
+    (void)source;
+    (void)length;
+    char directory[] = "/tmp/minissd_bench_XXXXXX";
+    if (!mkdtemp(directory))
+    {
+        printf("  no temporary directory\n");
+        return;
+    }
+    // generate_schema(n) imports lib::module0 to lib::module<n-1>
+    size_t count = 256;
+    size_t total = 0;
+    char   path[256];
+    snprintf(path, sizeof(path), "%s/lib", directory);
+    mkdir(path, 0700);
+    for (size_t i = 0; i <= count; i++)
+    {
+        size_t size   = 0;
+        char*  schema = generate_schema(i < count ? 1 + i % 16 : count, &size);
+        if (i < count)
+        {
+            snprintf(path, sizeof(path), "%s/lib/module%zu.ssd", directory, i);
+        }
+        else
+        {
+            snprintf(path, sizeof(path), "%s/main.ssd", directory);
+        }
+        FILE* f = fopen(path, "wb");
+        // Library modules only import lower numbered ones, so there are no
+        // cycles: comment out the generated imports
+        for (char* s = schema; i < count && (s = strstr(s, "import"));)
+        {
+            memcpy(s, "//    ", 6);
+        }
+        if (i > 0 && i < count)
+        {
+            fprintf(f,
+                    "import lib::module%zu;\nimport lib::module%zu;\n",
+                    i / 2,
+                    i / 3);
+        }
+        fwrite(schema, 1, size, f);
+        fclose(f);
+        free(schema);
+        total += size;
+    }
+    printf("modules: %zu modules, %zu bytes\n", count + 1, total);
+
+    long   cores  = sysconf(_SC_NPROCESSORS_ONLN);
+    double single = 0;
+    for (long threads = 1; threads <= cores;)
+    {
+        double       start = wall_seconds();
+        ModuleGraph* graph = minissd_load_modules(
+            path, NULL, 0, (unsigned)threads, MINISSD_PARSE_ARENA);
+        double seconds = wall_seconds() - start;
+        single         = threads == 1 ? seconds : single;
+        printf("  %2ld threads %8.2f ms, speedup %.2f, %zu nodes%s\n",
+               threads,
+               seconds * 1000.0,
+               single / seconds,
+               graph ? graph->node_count : 0,
+               graph && graph->status == MINISSD_MODULES_OK ? "" : " (failed)");
+        minissd_free_module_graph(graph);
+        threads = threads < cores && threads * 2 > cores ? cores : threads * 2;
+    }
+
+    unlink(path);
+    for (size_t i = 0; i < count; i++)
+    {
+        snprintf(path, sizeof(path), "%s/lib/module%zu.ssd", directory, i);
+        unlink(path);
+    }
+    snprintf(path, sizeof(path), "%s/lib", directory);
+    rmdir(path);
+    rmdir(directory);
+}
+
+static void
+bench_cache(const char* source, size_t length)
+{
+    printf("cache: %zu bytes of input\n", length);
+
+    char directory[] = "/tmp/minissd_bench_XXXXXX";
+    if (!mkdtemp(directory))
+    {
+        printf("  no temporary directory\n");
+        return;
+    }
+    ParseCache* cache =
+        minissd_open_parse_cache(directory, (size_t)1 << 30, 0);
+
+    double times[2] = { 0, 0 };
+    for (int r = 0; r < REPETITIONS + 1; r++)
+    {
+        double   start  = now_seconds();
+        Parser*  parser = minissd_create_parser(source);
+        FlatAst* flat   = minissd_cache_parse(cache, parser);
+        times[r > 0] += now_seconds() - start;
+        minissd_free_flat_ast(flat);
+        minissd_free_parser(parser);
+    }
+    ParseCacheStats stats = minissd_parse_cache_stats(cache);
+    printf("  miss %.3f ms, hit %.3f ms, hit rate %.2f\n",
+           times[0] * 1000.0,
+           times[1] * 1000.0 / REPETITIONS,
+           stats.hit_rate);
+
+    minissd_close_parse_cache(cache);
+    size_t size  = strlen(directory) + 1 + NAME_MAX + 1;
+    char*  entry = (char*)malloc(size);
+    DIR*   dir   = entry ? opendir(directory) : NULL;
+    for (struct dirent* d; dir && (d = readdir(dir));)
+    {
+        if (d->d_name[0] == '.')
+        {
+            continue;
+        }
+        int n = snprintf(entry, size, "%s/%s", directory, d->d_name);
+        if (n > 0 && (size_t)n < size)
+        {
+            unlink(entry);
+        }
+    }
+    if (dir)
+    {
+        closedir(dir);
+    }
+    free(entry);
+    rmdir(directory);
+}
+#endif
+
+typedef struct Benchmark
+{
+    const char* name;
+    void (*run)(const char* source, size_t length);
+} Benchmark;
+
+static const Benchmark benchmarks[] = {
+    { "arena", bench_arena },
+    { "scaling", bench_scaling },
+    { "intern", bench_intern },
+    { "lines", bench_lines },
+    { "lexer", bench_lexer },
+    { "scan", bench_scan },
+    { "flat", bench_flat },
+    { "load", bench_load },
+    { "reparse", bench_reparse },
+    { "events", bench_events },
+    { "push", bench_push },
+    { "index", bench_index },
+    { "attributes", bench_attributes },
+    { "resolve", bench_resolve },
+    { "validate", bench_validate },
+    { "enums", bench_enums },
+#ifndef _WIN32
+    { "cache", bench_cache },
+    { "files", bench_files },
+    { "parallel", bench_parallel },
+    { "modules", bench_modules },
+#endif
+};
+
+int
+main(int argc, char** argv)
+{
+    size_t blocks = SCHEMA_BLOCKS;
+    if (argc > 2)
+    {
+        blocks = (size_t)strtoul(argv[2], NULL, 10);
+    }
+
+    size_t length = 0;
+    char*  source = generate_schema(blocks, &length);
+
+    for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++)
+    {
+        if (argc > 1 && strcmp(argv[1], "all") != 0 &&
+            strcmp(argv[1], benchmarks[i].name) != 0)
+        {
+            continue;
+        }
+        benchmarks[i].run(source, length);
+    }
+
+    free(source);
+    return 0;
+}
@@ -3,7 +3,6 @@
 #include <stdlib.h>
 
 #include <stdio.h>
-#include <assert.h>
 
 void print_attributes(Attribute const *attr)
 {
@@ -32,32 +31,18 @@ int main(int argc, char **argv)
         printf("Usage: %s <input_file>\n", argv[0]);
         return 1;
     }
-    FILE *f = fopen(argv[1], "rb");
-    if (!f)
+    Parser *parser;
+    AstNode *ast = minissd_parse_file(argv[1], MINISSD_PARSE_DEFAULT, &parser);
+    if (!parser)
     {
         printf("Failed to open file: %s\n", argv[1]);
         return 2;
     }
-    fseek(f, 0, SEEK_END);
-    long fsize = ftell(f);
-    fseek(f, 0, SEEK_SET); /* same as rewind(f); */
-
-    char *source = malloc(fsize + 1);
-    assert(source != NULL);
-
-    fread(source, fsize, 1, f);
-    fclose(f);
-
-    source[fsize] = 0;
-
-    Parser *parser = minissd_create_parser(source);
-    AstNode *ast = minissd_parse(parser);
 
     if (!ast)
     {
         printf("Parsing failed: %s\n", parser->error);
         minissd_free_parser(parser);
-        free(source);
         return 1;
     }
 
@@ -218,6 +203,5 @@ int main(int argc, char **argv)
     minissd_free_ast(ast);
     minissd_free_parser(parser);
 
-    free(source);
     return 0;
 }
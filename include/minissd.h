@@ -3,11 +3,13 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #ifndef MAX_ERROR_SIZE
 #define MAX_ERROR_SIZE 512
 #endif
 
+// Tokens are no longer limited in length, kept for source compatibility
 #ifndef MAX_TOKEN_SIZE
 #define MAX_TOKEN_SIZE 512
 #endif
@@ -35,28 +37,76 @@ extern "C"
     {
         char*                      key;
         char*                      opt_value;  // Nullable
+        size_t                     key_length;
+        size_t                     value_length;
         struct AttributeParameter* next;
     } AttributeParameter;
 
     typedef struct Attribute
     {
         char*               name;
+        size_t              name_length;
         AttributeParameter* opt_ll_arguments;
         struct Attribute*   next;
     } Attribute;
 
+    typedef enum
+    {
+        MINISSD_TYPE_UNRESOLVED,  // Not resolved yet or unknown
+        MINISSD_TYPE_BUILTIN,
+        MINISSD_TYPE_DATA,
+        MINISSD_TYPE_ENUM,
+        MINISSD_TYPE_IMPORT  // Declared by an imported module
+    } TypeKind;
+
+    typedef enum
+    {
+        MINISSD_BUILTIN_NONE,
+        MINISSD_BUILTIN_BOOL,
+        MINISSD_BUILTIN_BYTE,
+        MINISSD_BUILTIN_CHAR,
+        MINISSD_BUILTIN_STRING,
+        MINISSD_BUILTIN_INT,
+        MINISSD_BUILTIN_UINT,
+        MINISSD_BUILTIN_I8,
+        MINISSD_BUILTIN_I16,
+        MINISSD_BUILTIN_I32,
+        MINISSD_BUILTIN_I64,
+        MINISSD_BUILTIN_U8,
+        MINISSD_BUILTIN_U16,
+        MINISSD_BUILTIN_U32,
+        MINISSD_BUILTIN_U64,
+        MINISSD_BUILTIN_F32,
+        MINISSD_BUILTIN_F64,
+        MINISSD_BUILTIN_FLOAT,
+        MINISSD_BUILTIN_DOUBLE
+    } BuiltinType;
+
+    // Layout of the AST structs. Since version 2 optional integers are
+    // stored inline next to a presence flag and types are embedded in their
+    // owner, so `int* count` became count and has_count. The accessors are
+    // unchanged
+#define MINISSD_AST_VERSION 2
+
     typedef struct Type
     {
-        char* name;
-        bool  is_list;
-        int*  count;  // Nullable
+        char*  name;
+        size_t name_length;
+        int    count;  // Valid if has_count
+        bool   is_list : 1;
+        bool   has_count : 1;
+        // Filled in by minissd_resolve_types
+        uint8_t               kind;          // TypeKind
+        uint8_t               builtin;       // BuiltinType
+        struct AstNode const* opt_resolved;  // Data, enum or import node
     } Type;
 
     typedef struct Property
     {
         Attribute*       attributes;
         char*            name;
-        Type*            type;
+        size_t           name_length;
+        Type             type;
         struct Property* next;
     } Property;
 
@@ -64,7 +114,9 @@ extern "C"
     {
         Attribute*          attributes;
         char*               name;
-        int*                opt_value;  // Nullable
+        size_t              name_length;
+        int                 value;  // Given or the previous plus 1, from 0
+        bool                has_value;  // The value was given
         struct EnumVariant* next;
     } EnumVariant;
 
@@ -72,7 +124,8 @@ extern "C"
     {
         Attribute*       attributes;
         char*            name;
-        Type*            type;
+        size_t           name_length;
+        Type             type;
         struct Argument* next;
     } Argument;
 
@@ -80,8 +133,10 @@ extern "C"
     {
         Attribute*      opt_ll_attributes;
         char*           name;
+        size_t          name_length;
         Argument*       opt_ll_arguments;
-        Type*           opt_return_type;
+        Type            return_type;  // Valid if has_return_type
+        bool            has_return_type;
         struct Handler* next;
     } Handler;
 
@@ -89,6 +144,7 @@ extern "C"
     {
         Attribute*    opt_ll_attributes;
         char*         name;
+        size_t        name_length;
         Argument*     opt_ll_arguments;
         struct Event* next;
     } Event;
@@ -97,29 +153,34 @@ extern "C"
     {
         Attribute*         opt_ll_attributes;
         char*              path;
+        size_t             path_length;
         struct Dependency* next;
     } Dependency;
 
     typedef struct Import
     {
-        char* path;
+        char*  path;
+        size_t path_length;
     } Import;
 
     typedef struct Data
     {
         char*     name;
+        size_t    name_length;
         Property* ll_properties;
     } Data;
 
     typedef struct Enum
     {
         char*        name;
+        size_t       name_length;
         EnumVariant* ll_variants;
     } Enum;
 
     typedef struct Service
     {
         char*       name;
+        size_t      name_length;
         Dependency* opt_ll_dependencies;
         Handler*    opt_ll_handlers;
         Event*      opt_ll_events;
@@ -133,9 +194,31 @@ extern "C"
         NODE_SERVICE
     } NodeType;
 
+    typedef enum
+    {
+        MINISSD_PARSE_DEFAULT = 0,
+        // Allocate the AST and its strings from an arena owned by the parser
+        // (or the one passed to minissd_set_parser_arena). The AST is then
+        // released together with the arena and minissd_free_ast is a no-op.
+        MINISSD_PARSE_ARENA = 1 << 0,
+        // Store names, paths and attribute values as views into
+        // Parser::input instead of copies. The strings are NOT terminated,
+        // use the *_length fields or accessors, and the input has to outlive
+        // the AST.
+        MINISSD_PARSE_ZERO_COPY = 1 << 1,
+        // Share one canonical, terminated copy per distinct identifier,
+        // path, type name and attribute name/key. Equal names compare equal
+        // by pointer and map to a small id through minissd_intern_id. The
+        // copies belong to the parser and live until minissd_free_parser.
+        MINISSD_PARSE_INTERN = 1 << 2
+    } ParseFlags;
+
     typedef struct AstNode
     {
         NodeType   type;
+        unsigned   flags;   // ParseFlags the node was parsed with
+        size_t     offset;  // Span of the declaration in the input, from its
+        size_t     length;  // first attribute to its ';'
         Attribute* opt_ll_attributes;
         union
         {
@@ -147,29 +230,894 @@ extern "C"
         struct AstNode* next;
     } AstNode;
 
+    typedef struct ArenaBlock
+    {
+        struct ArenaBlock* next;
+        size_t             capacity;
+        size_t             used;
+    } ArenaBlock;
+
+    typedef struct Arena
+    {
+        ArenaBlock* blocks;
+        size_t      block_size;        // 0 selects MINISSD_ARENA_BLOCK_SIZE
+        size_t      allocation_count;  // Objects handed out
+        size_t      block_count;       // Blocks requested from malloc
+    } Arena;
+
+    typedef enum
+    {
+        MINISSD_ERROR_NONE,
+        MINISSD_ERROR_PATH_TOO_LONG,  // Unused, tokens are unbounded
+        MINISSD_ERROR_EXPECTED_PATH,
+        MINISSD_ERROR_INTEGER_TOO_LONG,  // The value overflows an int
+        MINISSD_ERROR_EXPECTED_INTEGER,
+        MINISSD_ERROR_EXPECTED_STRING,
+        MINISSD_ERROR_STRING_TOO_LONG,  // Unused
+        MINISSD_ERROR_UNTERMINATED_STRING,
+        MINISSD_ERROR_IDENTIFIER_TOO_LONG,  // Unused
+        MINISSD_ERROR_EXPECTED_IDENTIFIER,
+        MINISSD_ERROR_EXPECTED_ATTRIBUTE_OPEN,
+        MINISSD_ERROR_EXPECTED_ATTRIBUTE_ARGUMENTS_CLOSE,
+        MINISSD_ERROR_EXPECTED_ATTRIBUTE_SEPARATOR,
+        MINISSD_ERROR_EXPECTED_ENUM_OPEN,
+        MINISSD_ERROR_EXPECTED_ENUM_SEPARATOR,
+        MINISSD_ERROR_EMPTY_ENUM,
+        MINISSD_ERROR_EXPECTED_OF,
+        MINISSD_ERROR_EXPECTED_DATA_OPEN,
+        MINISSD_ERROR_EXPECTED_PROPERTY_COLON,
+        MINISSD_ERROR_EXPECTED_PROPERTY_SEPARATOR,
+        MINISSD_ERROR_EXPECTED_PROPERTY,
+        MINISSD_ERROR_EXPECTED_ARGUMENT_NAME,
+        MINISSD_ERROR_EXPECTED_ARGUMENT_COLON,
+        MINISSD_ERROR_EXPECTED_ARGUMENT_TYPE,
+        MINISSD_ERROR_EXPECTED_SERVICE_OPEN,
+        MINISSD_ERROR_EXPECTED_SERVICE_COMPONENT,
+        MINISSD_ERROR_EXPECTED_ON,
+        MINISSD_ERROR_EXPECTED_DEPENDENCY_PATH,
+        MINISSD_ERROR_EXPECTED_HANDLER_NAME,
+        MINISSD_ERROR_EXPECTED_HANDLER_OPEN,
+        MINISSD_ERROR_EXPECTED_HANDLER_CLOSE,
+        MINISSD_ERROR_EXPECTED_RETURN_TYPE,
+        MINISSD_ERROR_EXPECTED_EVENT_NAME,
+        MINISSD_ERROR_EXPECTED_EVENT_OPEN,
+        MINISSD_ERROR_EXPECTED_EVENT_CLOSE,
+        MINISSD_ERROR_EXPECTED_COMPONENT_END,
+        MINISSD_ERROR_EXPECTED_IMPORT_PATH,
+        MINISSD_ERROR_EXPECTED_DATA_NAME,
+        MINISSD_ERROR_EXPECTED_ENUM_NAME,
+        MINISSD_ERROR_EXPECTED_SERVICE_NAME,
+        MINISSD_ERROR_EMPTY_SERVICE,
+        MINISSD_ERROR_UNKNOWN_NODE,
+        MINISSD_ERROR_EXPECTED_IMPORT_END,
+        MINISSD_ERROR_EXPECTED_DATA_END,
+        MINISSD_ERROR_EXPECTED_ENUM_END,
+        MINISSD_ERROR_EXPECTED_SERVICE_END,
+        MINISSD_ERROR_EMPTY_INPUT
+    } ErrorCode;
+
+    typedef struct ParseError
+    {
+        ErrorCode   code;
+        size_t      offset;   // Byte offset at which the parser stopped
+        char const* context;  // Nullable, set when built with ADD_CONTEXT
+    } ParseError;
+
+    typedef struct InternTable InternTable;
+    typedef struct PushState   PushState;
+
+    typedef enum
+    {
+        MINISSD_TOKEN_EOF,
+        MINISSD_TOKEN_IDENTIFIER,  // [A-Za-z0-9_]+ that is not all digits
+        MINISSD_TOKEN_INTEGER,     // [0-9]+
+        MINISSD_TOKEN_STRING,      // Includes both quotes
+        MINISSD_TOKEN_UNTERMINATED_STRING,  // Runs to the end of the input
+        MINISSD_TOKEN_HASH,
+        MINISSD_TOKEN_LBRACKET,
+        MINISSD_TOKEN_RBRACKET,
+        MINISSD_TOKEN_LPAREN,
+        MINISSD_TOKEN_RPAREN,
+        MINISSD_TOKEN_LBRACE,
+        MINISSD_TOKEN_RBRACE,
+        MINISSD_TOKEN_COMMA,
+        MINISSD_TOKEN_COLON,
+        MINISSD_TOKEN_SEMICOLON,
+        MINISSD_TOKEN_EQUALS,
+        MINISSD_TOKEN_ARROW,
+        MINISSD_TOKEN_UNKNOWN  // Any other single character
+    } TokenKind;
+
+    typedef enum
+    {
+        MINISSD_KEYWORD_NONE,
+        MINISSD_KEYWORD_IMPORT,
+        MINISSD_KEYWORD_DATA,
+        MINISSD_KEYWORD_ENUM,
+        MINISSD_KEYWORD_SERVICE,
+        MINISSD_KEYWORD_DEPENDS,
+        MINISSD_KEYWORD_ON,
+        MINISSD_KEYWORD_FN,
+        MINISSD_KEYWORD_EVENT,
+        MINISSD_KEYWORD_LIST,
+        MINISSD_KEYWORD_OF
+    } Keyword;
+
+    // Whitespace and comments are not tokens, they fill the gaps between.
+    // Runs longer than 4 GiB come out as UNKNOWN tokens of UINT32_MAX bytes
+    typedef struct
+    {
+        size_t   offset;
+        uint32_t length;
+        uint8_t  kind;     // TokenKind
+        uint8_t  keyword;  // Keyword, set for identifiers only
+    } Token;
+
+    // Instruction sets the lexer's scan loops can use
+    typedef enum
+    {
+        MINISSD_SCAN_SCALAR,
+        MINISSD_SCAN_SSE2,
+        MINISSD_SCAN_AVX2
+    } ScanKernels;
+
     typedef struct
     {
         const char* input;
-        size_t      input_length;
-        char        error[MAX_ERROR_SIZE];
-        char        current;
-        size_t      index;
-        int         line;
-        int         column;
+        size_t      length;   // Shrinks to the first NUL once it is reached
+        size_t      offset;   // Where the next token is scanned from
+        ScanKernels kernels;  // Detected by minissd_init_lexer, may be lowered
+        size_t      block;    // Classified block of input, internal
+        uint64_t    space_bits;
+        uint64_t    word_bits;
+    } Lexer;
+
+    typedef struct
+    {
+        const char*  input;
+        size_t       input_length;
+        char         error[MAX_ERROR_SIZE];
+        Lexer        lexer;
+        Token        token;  // Lookahead, the next token to be consumed
+        size_t       index;  // End of the input consumed so far
+        int          line;    // Position of the last error
+        int          column;
+        unsigned     flags;             // ParseFlags
+        Arena*       arena;             // Nullable, caller-supplied arena
+        Arena        owned_arena;       // Used when no arena was supplied
+        size_t       allocation_count;  // Heap allocations made while parsing
+        InternTable* intern_table;      // Nullable
+        ParseError   last_error;
+        size_t*      line_starts;  // Built on demand by position lookups
+        size_t       line_count;
+        void*        mapping;  // Input file mapping owned by the parser
+        size_t       mapping_length;
+        char*        owned_input;   // Input file read into a buffer instead
+        PushState*   push;          // Nullable, set for push parsers
+        size_t       reparse_live;  // Arena bytes after the last full reparse
     } Parser;
 
+    // Flat AST, every kind of element lives in one contiguous array in
+    // document order and refers to its children by index ranges into the
+    // arrays of the child kind. Strings are offsets into one pool and are
+    // NUL-terminated there.
+#define MINISSD_FLAT_NONE UINT32_MAX
+
+    typedef struct
+    {
+        uint32_t first;
+        uint32_t count;
+    } FlatRange;
+
+    typedef struct
+    {
+        uint32_t offset;  // MINISSD_FLAT_NONE for an absent string
+        uint32_t length;
+    } FlatString;
+
+    typedef struct
+    {
+        FlatString name;
+        int32_t    count;  // Valid if has_count
+        uint8_t    is_list;
+        uint8_t    has_count;
+    } FlatType;
+
+    typedef struct
+    {
+        FlatString key;
+        FlatString value;  // Absent if the parameter has no value
+    } FlatAttributeParameter;
+
+    typedef struct
+    {
+        FlatString name;
+        FlatRange  parameters;
+    } FlatAttribute;
+
+    typedef struct
+    {
+        FlatRange  attributes;
+        FlatString name;
+        FlatType   type;
+    } FlatProperty;
+
+    typedef struct
+    {
+        FlatRange  attributes;
+        FlatString name;
+        int32_t    value;      // Effective value like EnumVariant::value
+        uint8_t    has_value;  // The value was given rather than implied
+    } FlatEnumVariant;
+
+    typedef struct
+    {
+        FlatRange  attributes;
+        FlatString name;
+        FlatType   type;
+    } FlatArgument;
+
+    typedef struct
+    {
+        FlatRange  attributes;
+        FlatString name;
+        FlatRange  arguments;
+        FlatType   return_type;  // Valid if has_return_type
+        uint8_t    has_return_type;
+    } FlatHandler;
+
+    typedef struct
+    {
+        FlatRange  attributes;
+        FlatString name;
+        FlatRange  arguments;
+    } FlatEvent;
+
+    typedef struct
+    {
+        FlatRange  attributes;
+        FlatString path;
+    } FlatDependency;
+
+    typedef struct
+    {
+        uint32_t   type;  // NodeType
+        FlatRange  attributes;
+        FlatString name;     // Path of an import
+        FlatRange  members;  // Properties, variants or handlers
+        FlatRange  dependencies;
+        FlatRange  events;
+    } FlatNode;
+
+    typedef struct
+    {
+        FlatNode*               nodes;
+        FlatProperty*           properties;
+        FlatEnumVariant*        variants;
+        FlatHandler*            handlers;
+        FlatEvent*              events;
+        FlatDependency*         dependencies;
+        FlatArgument*           arguments;
+        FlatAttribute*          attributes;
+        FlatAttributeParameter* parameters;
+        char*                   strings;
+        uint32_t                node_count;
+        uint32_t                property_count;
+        uint32_t                variant_count;
+        uint32_t                handler_count;
+        uint32_t                event_count;
+        uint32_t                dependency_count;
+        uint32_t                argument_count;
+        uint32_t                attribute_count;
+        uint32_t                parameter_count;
+        uint32_t                string_size;
+        void*                   storage;  // Backs all arrays and strings
+        void*                   mapping;  // Owned file mapping, nullable
+        size_t                  mapping_length;
+    } FlatAst;
+
+    // Binary AST format, a header followed by the storage of a FlatAst as
+    // is. Loading checks the header checksum and the length, everything
+    // else is only checked with MINISSD_LOAD_VERIFY.
+#define MINISSD_AST_FORMAT_VERSION 2
+
+    typedef enum
+    {
+        MINISSD_LOAD_DEFAULT = 0,
+        // Also checksum the payload and bounds check every range and string,
+        // for files that may have been damaged after their header was written
+        MINISSD_LOAD_VERIFY = 1 << 0
+    } LoadFlags;
+
+    // Directory of serialized ASTs keyed by a hash of their input, POSIX only
+    typedef struct ParseCache ParseCache;
+
+    typedef struct
+    {
+        size_t hits;
+        size_t misses;
+        size_t stores;     // Entries written after a miss
+        size_t evictions;  // Entries removed to stay within the size bound
+        size_t bytes;      // Size of all entries as last seen
+        double hit_rate;   // hits / (hits + misses), 0 before any lookup
+    } ParseCacheStats;
+
     // Parser creation and destruction
     MINISSD_API Parser*
     minissd_create_parser(const char* input);
+    // Parses input[0, length) without requiring a NUL terminator; the buffer
+    // must outlive the parser (and the AST in zero-copy mode)
+    MINISSD_API Parser*
+    minissd_create_parser_n(const char* input, size_t length);
+#ifndef WASM
+    // Maps the file read-only (or reads it, for pipes and special files);
+    // the parser owns the input, so zero-copy ASTs must be freed first.
+    // Returns NULL if the file cannot be read
+    MINISSD_API Parser*
+    minissd_create_parser_from_file(const char* path);
+#endif
     void
     minissd_free_parser(Parser* p);
 
+    // Parser configuration, call before minissd_parse
+    MINISSD_API void
+    minissd_set_parser_flags(Parser* p, unsigned flags);
+
+    // Parses into a caller-owned arena, implies MINISSD_PARSE_ARENA
+    MINISSD_API void
+    minissd_set_parser_arena(Parser* p, Arena* arena);
+
+    // Arena functions
+    MINISSD_API void
+    minissd_init_arena(Arena* arena, size_t block_size);
+
+    // Releases every allocation of the arena at once, the arena stays usable
+    MINISSD_API void
+    minissd_free_arena(Arena* arena);
+
+    // Positions
+    // Resolves a byte offset of the input to a 1-based line and column in
+    // O(log lines). The line table is built on the first call.
+    MINISSD_API void
+    minissd_offset_to_line_col(Parser* p,
+                               size_t  offset,
+                               int*    line,
+                               int*    column);
+
+    // Error reporting
+    // Structured error of the last failed parse or NULL. Parser::error holds
+    // the same error formatted once minissd_parse has returned NULL.
+    MINISSD_API ParseError const*
+    minissd_get_error(Parser const* p);
+
+    // Formats the last error with line and column, returns the length of
+    // the full message like snprintf or 0 when there is no error
+    MINISSD_API size_t
+    minissd_format_error(Parser* p, char* buffer, size_t size);
+
+    MINISSD_API char const*
+    minissd_get_error_message(ErrorCode code);
+
+    // Lexer, tokens are produced on demand and never allocate
+    MINISSD_API void
+    minissd_init_lexer(Lexer* lexer, const char* input, size_t length);
+    // Widest scan kernels the CPU supports
+    MINISSD_API ScanKernels
+    minissd_detect_scan_kernels(void);
+    // Returns MINISSD_TOKEN_EOF once the input is exhausted, and keeps doing so
+    MINISSD_API Token
+    minissd_next_token(Lexer* lexer);
+    // Tokenizes the whole input into an array that ends with the EOF token,
+    // counted in *opt_count. Release it with minissd_free_tokens
+    MINISSD_API Token*
+    minissd_tokenize(const char* input, size_t length, size_t* opt_count);
+    MINISSD_API void
+    minissd_free_tokens(Token* tokens);
+
+    // Interning, valid for parsers using MINISSD_PARSE_INTERN
+    // Id of a canonical string handed out by the parser, ids are assigned
+    // densely in order of first appearance
+    MINISSD_API int
+    minissd_intern_id(char const* interned);
+
+    // Id of the given name or -1 if it never appeared in the input
+    MINISSD_API int
+    minissd_intern_lookup(Parser const* p, char const* name, size_t length);
+
+    MINISSD_API char const*
+    minissd_intern_string(Parser const* p, int id);
+
+    MINISSD_API size_t
+    minissd_intern_count(Parser const* p);
+
     // Parsing function
     MINISSD_API AstNode*
     minissd_parse(Parser* p);
+
+    // Parses like minissd_parse, but splits large inputs at top-level
+    // declarations and parses the pieces on up to threads threads (0 uses
+    // every online core). Falls back to minissd_parse for small inputs,
+    // MINISSD_PARSE_INTERN and errors, so errors are reported the same way
+    MINISSD_API AstNode*
+    minissd_parse_parallel(Parser* p, unsigned threads);
+
+    // An edit replaced input[start, old_end) of the previous input by
+    // input[start, new_end) of the new one
+    typedef struct
+    {
+        size_t start;
+        size_t old_end;
+        size_t new_end;
+    } EditRange;
+
+    // Parses input, the previous input of p after edit, reusing old_ast.
+    // Only the declarations around the edit are parsed again, all other
+    // nodes are kept as they are and the ones behind the edit move by its
+    // size. old_ast has to come from p, whose input becomes input. Returns
+    // NULL on errors, leaving old_ast as it was, otherwise the result takes
+    // over old_ast. MINISSD_PARSE_ZERO_COPY nodes cannot outlive the old
+    // input, so such parsers parse all of input again. Nodes in an arena
+    // cannot be freed one by one, so once the replaced ones take up as much
+    // of the parser's own arena as the live AST, all of input is parsed
+    // into a fresh arena and the old one is released, together with any
+    // other AST p parsed into it. A caller-supplied arena is never released
+    // and keeps growing until the caller frees it
+    MINISSD_API AstNode*
+    minissd_reparse(Parser*     p,
+                    AstNode*    old_ast,
+                    const char* input,
+                    size_t      length,
+                    EditRange   edit);
+
+    // Event parsing
+    // Strings are views into the input and not terminated; data is NULL for
+    // missing attribute values
+    typedef struct
+    {
+        const char* data;
+        size_t      length;
+    } StringView;
+
+    // Every callback is optional and returns false to stop parsing. The
+    // attributes of an element are reported right after it, the arguments
+    // of handlers and events after their attributes. Service members come
+    // by kind: dependencies, handlers, then events. Type and value pointers
+    // are only valid during the call
+    typedef struct
+    {
+        bool (*begin_node)(void* userdata, NodeType type, StringView name);
+        bool (*end_node)(void* userdata, NodeType type);
+        bool (*on_attribute)(void* userdata, StringView name);
+        bool (*on_attribute_param)(void*      userdata,
+                                   StringView key,
+                                   StringView value);
+        bool (*on_property)(void* userdata, StringView name, Type const* type);
+        bool (*on_enum_variant)(void*      userdata,
+                                StringView name,
+                                int const* opt_value);
+        bool (*on_dependency)(void* userdata, StringView path);
+        bool (*on_handler)(void*       userdata,
+                           StringView  name,
+                           Type const* opt_return_type);
+        bool (*on_argument)(void* userdata, StringView name, Type const* type);
+        bool (*on_event)(void* userdata, StringView name);
+    } ParseCallbacks;
+
+    // Parses like minissd_parse, but reports the declarations through
+    // callbacks instead of building an AST, each one once it is complete.
+    // The name of an import node is its path. Memory use only depends on
+    // the size of the largest declaration. Returns false on errors, which
+    // are reported like by minissd_parse, and true once the input is
+    // consumed or a callback stopped parsing
+    MINISSD_API bool
+    minissd_parse_events(Parser*               p,
+                         ParseCallbacks const* callbacks,
+                         void*                 userdata);
+    // Push parsing, for input that arrives in pieces. The parser buffers
+    // input until it holds complete top-level declarations and parses those
+    // right away, so memory use depends on the largest declaration rather
+    // than the input. Strings are always copied, MINISSD_PARSE_ZERO_COPY is
+    // ignored, and positions before the declaration in progress resolve to
+    // its start
+    MINISSD_API Parser*
+    minissd_create_push_parser(void);
+
+    // Appends length bytes of input and parses every declaration completed
+    // by them. Returns false once parsing failed, with the error reported
+    // like by minissd_parse
+    MINISSD_API bool
+    minissd_parser_feed(Parser* p, const char* chunk, size_t length);
+
+    // Ends the input and parses what is left, which fails on incomplete
+    // declarations and if the input had no declarations at all
+    MINISSD_API bool
+    minissd_parser_finish(Parser* p);
+
+    // Hands out the completed nodes in input order, NULL if there are none
+    // yet. Each node is a list of its own, to be freed with minissd_free_ast
+    MINISSD_API AstNode*
+    minissd_parser_next_node(Parser* p);
+
+#ifndef WASM
+    // Creates *parser from the file and parses it with the given ParseFlags;
+    // *parser is NULL if the file cannot be read
+    MINISSD_API AstNode*
+    minissd_parse_file(const char* path, unsigned flags, Parser** parser);
+#endif
+
+#ifndef WASM
+    typedef struct
+    {
+        Parser*  parser;  // NULL if the file cannot be read
+        AstNode* ast;     // NULL if reading or parsing failed
+    } ParseResult;
+
+    // Parses each file like minissd_parse_file into results[i], spreading
+    // them largest first over a work-stealing pool of threads (0 uses every
+    // online core). Returns how many files failed. Release the results with
+    // minissd_free_parse_results
+    MINISSD_API size_t
+    minissd_parse_files(const char* const* paths,
+                        size_t             count,
+                        unsigned           threads,
+                        unsigned           flags,
+                        ParseResult*       results);
+
+    MINISSD_API void
+    minissd_free_parse_results(ParseResult* results, size_t count);
+#endif
+
+#ifndef WASM
+    // Modules, each .ssd file is one module. `import a::b::c` refers to the
+    // module a::b::c in a/b/c.ssd or, failing that, to the declaration c of
+    // the module a::b in a/b.ssd, looked up under each search root in turn.
+    typedef enum
+    {
+        MINISSD_MODULES_OK,
+        MINISSD_MODULES_UNREADABLE,  // A module file cannot be read
+        MINISSD_MODULES_PARSE_ERROR,
+        MINISSD_MODULES_UNRESOLVED,  // An import matches no file
+        MINISSD_MODULES_CYCLE
+    } ModuleStatus;
+
+    typedef struct
+    {
+        char*    name;        // Module path such as a::b, empty for the root
+        char*    path;        // File the module was read from
+        Parser*  parser;      // NULL if the file cannot be read
+        AstNode* ast;         // NULL if reading or parsing failed
+        size_t*  imports;     // Indices of the modules imported, in order
+        size_t   import_count;
+        char*    unresolved;  // Nullable, first import matching no file
+    } Module;
+
+    typedef struct
+    {
+        Module*         modules;  // modules[0] is the root, then breadth first
+        size_t          module_count;
+        size_t*         order;  // Module indices, imports before importers
+        AstNode const** nodes;  // Declarations of all modules in that order
+        size_t          node_count;
+        ModuleStatus    status;
+        char            error[MAX_ERROR_SIZE];  // First problem, if any
+    } ModuleGraph;
+
+    // Parses the module in path and everything it imports, each file once,
+    // on up to threads threads (0 uses every online core). Imports are
+    // resolved under search_roots, or the directory of path if there are
+    // none. order and nodes are only valid when status is
+    // MINISSD_MODULES_OK. NULL on allocation failure
+    MINISSD_API ModuleGraph*
+    minissd_load_modules(const char*        path,
+                         const char* const* search_roots,
+                         size_t             root_count,
+                         unsigned           threads,
+                         unsigned           flags);
+
+    MINISSD_API void
+    minissd_free_module_graph(ModuleGraph* graph);
+#endif
+
     void
     minissd_free_ast(AstNode* ast);
 
+    // Flat AST
+    // Copies the AST into a FlatAst backed by a single allocation, the AST
+    // and its parser may be freed afterwards. Returns NULL if allocation
+    // fails or the strings exceed 4 GiB
+    MINISSD_API FlatAst*
+    minissd_flatten_ast(AstNode const* ast);
+
+    MINISSD_API void
+    minissd_free_flat_ast(FlatAst* flat);
+
+    // The string or NULL if it is absent
+    MINISSD_API char const*
+    minissd_flat_string(FlatAst const* flat, FlatString s);
+
+    // Children of an element are adjacent, each getter returns the first
+    // one and stores how many follow in *count
+    MINISSD_API FlatProperty const*
+    minissd_flat_get_properties(FlatAst const*  flat,
+                                FlatNode const* node,
+                                uint32_t*       count);
+
+    MINISSD_API FlatEnumVariant const*
+    minissd_flat_get_variants(FlatAst const*  flat,
+                              FlatNode const* node,
+                              uint32_t*       count);
+
+    MINISSD_API FlatHandler const*
+    minissd_flat_get_handlers(FlatAst const*  flat,
+                              FlatNode const* node,
+                              uint32_t*       count);
+
+    MINISSD_API FlatDependency const*
+    minissd_flat_get_dependencies(FlatAst const*  flat,
+                                  FlatNode const* node,
+                                  uint32_t*       count);
+
+    MINISSD_API FlatEvent const*
+    minissd_flat_get_events(FlatAst const*  flat,
+                            FlatNode const* node,
+                            uint32_t*       count);
+
+    MINISSD_API FlatArgument const*
+    minissd_flat_get_arguments(FlatAst const* flat,
+                               FlatRange      arguments,
+                               uint32_t*      count);
+
+    MINISSD_API FlatAttribute const*
+    minissd_flat_get_attributes(FlatAst const* flat,
+                                FlatRange      attributes,
+                                uint32_t*      count);
+
+    MINISSD_API FlatAttributeParameter const*
+    minissd_flat_get_parameters(FlatAst const*       flat,
+                                FlatAttribute const* attr,
+                                uint32_t*            count);
+
+    // Serialized AST
+    // Serializes the AST into a buffer released with
+    // minissd_free_serialized_ast, *length receives its size. NULL on
+    // allocation failure
+    MINISSD_API void*
+    minissd_serialize_ast(AstNode const* ast, size_t* length);
+
+    MINISSD_API void*
+    minissd_serialize_flat_ast(FlatAst const* flat, size_t* length);
+
+    MINISSD_API void
+    minissd_free_serialized_ast(void* data);
+
+    // Loads a serialized AST in place without copying, data has to be 8-byte
+    // aligned and outlive the result, which is read-only. Returns NULL if the
+    // data is not a valid AST of this format version and byte order
+    MINISSD_API FlatAst*
+    minissd_load_ast(void const* data, size_t length, unsigned flags);
+
+#ifndef WASM
+    // Maps the file read-only and loads it in place, the mapping is released
+    // by minissd_free_flat_ast
+    MINISSD_API FlatAst*
+    minissd_load_ast_file(const char* path, unsigned flags);
+#endif
+
+#if !defined(WASM) && !defined(_WIN32)
+    // Parse cache
+    // Opens the cache directory, creating it if it is missing. Entries are
+    // loaded with the given LoadFlags and the least recently used ones are
+    // removed once they exceed max_bytes. Returns NULL if the directory
+    // cannot be used
+    MINISSD_API ParseCache*
+    minissd_open_parse_cache(const char* directory,
+                             size_t      max_bytes,
+                             unsigned    load_flags);
+
+    MINISSD_API void
+    minissd_close_parse_cache(ParseCache* cache);
+
+    // Returns the cached AST of the parser's input without parsing it, or
+    // parses it with minissd_parse and stores the result. Returns NULL if
+    // parsing fails, the error is reported by the parser as usual
+    MINISSD_API FlatAst*
+    minissd_cache_parse(ParseCache* cache, Parser* p);
+
+    MINISSD_API ParseCacheStats
+    minissd_parse_cache_stats(ParseCache const* cache);
+#endif
+
+    // Name index
+    // Finds declarations by name in O(1): data, enums and services by their
+    // name, imports by their path and, unless a declaration has that name,
+    // by the last segment of it. The first of several equal names wins. An
+    // index never changes once built, so any number of threads may search
+    // it, and it stays valid as long as the AST. Names need no terminator
+    typedef struct AstIndex AstIndex;
+
+    // NULL on allocation failure
+    MINISSD_API AstIndex*
+    minissd_build_index(AstNode const* ast);
+
+    MINISSD_API void
+    minissd_free_index(AstIndex* index);
+
+    MINISSD_API AstNode const*
+    minissd_find_data(AstIndex const* index, char const* name, size_t length);
+
+    MINISSD_API AstNode const*
+    minissd_find_enum(AstIndex const* index, char const* name, size_t length);
+
+    MINISSD_API AstNode const*
+    minissd_find_service(AstIndex const* index,
+                         char const*     name,
+                         size_t          length);
+
+    MINISSD_API AstNode const*
+    minissd_find_import(AstIndex const* index, char const* path, size_t length);
+
+    // Declaration or import of any kind
+    MINISSD_API AstNode const*
+    minissd_find_any(AstIndex const* index, char const* name, size_t length);
+
+    // Attribute index
+    // Lists the elements carrying each attribute name, so that finding all
+    // of them costs a lookup rather than a walk over the AST
+    typedef enum
+    {
+        MINISSD_ELEMENT_NODE,  // AstNode
+        MINISSD_ELEMENT_PROPERTY,
+        MINISSD_ELEMENT_VARIANT,  // EnumVariant
+        MINISSD_ELEMENT_DEPENDENCY,
+        MINISSD_ELEMENT_HANDLER,
+        MINISSD_ELEMENT_ARGUMENT,
+        MINISSD_ELEMENT_EVENT
+    } AttributedElementKind;
+
+    typedef struct
+    {
+        AttributedElementKind kind;
+        void const*           element;  // Of the type kind names
+        AstNode const*        node;     // Top-level node it belongs to
+        Attribute const*      attributes;
+        // Union of minissd_attribute_mask of its attribute names. An
+        // element has none of a set of names if the AND with their masks is
+        // 0, otherwise it probably has one, to be confirmed by name
+        uint64_t mask;
+    } AttributedElement;
+
+    typedef struct AttributeIndex AttributeIndex;
+
+    // Two bits out of 64 chosen by the name
+    MINISSD_API uint64_t
+    minissd_attribute_mask(char const* name, size_t length);
+
+    // First attribute of the name in the list, NULL if there is none
+    MINISSD_API Attribute const*
+    minissd_get_attribute(Attribute const* attributes,
+                          char const*      name,
+                          size_t           length);
+
+    // Like the name index, the attribute index is immutable, may be read
+    // from many threads and stays valid as long as the AST. NULL on
+    // allocation failure
+    MINISSD_API AttributeIndex*
+    minissd_build_attribute_index(AstNode const* ast);
+
+    MINISSD_API void
+    minissd_free_attribute_index(AttributeIndex* index);
+
+    // Elements with the attribute in AST order, members after their node,
+    // each listed once. *count receives their number
+    MINISSD_API AttributedElement const*
+    minissd_find_attribute(AttributeIndex const* index,
+                           char const*           name,
+                           size_t                length,
+                           size_t*               count);
+
+    // Every element with attributes, in AST order
+    MINISSD_API AttributedElement const*
+    minissd_attributed_elements(AttributeIndex const* index, size_t* count);
+
+    // Diagnostics
+    // Problems found by the passes over a finished AST. Unlike parse errors
+    // they do not stop the pass, all of them are collected
+    typedef enum
+    {
+        MINISSD_DIAGNOSTIC_UNKNOWN_TYPE,
+        MINISSD_DIAGNOSTIC_NOT_A_TYPE,  // A service used as a type
+        MINISSD_DIAGNOSTIC_DUPLICATE_DECLARATION,
+        MINISSD_DIAGNOSTIC_DUPLICATE_IMPORT,
+        MINISSD_DIAGNOSTIC_DUPLICATE_PROPERTY,
+        MINISSD_DIAGNOSTIC_DUPLICATE_VARIANT,
+        MINISSD_DIAGNOSTIC_DUPLICATE_VALUE,  // Named after the later variant
+        MINISSD_DIAGNOSTIC_DUPLICATE_HANDLER,
+        MINISSD_DIAGNOSTIC_DUPLICATE_EVENT,
+        MINISSD_DIAGNOSTIC_DUPLICATE_ARGUMENT,
+        MINISSD_DIAGNOSTIC_EMPTY_SERVICE
+    } DiagnosticCode;
+
+    typedef struct
+    {
+        DiagnosticCode code;
+        AstNode const* node;     // Declaration the problem was found in
+        void const*    element;  // Type, Property, ... it is about
+        char const*    name;     // Offending name, not terminated
+        size_t         name_length;
+        // E.g. "Unknown type 'X' in data 'Y'", or "Duplicate import 'X'"
+        // when the element is the node itself
+        char* message;
+    } Diagnostic;
+
+    // Zero initialize before the first use
+    typedef struct
+    {
+        Diagnostic* items;
+        size_t      count;
+        size_t      capacity;
+    } Diagnostics;
+
+    MINISSD_API void
+    minissd_free_diagnostics(Diagnostics* diagnostics);
+
+    // Sets kind, builtin and opt_resolved of every type in the AST in one
+    // pass, so that generators need no lookups by name. A name resolves to
+    // a data or enum declaration of the AST first, then to a builtin, then
+    // to an import whose path is the name, its last segment or a prefix of
+    // it. Returns false if a type stays unresolved, each one is added to
+    // opt_diagnostics, or if memory ran out. Resolve again after
+    // minissd_reparse, which may free the nodes types point to
+    MINISSD_API bool
+    minissd_resolve_types(AstNode* ast, Diagnostics* opt_diagnostics);
+
+    // Checks in one pass what the grammar cannot: names declared twice at
+    // the top level, among the properties of a data, the variants of an
+    // enum, the handlers, events or arguments of a service, variants with
+    // equal values and services without handlers or events. Data, enums
+    // and services share one namespace, imports have their own. Every
+    // later occurrence of a name is added to opt_diagnostics, false if
+    // there was any
+    MINISSD_API bool
+    minissd_validate(AstNode const* ast, Diagnostics* opt_diagnostics);
+
+    // Enum tables
+    // The variants of one enum sorted by value and by name, for switch
+    // tables and binary search in generated (de)serializers
+    typedef struct
+    {
+        char const*        name;  // Not terminated with ZERO_COPY
+        size_t             name_length;
+        int                value;
+        EnumVariant const* variant;
+    } EnumEntry;
+
+    typedef struct
+    {
+        EnumEntry const* by_value;  // Equal values in source order
+        EnumEntry const* by_name;   // In byte order
+        size_t           count;
+        int              min;
+        int              max;
+        bool             unique;  // No two variants share a value
+        bool             dense;   // Unique without gaps, by_value[v - min]
+    } EnumTable;
+
+    // NULL if the node is no enum or on allocation failure
+    MINISSD_API EnumTable*
+    minissd_build_enum_table(AstNode const* node);
+
+    MINISSD_API void
+    minissd_free_enum_table(EnumTable* table);
+
+    // First variant with the value in source order, O(1) for dense tables
+    MINISSD_API EnumEntry const*
+    minissd_enum_find_value(EnumTable const* table, int value);
+
+    MINISSD_API EnumEntry const*
+    minissd_enum_find_name(EnumTable const* table,
+                           char const*      name,
+                           size_t           length);
+
     // AST Node Accessors
     MINISSD_API NodeType const*
     minissd_get_node_type(AstNode const* node);
@@ -177,15 +1125,27 @@ extern "C"
     MINISSD_API char const*
     minissd_get_import_path(AstNode const* node);
 
+    MINISSD_API size_t
+    minissd_get_import_path_length(AstNode const* node);
+
     MINISSD_API char const*
     minissd_get_data_name(AstNode const* node);
 
+    MINISSD_API size_t
+    minissd_get_data_name_length(AstNode const* node);
+
     MINISSD_API char const*
     minissd_get_enum_name(AstNode const* node);
 
+    MINISSD_API size_t
+    minissd_get_enum_name_length(AstNode const* node);
+
     MINISSD_API char const*
     minissd_get_service_name(AstNode const* node);
 
+    MINISSD_API size_t
+    minissd_get_service_name_length(AstNode const* node);
+
     MINISSD_API Property const*
     minissd_get_properties(AstNode const* node);
 
@@ -207,6 +1167,13 @@ extern "C"
     MINISSD_API AstNode const*
     minissd_get_next_node(AstNode const* node);
 
+    // Span of the node in the input, attributes and ';' included
+    MINISSD_API size_t
+    minissd_get_node_offset(AstNode const* node);
+
+    MINISSD_API size_t
+    minissd_get_node_length(AstNode const* node);
+
     // Handler Accessors
     MINISSD_API Attribute const*
     minissd_get_handler_attributes(Handler const* node);
@@ -214,6 +1181,9 @@ extern "C"
     MINISSD_API char const*
     minissd_get_handler_name(Handler const* node);
 
+    MINISSD_API size_t
+    minissd_get_handler_name_length(Handler const* node);
+
     MINISSD_API Type const*
     minissd_get_handler_return_type(Handler const* handler);
 
@@ -227,6 +1197,9 @@ extern "C"
     MINISSD_API char const*
     minissd_get_event_name(Event const* event);
 
+    MINISSD_API size_t
+    minissd_get_event_name_length(Event const* event);
+
     MINISSD_API Argument const*
     minissd_get_event_arguments(Event const* event);
 
@@ -237,6 +1210,9 @@ extern "C"
     MINISSD_API char const*
     minissd_get_dependency_path(Dependency const* dep);
 
+    MINISSD_API size_t
+    minissd_get_dependency_path_length(Dependency const* dep);
+
     MINISSD_API Dependency const*
     minissd_get_next_dependency(Dependency const* dep);
 
@@ -244,6 +1220,9 @@ extern "C"
     MINISSD_API char const*
     minissd_get_property_name(Property const* prop);
 
+    MINISSD_API size_t
+    minissd_get_property_name_length(Property const* prop);
+
     MINISSD_API Type const*
     minissd_get_property_type(Property const* prop);
 
@@ -257,19 +1236,38 @@ extern "C"
     MINISSD_API char const*
     minissd_get_type_name(Type const* type);
 
+    MINISSD_API size_t
+    minissd_get_type_name_length(Type const* type);
+
     MINISSD_API bool
     minissd_get_type_is_list(Type const* type);
 
     MINISSD_API int const*
     minissd_get_type_count(Type const* type);
 
+    MINISSD_API TypeKind
+    minissd_get_type_kind(Type const* type);
+
+    MINISSD_API BuiltinType
+    minissd_get_type_builtin(Type const* type);
+
+    MINISSD_API AstNode const*
+    minissd_get_type_resolved(Type const* type);
+
     // Enum Variant Accessors
     MINISSD_API char const*
     minissd_get_enum_variant_name(EnumVariant const* value);
 
+    MINISSD_API size_t
+    minissd_get_enum_variant_name_length(EnumVariant const* value);
+
     MINISSD_API int
     minissd_get_enum_variant_value(EnumVariant const* value, bool* has_value);
 
+    // The value given or implied, Value3 in `A, Value2 = 42, Value3` is 43
+    MINISSD_API int
+    minissd_get_enum_variant_effective_value(EnumVariant const* value);
+
     MINISSD_API Attribute const*
     minissd_get_enum_variant_attributes(EnumVariant const* value);
 
@@ -280,6 +1278,9 @@ extern "C"
     MINISSD_API char const*
     minissd_get_argument_name(Argument const* arg);
 
+    MINISSD_API size_t
+    minissd_get_argument_name_length(Argument const* arg);
+
     MINISSD_API Type const*
     minissd_get_argument_type(Argument const* arg);
 
@@ -293,6 +1294,9 @@ extern "C"
     MINISSD_API char const*
     minissd_get_attribute_name(Attribute const* attr);
 
+    MINISSD_API size_t
+    minissd_get_attribute_name_length(Attribute const* attr);
+
     MINISSD_API AttributeParameter const*
     minissd_get_attribute_parameters(Attribute const* attr);
 
@@ -303,9 +1307,17 @@ extern "C"
     MINISSD_API char const*
     minissd_get_attribute_parameter_name(AttributeParameter const* arg);
 
+    MINISSD_API size_t
+    minissd_get_attribute_parameter_name_length(
+        AttributeParameter const* arg);
+
     MINISSD_API char const*
     minissd_get_attribute_parameter_value(AttributeParameter const* arg);
 
+    MINISSD_API size_t
+    minissd_get_attribute_parameter_value_length(
+        AttributeParameter const* arg);
+
     MINISSD_API AttributeParameter const*
     minissd_get_next_attribute_parameter(AttributeParameter const* arg);
 
@@ -1,3 +1,7 @@
+#if !defined(WASM) && !defined(_WIN32)
+#define _XOPEN_SOURCE 700
+#endif
+
 #include "minissd.h"
 
 #ifndef WASM
@@ -6,15 +10,35 @@
 #include <stdio.h>
 
 #include <assert.h>
-#include <ctype.h>
+#include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
+
+#if !defined(MINISSD_NO_SIMD) && (defined(__x86_64__) || defined(__i386__)) && \
+    defined(__GNUC__)
+#define MINISSD_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+#ifndef _WIN32
+#define MINISSD_THREADS
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
 #else
 #undef NULL
 #include "../extern/walloc/walloc.c"
 
 #define assert(x)
 
+#include <limits.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -54,34 +78,52 @@ calloc(size_t num, size_t size)
 }
 
 int
-isspace(int c)
+strcmp(const char* s1, const char* s2)
 {
-    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' ||
-           c == '\r';
+    while (*s1 && (*s1 == *s2))
+    {
+        s1++;
+        s2++;
+    }
+    return *(const unsigned char*)s1 - *(const unsigned char*)s2;
 }
 
-int
-isalnum(int c)
+void*
+memset(void* dest, int c, size_t n)
 {
-    return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') ||
-           (c >= 'a' && c <= 'z');
+    unsigned char* d = dest;
+    while (n--)
+        *d++ = (unsigned char)c;
+    return dest;
 }
 
-int
-isdigit(int c)
+void*
+memchr(const void* s, int c, size_t n)
 {
-    return c >= '0' && c <= '9';
+    const unsigned char* p = s;
+    for (; n; n--, p++)
+    {
+        if (*p == (unsigned char)c)
+        {
+            return (void*)p;
+        }
+    }
+    return NULL;
 }
 
 int
-strcmp(const char* s1, const char* s2)
+memcmp(const void* s1, const void* s2, size_t n)
 {
-    while (*s1 && (*s1 == *s2))
+    const unsigned char* a = s1;
+    const unsigned char* b = s2;
+    for (; n; n--, a++, b++)
     {
-        s1++;
-        s2++;
+        if (*a != *b)
+        {
+            return *a - *b;
+        }
     }
-    return *(const unsigned char*)s1 - *(const unsigned char*)s2;
+    return 0;
 }
 
 int
@@ -132,35 +174,344 @@ printf(const char* format, ...)
         return NULL;                                                           \
     }
 
+#ifndef MINISSD_ARENA_BLOCK_SIZE
+#define MINISSD_ARENA_BLOCK_SIZE (64 * 1024)
+#endif
+
+#define ARENA_ALIGNMENT (2 * sizeof(void*))
+
+// Arena
+static size_t
+align_up(size_t value)
+{
+    return (value + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+static void*
+arena_alloc(Arena* arena, size_t size)
+{
+    size = align_up(size);
+
+    size_t      header = align_up(sizeof(ArenaBlock));
+    ArenaBlock* block  = arena->blocks;
+    if (!block || block->capacity - block->used < size)
+    {
+        size_t block_size =
+            arena->block_size ? arena->block_size : MINISSD_ARENA_BLOCK_SIZE;
+        bool   oversized = size > block_size / 4;
+        size_t capacity  = oversized ? size : block_size;
+
+        ArenaBlock* fresh = (ArenaBlock*)malloc(header + capacity);
+        assert(fresh);
+        fresh->capacity = capacity;
+        fresh->used     = 0;
+        arena->block_count++;
+
+        // Oversized requests get a dedicated block behind the current one so
+        // the remaining space of the current block is not wasted.
+        if (oversized && block)
+        {
+            fresh->next = block->next;
+            block->next = fresh;
+        }
+        else
+        {
+            fresh->next   = block;
+            arena->blocks = fresh;
+        }
+        block = fresh;
+    }
+    char* ptr = (char*)block + header + block->used;
+    block->used += size;
+    arena->allocation_count++;
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+// Frees every block but the current one, whose space is used again
+static void
+arena_reset(Arena* arena)
+{
+    ArenaBlock* block = arena->blocks;
+    if (!block)
+    {
+        return;
+    }
+    ArenaBlock* rest = block->next;
+    block->next      = NULL;
+    block->used      = 0;
+    while (rest)
+    {
+        ArenaBlock* next = rest->next;
+        free(rest);
+        rest = next;
+    }
+}
+
+static Arena*
+parser_arena(Parser* p)
+{
+    if (p->arena)
+    {
+        return p->arena;
+    }
+    return &p->owned_arena;
+}
+
+// Interning
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+#define INTERN_INITIAL_SLOTS 256
+
+// Stored in front of every canonical string
+typedef struct InternHeader
+{
+    uint32_t id;
+    uint32_t length;
+} InternHeader;
+
+struct InternTable
+{
+    Arena        storage;
+    char const** strings;  // Indexed by id
+    uint32_t*    hashes;   // Indexed by id
+    uint32_t*    slots;    // 0 when empty, otherwise id + 1
+    size_t       count;
+    size_t       capacity;
+    size_t       slot_count;
+};
+
+static uint32_t
+hash_step(uint32_t hash, char c)
+{
+    return (hash ^ (unsigned char)c) * FNV_PRIME;
+}
+
+static uint32_t
+hash_bytes(char const* s, size_t length)
+{
+    uint32_t hash = FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash = hash_step(hash, s[i]);
+    }
+    return hash;
+}
+
+static InternHeader const*
+intern_header(char const* interned)
+{
+    return (InternHeader const*)(interned - sizeof(InternHeader));
+}
+
+static void
+intern_rehash(InternTable* t, size_t slot_count)
+{
+    free(t->slots);
+    t->slots = (uint32_t*)calloc(slot_count, sizeof(uint32_t));
+    assert(t->slots);
+    t->slot_count = slot_count;
+    for (size_t id = 0; id < t->count; id++)
+    {
+        size_t slot = t->hashes[id] & (slot_count - 1);
+        while (t->slots[slot])
+        {
+            slot = (slot + 1) & (slot_count - 1);
+        }
+        t->slots[slot] = (uint32_t)id + 1;
+    }
+}
+
+static void
+intern_grow(InternTable* t)
+{
+    size_t capacity = t->capacity ? t->capacity * 2 : INTERN_INITIAL_SLOTS / 2;
+
+    char const** strings = (char const**)malloc(capacity * sizeof(char*));
+    uint32_t*    hashes  = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    assert(strings && hashes);
+    if (t->count)
+    {
+        memcpy(strings, t->strings, t->count * sizeof(char*));
+        memcpy(hashes, t->hashes, t->count * sizeof(uint32_t));
+    }
+    free(t->strings);
+    free(t->hashes);
+    t->strings  = strings;
+    t->hashes   = hashes;
+    t->capacity = capacity;
+
+    // Keep the load factor at or below one half
+    intern_rehash(t, capacity * 2);
+}
+
+static int
+intern_find(InternTable const* t, char const* s, size_t length, uint32_t hash)
+{
+    if (!t || !t->slot_count)
+    {
+        return -1;
+    }
+    size_t slot = hash & (t->slot_count - 1);
+    while (t->slots[slot])
+    {
+        uint32_t id = t->slots[slot] - 1;
+        if (t->hashes[id] == hash &&
+            intern_header(t->strings[id])->length == length &&
+            memcmp(t->strings[id], s, length) == 0)
+        {
+            return (int)id;
+        }
+        slot = (slot + 1) & (t->slot_count - 1);
+    }
+    return -1;
+}
+
+// Returns the canonical copy of s, adding it to the table if needed
+static char*
+intern_in(InternTable* t, char const* s, size_t length, uint32_t hash)
+{
+    int id = intern_find(t, s, length, hash);
+    if (id >= 0)
+    {
+        return (char*)t->strings[id];
+    }
+
+    if (t->count == t->capacity)
+    {
+        intern_grow(t);
+    }
+
+    InternHeader* header = (InternHeader*)arena_alloc(
+        &t->storage, sizeof(InternHeader) + length + 1);
+    header->id     = (uint32_t)t->count;
+    header->length = (uint32_t)length;
+
+    char* canonical = (char*)(header + 1);
+    memcpy(canonical, s, length);
+    canonical[length] = '\0';
+
+    t->strings[t->count] = canonical;
+    t->hashes[t->count]  = hash;
+    t->count++;
+
+    size_t slot = hash & (t->slot_count - 1);
+    while (t->slots[slot])
+    {
+        slot = (slot + 1) & (t->slot_count - 1);
+    }
+    t->slots[slot] = (uint32_t)t->count;
+    return canonical;
+}
+
 static char*
-strdup_c99(const char* s)
+intern(Parser* p, char const* s, size_t length, uint32_t hash)
+{
+    if (!p->intern_table)
+    {
+        p->intern_table = (InternTable*)calloc(1, sizeof(InternTable));
+        assert(p->intern_table);
+    }
+    return intern_in(p->intern_table, s, length, hash);
+}
+
+// Releases what the table holds, but not the table itself
+static void
+clear_intern_table(InternTable* t)
 {
-    assert(s);
+    minissd_free_arena(&t->storage);
+    free(t->strings);
+    free(t->hashes);
+    free(t->slots);
+}
 
-    size_t len = strlen(s) + 1;
-    char*  dup = (char*)malloc(len);
-    assert(dup);
+static void
+free_intern_table(InternTable* t)
+{
+    if (!t)
+    {
+        return;
+    }
+    clear_intern_table(t);
+    free(t);
+}
 
-    memcpy(dup, s, len);
+// Allocates a zeroed AST object, either from the parser's arena or the heap
+static void*
+parser_alloc(Parser* p, size_t size)
+{
+    if (p->flags & MINISSD_PARSE_ARENA)
+    {
+        return arena_alloc(parser_arena(p), size);
+    }
+    p->allocation_count++;
+    void* ptr = calloc(1, size);
+    assert(ptr);
+    return ptr;
+}
 
+static char*
+parser_strndup(Parser* p, const char* s, size_t length)
+{
+    char* dup;
+    if (p->flags & MINISSD_PARSE_ARENA)
+    {
+        dup = (char*)arena_alloc(parser_arena(p), length + 1);
+    }
+    else
+    {
+        p->allocation_count++;
+        dup = (char*)malloc(length + 1);
+        assert(dup);
+    }
+    memcpy(dup, s, length);
+    dup[length] = '\0';
     return dup;
 }
 
+// Releases a temporary allocation made through parser_alloc
+static void
+release(Parser* p, void* ptr)
+{
+    if (!(p->flags & MINISSD_PARSE_ARENA))
+    {
+        free(ptr);
+    }
+}
+
+// Attribute values are copied unless the AST borrows the input
+static void
+free_string(char* s, unsigned flags)
+{
+    if (s && !(flags & (MINISSD_PARSE_ARENA | MINISSD_PARSE_ZERO_COPY)))
+    {
+        free(s);
+    }
+}
+
+// Names and paths additionally belong to the intern table when interning
+static void
+free_name(char* s, unsigned flags)
+{
+    if (!(flags & MINISSD_PARSE_INTERN))
+    {
+        free_string(s, flags);
+    }
+}
+
 // Free functions
 static void
-free_attribute_parameters(AttributeParameter* args)
+free_attribute_parameters(AttributeParameter* args, unsigned flags)
 {
+    if (flags & MINISSD_PARSE_ARENA)
+    {
+        return;
+    }
     AttributeParameter* current = args;
     while (current)
     {
-        if (current->key)
-        {
-            free(current->key);
-        }
-        if (current->opt_value)
-        {
-            free(current->opt_value);
-        }
+        free_name(current->key, flags);
+        free_string(current->opt_value, flags);
         AttributeParameter* next = current->next;
         free(current);
         current = next;
@@ -168,51 +519,43 @@ free_attribute_parameters(AttributeParameter* args)
 }
 
 static void
-free_attributes(Attribute* attrs)
+free_attributes(Attribute* attrs, unsigned flags)
 {
+    if (flags & MINISSD_PARSE_ARENA)
+    {
+        return;
+    }
     Attribute* current_attr = attrs;
     while (current_attr)
     {
-        if (current_attr->name)
-        {
-            free(current_attr->name);
-        }
-        free_attribute_parameters(current_attr->opt_ll_arguments);
+        free_name(current_attr->name, flags);
+        free_attribute_parameters(current_attr->opt_ll_arguments, flags);
         Attribute* next_attr = current_attr->next;
         free(current_attr);
         current_attr = next_attr;
     };
 }
 
+// Types are embedded in their owner, only the name is freed
 static void
-free_type(Type* type)
+free_type(Type* type, unsigned flags)
 {
-    if (type->name)
-    {
-        free(type->name);
-    }
-    if (type->count)
-    {
-        free(type->count);
-    }
-    free(type);
+    free_name(type->name, flags);
 }
 
 static void
-free_arguments(Argument* args)
+free_arguments(Argument* args, unsigned flags)
 {
+    if (flags & MINISSD_PARSE_ARENA)
+    {
+        return;
+    }
     Argument* current = args;
     while (current)
     {
-        if (current->name)
-        {
-            free(current->name);
-        }
-        if (current->type)
-        {
-            free_type(current->type);
-        }
-        free_attributes(current->attributes);
+        free_name(current->name, flags);
+        free_type(&current->type, flags);
+        free_attributes(current->attributes, flags);
         Argument* next = current->next;
         free(current);
         current = next;
@@ -220,20 +563,18 @@ free_arguments(Argument* args)
 }
 
 static void
-free_properties(Property* prop)
+free_properties(Property* prop, unsigned flags)
 {
+    if (flags & MINISSD_PARSE_ARENA)
+    {
+        return;
+    }
     Property* current = prop;
     while (current)
     {
-        if (current->name)
-        {
-            free(current->name);
-        }
-        if (current->type)
-        {
-            free_type(current->type);
-        }
-        free_attributes(current->attributes);
+        free_name(current->name, flags);
+        free_type(&current->type, flags);
+        free_attributes(current->attributes, flags);
         Property* outer_next = current->next;
         free(current);
         current = outer_next;
@@ -241,20 +582,17 @@ free_properties(Property* prop)
 }
 
 static void
-free_enum_variants(EnumVariant* variants)
+free_enum_variants(EnumVariant* variants, unsigned flags)
 {
+    if (flags & MINISSD_PARSE_ARENA)
+    {
+        return;
+    }
     EnumVariant* current = variants;
     while (current)
     {
-        if (current->name)
-        {
-            free(current->name);
-        }
-        if (current->opt_value)
-        {
-            free(current->opt_value);
-        }
-        free_attributes(current->attributes);
+        free_name(current->name, flags);
+        free_attributes(current->attributes, flags);
         EnumVariant* next = current->next;
         free(current);
         current = next;
@@ -262,37 +600,36 @@ free_enum_variants(EnumVariant* variants)
 }
 
 static void
-free_dependencies(Dependency* deps)
+free_dependencies(Dependency* deps, unsigned flags)
 {
+    if (flags & MINISSD_PARSE_ARENA)
+    {
+        return;
+    }
     Dependency* current = deps;
     while (current)
     {
-        if (current->path)
-        {
-            free(current->path);
-        }
-        free_attributes(current->opt_ll_attributes);
+        free_name(current->path, flags);
+        free_attributes(current->opt_ll_attributes, flags);
         Dependency* next = current->next;
         free(current);
         current = next;
     };
 }
 static void
-free_handlers(Handler* handlers)
+free_handlers(Handler* handlers, unsigned flags)
 {
+    if (flags & MINISSD_PARSE_ARENA)
+    {
+        return;
+    }
     Handler* current = handlers;
     while (current)
     {
-        if (current->name)
-        {
-            free(current->name);
-        }
-        if (current->opt_return_type)
-        {
-            free_type(current->opt_return_type);
-        }
-        free_attributes(current->opt_ll_attributes);
-        free_arguments(current->opt_ll_arguments);
+        free_name(current->name, flags);
+        free_type(&current->return_type, flags);
+        free_attributes(current->opt_ll_attributes, flags);
+        free_arguments(current->opt_ll_arguments, flags);
         Handler* next = current->next;
         free(current);
         current = next;
@@ -300,17 +637,18 @@ free_handlers(Handler* handlers)
 }
 
 static void
-free_events(Event* events)
+free_events(Event* events, unsigned flags)
 {
+    if (flags & MINISSD_PARSE_ARENA)
+    {
+        return;
+    }
     Event* current = events;
     while (current)
     {
-        if (current->name)
-        {
-            free(current->name);
-        }
-        free_attributes(current->opt_ll_attributes);
-        free_arguments(current->opt_ll_arguments);
+        free_name(current->name, flags);
+        free_attributes(current->opt_ll_attributes, flags);
+        free_arguments(current->opt_ll_arguments, flags);
         Event* next = current->next;
         free(current);
         current = next;
@@ -318,42 +656,35 @@ free_events(Event* events)
 }
 
 static void
-free_ast(AstNode* ast)
+free_ast(AstNode* ast, unsigned flags)
 {
+    if (flags & MINISSD_PARSE_ARENA)
+    {
+        return;
+    }
     AstNode* current = ast;
     while (current)
     {
-        free_attributes(current->opt_ll_attributes);
+        free_attributes(current->opt_ll_attributes, flags);
         switch (current->type)
         {
         case NODE_IMPORT:
-            if (current->node.import_node.path)
-            {
-                free(current->node.import_node.path);
-            }
+            free_name(current->node.import_node.path, flags);
             break;
         case NODE_DATA:
-            if (current->node.data_node.name)
-            {
-                free(current->node.data_node.name);
-            }
-            free_properties(current->node.data_node.ll_properties);
+            free_name(current->node.data_node.name, flags);
+            free_properties(current->node.data_node.ll_properties, flags);
             break;
         case NODE_ENUM:
-            if (current->node.enum_node.name)
-            {
-                free(current->node.enum_node.name);
-            }
-            free_enum_variants(current->node.enum_node.ll_variants);
+            free_name(current->node.enum_node.name, flags);
+            free_enum_variants(current->node.enum_node.ll_variants, flags);
             break;
         case NODE_SERVICE:
-            if (current->node.service_node.name)
-            {
-                free(current->node.service_node.name);
-            }
-            free_dependencies(current->node.service_node.opt_ll_dependencies);
-            free_handlers(current->node.service_node.opt_ll_handlers);
-            free_events(current->node.service_node.opt_ll_events);
+            free_name(current->node.service_node.name, flags);
+            free_dependencies(current->node.service_node.opt_ll_dependencies,
+                              flags);
+            free_handlers(current->node.service_node.opt_ll_handlers, flags);
+            free_events(current->node.service_node.opt_ll_events, flags);
             break;
         default:
             break;
@@ -365,314 +696,285 @@ free_ast(AstNode* ast)
     };
 }
 
-static void
-error(Parser* p, const char* message)
+// Name of a declaration, the path for imports
+static char const*
+node_name(AstNode const* node, size_t* length)
 {
-    size_t column = 1;
-    size_t line   = 1;
-
-    for (int i = 0; i < p->index; i++)
+    switch (node->type)
     {
-        if (p->input[i] == '\n')
-        {
-            line++;
-            column = 1;
-        }
-        else
-        {
-            column++;
-        }
+    case NODE_IMPORT:
+        *length = node->node.import_node.path_length;
+        return node->node.import_node.path;
+    case NODE_DATA:
+        *length = node->node.data_node.name_length;
+        return node->node.data_node.name;
+    case NODE_ENUM:
+        *length = node->node.enum_node.name_length;
+        return node->node.enum_node.name;
+    default:
+        *length = node->node.service_node.name_length;
+        return node->node.service_node.name;
     }
+}
 
-    snprintf(p->error,
-             MAX_ERROR_SIZE,
-             "Error: %s at line %ld, column %ld",
-             message,
-             line,
-             column);
+static char const* const error_messages[] = {
+    NULL,
+    "Path length exceeds maximum token size",
+    "Expected path",
+    "Integer does not fit into an int",
+    "Expected integer",
+    "Expected string",
+    "String length exceeds maximum token size",
+    "Unterminated string",
+    "Identifier length exceeds maximum token size",
+    "Expected identifier",
+    "Expected '[' after attribute",
+    "Expected ')' after attribute argument",
+    "Expected ',' after attribute",
+    "Expected '{' after enum name",
+    "Expected ',' after enum value",
+    "Enum must have at least one variant",
+    "Expected 'of' after 'list'",
+    "Expected '{' after data name",
+    "Expected ':' after property name",
+    "Expected ',' after property",
+    "Expected property",
+    "Expected argument name",
+    "Expected ':' after argument name",
+    "Expected argument type",
+    "Expected '{' after service name",
+    "Expected 'depends' or 'fn' keyword",
+    "Expected 'on' keyword",
+    "Expected dependency path",
+    "Expected handler name",
+    "Expected '(' after handler name",
+    "Expected ')' after handler arguments",
+    "Expected return type after ':'",
+    "Expected event name",
+    "Expected '(' after event name",
+    "Expected ')' after event arguments",
+    "Expected ';' after service component",
+    "Expected import path",
+    "Expected data name",
+    "Expected enum name",
+    "Expected service name",
+    "Service must have at least one handler or event",
+    "Unknown node type",
+    "Expected ';' after import declaration",
+    "Expected ';' after data declaration",
+    "Expected ';' after enum declaration",
+    "Expected ';' after service declaration",
+    "Expected at least one node",
+};
+
+// Records the error without formatting it, so failed lookahead stays cheap
+static void
+error_in(Parser* p, ErrorCode code, char const* context)
+{
+    // Offsets point one past the character the parser stopped at, or at the
+    // end of the input
+    size_t end            = p->lexer.length;
+    p->last_error.code    = code;
+    p->last_error.offset  = p->index < end ? p->index + 1 : end;
+    p->last_error.context = context;
 }
 
-static char
-peek(const Parser* p)
+static void
+error(Parser* p, ErrorCode code)
 {
-    if (p->index < p->input_length)
-    {
-        return p->input[p->index];
-    }
-    return '\0';
+    error_in(p, code, NULL);
 }
 
 void
 debug(const Parser* p)
 {
-    printf("Current: %c\n", p->current);
-    printf("Next: %c\n", peek(p));
+    printf("Token: %.*s\n",
+           (int)p->token.length,
+           p->input + p->token.offset);
+    printf("Kind: %d\n", p->token.kind);
     printf("Index: %ld\n", p->index);
 }
 
+// Consumes the lookahead token
 static void
 advance(Parser* p)
 {
-    if (p->input[p->index] == '\0')
-    {
-        p->current = '\0';
-        return;
-    }
-    p->current = p->input[p->index++];
+    p->index = p->token.offset + p->token.length;
+    p->token = minissd_next_token(&p->lexer);
 }
 
+// The lexer already skipped them, this moves the parser up to the next token
+// so errors point at it
 static void
 eat_whitespaces_and_comments(Parser* p)
 {
-    DBG("Try eating whitespaces and comments\n");
-    bool comment = true;
-    while (comment)
-    {
-        comment = false;
-        while (isspace(p->current))
-        {
-            advance(p);
-        }
-        if (p->current == '/' && peek(p) == '/')
-        {
-            comment = true;
-            while (p->current != '\n' && p->current != '\0')
-            {
-                advance(p);
-            }
-        }
-    }
+    p->index = p->token.offset;
 }
 
-static int
-is_alphanumeric(char c)
+static bool
+at(Parser const* p, TokenKind kind)
 {
-    return isalnum(c) || c == '_';
+    return p->token.kind == kind;
 }
 
-static char*
-parse_path(Parser* p, char const* context)
+// Identifiers may also consist of digits only
+static bool
+at_word(Parser const* p)
 {
-    char buffer[MAX_TOKEN_SIZE + 1];
-    int  length = 0;
-    eat_whitespaces_and_comments(p);
-    while (length <= MAX_TOKEN_SIZE && p->current != '\0' &&
-           (is_alphanumeric(p->current) || p->current == ':'))
+    return at(p, MINISSD_TOKEN_IDENTIFIER) || at(p, MINISSD_TOKEN_INTEGER);
+}
+
+// Turns the scanned token input[start, start + length) into an AST string,
+// either by referencing the input or by copying it once
+static char*
+make_string(Parser* p, size_t start, size_t length, size_t* opt_length)
+{
+    if (opt_length)
     {
-        if (length == MAX_TOKEN_SIZE)
-        {
-            if (context)
-            {
-                char error_buffer[MAX_ERROR_SIZE + 1];
-                snprintf(
-                    error_buffer,
-                    MAX_ERROR_SIZE,
-                    "Path length exceeds maximum token size in context: %s",
-                    context);
-                error(p, error_buffer);
-            }
-            else
-            {
-                error(p, "Path length exceeds maximum token size");
-            }
-            return NULL;
-        }
+        *opt_length = length;
+    }
+    if (p->flags & MINISSD_PARSE_ZERO_COPY)
+    {
+        return (char*)p->input + start;
+    }
+    return parser_strndup(p, p->input + start, length);
+}
 
-        buffer[length++] = p->current;
+// Identifiers and paths, interned when MINISSD_PARSE_INTERN is set
+static char*
+make_name(Parser* p, size_t start, size_t length, size_t* opt_length)
+{
+    if (!(p->flags & MINISSD_PARSE_INTERN))
+    {
+        return make_string(p, start, length, opt_length);
+    }
+    if (opt_length)
+    {
+        *opt_length = length;
+    }
+    char const* name = p->input + start;
+    return intern(p, name, length, hash_bytes(name, length));
+}
+
+// Paths are runs of identifiers, integers and colons without gaps
+static char*
+parse_path(Parser* p, char const* context, size_t* opt_length)
+{
+    eat_whitespaces_and_comments(p);
+    size_t start = p->token.offset;
+    size_t end   = start;
+    while ((at_word(p) || at(p, MINISSD_TOKEN_COLON)) &&
+           p->token.offset == end)
+    {
+        end = p->token.offset + p->token.length;
         advance(p);
     }
-    buffer[length] = '\0';
-    if (length == 0)
+    if (end == start)
     {
-        if (context)
-        {
-            char error_buffer[MAX_ERROR_SIZE + 1];
-            snprintf(error_buffer,
-                     MAX_ERROR_SIZE,
-                     "Expected path in context: %s",
-                     context);
-            error(p, error_buffer);
-        }
-        else
-        {
-            error(p, "Expected path");
-        }
+        error_in(p, MINISSD_ERROR_EXPECTED_PATH, context);
         return NULL;
     }
-    DBG("Path: %s\n", buffer);
-    return strdup_c99(buffer);
+    DBG("Path: %.*s\n", (int)(end - start), p->input + start);
+    return make_name(p, start, end - start, opt_length);
 }
 
-static int*
-parse_int(Parser* p, char const* context)
+// Stores the integer in *result, which lives inline in the AST
+static bool
+parse_int(Parser* p, char const* context, int* result)
 {
-    char buffer[MAX_TOKEN_SIZE + 1];
-    int  length = 0;
-    while (length <= MAX_TOKEN_SIZE && isdigit(p->current))
+    if (!at(p, MINISSD_TOKEN_INTEGER))
     {
-        if (length == MAX_TOKEN_SIZE)
-        {
-            if (context)
-            {
-                char error_buffer[MAX_ERROR_SIZE + 1];
-                snprintf(
-                    error_buffer,
-                    MAX_ERROR_SIZE,
-                    "Integer length exceeds maximum token size in context: %s",
-                    context);
-                error(p, error_buffer);
-            }
-            else
-            {
-                error(p, "Integer length exceeds maximum token size");
-            }
-            return NULL;
-        }
-        buffer[length++] = p->current;
-        advance(p);
+        error_in(p, MINISSD_ERROR_EXPECTED_INTEGER, context);
+        return false;
     }
-    buffer[length] = '\0';
-    if (length == 0)
+    int value = 0;
+    for (size_t i = 0; i < p->token.length; i++)
     {
-        if (context)
-        {
-            char error_buffer[MAX_ERROR_SIZE + 1];
-            snprintf(error_buffer,
-                     MAX_ERROR_SIZE,
-                     "Expected integer in context: %s",
-                     context);
-            error(p, error_buffer);
-        }
-        else
+        int digit = p->input[p->token.offset + i] - '0';
+        if (value > (INT_MAX - digit) / 10)
         {
-            error(p, "Expected integer");
+            error_in(p, MINISSD_ERROR_INTEGER_TOO_LONG, context);
+            return false;
         }
-        return NULL;
+        value = value * 10 + digit;
     }
-    int* value = (int*)malloc(sizeof(int));
-    assert(value);
-    *value = atoi(buffer);
-    DBG("Integer: %d\n", *value);
-    return value;
+    advance(p);
+    *result = value;
+    DBG("Integer: %d\n", value);
+    return true;
 }
 
 static char*
-parse_string(Parser* p, char const* context)
+parse_string(Parser* p, char const* context, size_t* opt_length)
 {
-    if (p->current != '"')
+    bool terminated = at(p, MINISSD_TOKEN_STRING);
+    if (!terminated && !at(p, MINISSD_TOKEN_UNTERMINATED_STRING))
     {
-        if (context)
-        {
-            char error_buffer[MAX_ERROR_SIZE + 1];
-            snprintf(error_buffer,
-                     MAX_ERROR_SIZE,
-                     "Expected string in context: %s",
-                     context);
-            error(p, error_buffer);
-        }
-        else
-        {
-            error(p, "Expected string");
-        }
+        error_in(p, MINISSD_ERROR_EXPECTED_STRING, context);
         return NULL;
     }
+    size_t start  = p->token.offset + 1;
+    size_t length = p->token.length - (terminated ? 2 : 1);
     advance(p);
-    char buffer[MAX_TOKEN_SIZE + 1];
-    int  length = 0;
-    while (length <= MAX_TOKEN_SIZE && p->current != '"' && p->current != '\0')
+    if (!terminated)
     {
-        if (length == MAX_TOKEN_SIZE)
-        {
-            if (context)
-            {
-                char error_buffer[MAX_ERROR_SIZE + 1];
-                snprintf(
-                    error_buffer,
-                    MAX_ERROR_SIZE,
-                    "String length exceeds maximum token size in context: %s",
-                    context);
-                error(p, error_buffer);
-            }
-            else
-            {
-                error(p, "String length exceeds maximum token size");
-            }
-            return NULL;
-        }
-        buffer[length++] = p->current;
-        advance(p);
+        error_in(p, MINISSD_ERROR_UNTERMINATED_STRING, context);
+        return NULL;
     }
-    if (p->current != '"')
+    DBG("String: %.*s\n", (int)length, p->input + start);
+    return make_string(p, start, length, opt_length);
+}
+
+// Reports an error unless the lookahead can be used as an identifier
+static bool
+expect_identifier(Parser* p, char const* context)
+{
+    if (!at_word(p))
+    {
+        error_in(p, MINISSD_ERROR_EXPECTED_IDENTIFIER, context);
+        return false;
+    }
+    return true;
+}
+
+static char*
+parse_identifier(Parser* p, char const* context, size_t* opt_length)
+{
+    if (!expect_identifier(p, context))
     {
-        if (context)
-        {
-            char error_buffer[MAX_ERROR_SIZE + 1];
-            snprintf(error_buffer,
-                     MAX_ERROR_SIZE,
-                     "Unterminated string in context: %s",
-                     context);
-            error(p, error_buffer);
-        }
-        else
-        {
-            error(p, "Unterminated string");
-        }
         return NULL;
     }
+    size_t start  = p->token.offset;
+    size_t length = p->token.length;
     advance(p);
-    buffer[length] = '\0';
-    DBG("String: %s\n", buffer);
-    return strdup_c99(buffer);
+    DBG("Identifier: %.*s\n", (int)length, p->input + start);
+    return make_name(p, start, length, opt_length);
 }
 
-static char*
-parse_identifier(Parser* p, char const* context)
+// Consumes the identifier in front of the parser and returns its keyword,
+// anything else is left in place and yields MINISSD_KEYWORD_NONE
+static Keyword
+parse_keyword(Parser* p)
 {
-    char buffer[MAX_TOKEN_SIZE + 1];
-    int  length = 0;
-    while (length <= MAX_TOKEN_SIZE && is_alphanumeric(p->current))
+    if (!at_word(p))
     {
-        if (length == MAX_TOKEN_SIZE)
-        {
-            if (context)
-            {
-                char error_buffer[MAX_ERROR_SIZE + 1];
-                snprintf(error_buffer,
-                         MAX_ERROR_SIZE,
-                         "Identifier length exceeds maximum token size in "
-                         "context: %s",
-                         context);
-                error(p, error_buffer);
-            }
-            else
-            {
-                error(p, "Identifier length exceeds maximum token size");
-            }
-            return NULL;
-        }
-        buffer[length++] = p->current;
-        advance(p);
+        return MINISSD_KEYWORD_NONE;
     }
-    buffer[length] = '\0';
-    if (length == 0)
+    Keyword keyword = (Keyword)p->token.keyword;
+    advance(p);
+    return keyword;
+}
+
+// Consumes the keyword if it is the next token, never reports errors
+static bool
+accept_keyword(Parser* p, Keyword keyword)
+{
+    if (!at(p, MINISSD_TOKEN_IDENTIFIER) || p->token.keyword != keyword)
     {
-        if (context)
-        {
-            char error_buffer[MAX_ERROR_SIZE + 1];
-            snprintf(error_buffer,
-                     MAX_ERROR_SIZE,
-                     "Expected identifier in context: %s",
-                     context);
-            error(p, error_buffer);
-        }
-        else
-        {
-            error(p, "Expected identifier");
-        }
-        return NULL;
+        return false;
     }
-    DBG("Identifier: %s\n", buffer);
-    return strdup_c99(buffer);
+    advance(p);
+    return true;
 }
 
 static Attribute*
@@ -681,89 +983,81 @@ parse_attributes(Parser* p, char const* context)
     DBG("Try parsing attributes\n");
     Attribute *head = NULL, *tail = NULL;
     eat_whitespaces_and_comments(p);
-    while (p->current == '#')
+    while (at(p, MINISSD_TOKEN_HASH))
     {
         DBG("Found attribute\n");
         advance(p);
         eat_whitespaces_and_comments(p);
-        if (p->current != '[')
+        if (!at(p, MINISSD_TOKEN_LBRACKET))
         {
-            free_attributes(head);
-            if (context)
-            {
-                char error_buffer[MAX_ERROR_SIZE + 1];
-                snprintf(error_buffer,
-                         MAX_ERROR_SIZE,
-                         "Expected '[' after attribute in context: %s",
-                         context);
-                error(p, error_buffer);
-            }
-            else
-            {
-                error(p, "Expected '[' after attribute");
-            }
+            free_attributes(head, p->flags);
+            error_in(p, MINISSD_ERROR_EXPECTED_ATTRIBUTE_OPEN, context);
             return NULL;
         }
         advance(p);
         DBG("Parsing attributes\n");
         eat_whitespaces_and_comments(p);
-        while (p->current != ']')
+        while (!at(p, MINISSD_TOKEN_RBRACKET))
         {
-            Attribute* attr = (Attribute*)calloc(1, sizeof(Attribute));
+            Attribute* attr = (Attribute*)parser_alloc(p, sizeof(Attribute));
             assert(attr);
 
             eat_whitespaces_and_comments(p);
-            attr->name = parse_path(p, CTX("attributes"));
+            attr->name =
+                parse_path(p, CTX("attributes"), &attr->name_length);
             DBG("Attribute name: %s\n", attr->name);
             if (!attr->name)
             {
-                free_attributes(attr);
-                free_attributes(head);
+                free_attributes(attr, p->flags);
+                free_attributes(head, p->flags);
                 return NULL;
             };
 
             eat_whitespaces_and_comments(p);
-            if (p->current == '(')
+            if (at(p, MINISSD_TOKEN_LPAREN))
             {
                 advance(p);
                 AttributeParameter *arg_head = NULL, *arg_tail = NULL;
                 DBG("Parsing attribute parameters\n");
 
                 eat_whitespaces_and_comments(p);
-                while (p->current != ')')
+                while (!at(p, MINISSD_TOKEN_RPAREN))
                 {
-                    AttributeParameter* arg = (AttributeParameter*)calloc(
-                        1, sizeof(AttributeParameter));
+                    AttributeParameter* arg = (AttributeParameter*)parser_alloc(
+                        p, sizeof(AttributeParameter));
                     assert(arg);
 
                     DBG("Parsing attribute parameter\n");
 
                     eat_whitespaces_and_comments(p);
-                    arg->key = parse_identifier(p, CTX("attribute arguments"));
+                    arg->key = parse_identifier(
+                        p, CTX("attribute arguments"), &arg->key_length);
                     if (!arg->key)
                     {
-                        free_attribute_parameters(arg);
-                        free_attribute_parameters(arg_head);
-                        free_attributes(attr);
-                        free_attributes(head);
+                        free_attribute_parameters(arg, p->flags);
+                        free_attribute_parameters(arg_head, p->flags);
+                        free_attributes(attr, p->flags);
+                        free_attributes(head, p->flags);
                         return NULL;
                     };
                     DBG("Attribute parameter key: %s\n", arg->key);
 
                     eat_whitespaces_and_comments(p);
-                    if (p->current == '=')
+                    if (at(p, MINISSD_TOKEN_EQUALS))
                     {
                         advance(p);
                         DBG("Parsing attribute parameter value\n");
                         eat_whitespaces_and_comments(p);
                         arg->opt_value =
-                            parse_string(p, CTX("attribute arguments"));
+                            parse_string(p,
+                                         CTX("attribute arguments"),
+                                         &arg->value_length);
                         if (!arg->opt_value)
                         {
-                            free_attribute_parameters(arg);
-                            free_attribute_parameters(arg_head);
-                            free_attributes(attr);
-                            free_attributes(head);
+                            free_attribute_parameters(arg, p->flags);
+                            free_attribute_parameters(arg_head, p->flags);
+                            free_attributes(attr, p->flags);
+                            free_attributes(head, p->flags);
                             return NULL;
                         };
                         DBG("Attribute parameter value: %s\n", arg->opt_value);
@@ -780,7 +1074,7 @@ parse_attributes(Parser* p, char const* context)
                     arg_tail = arg;
 
                     eat_whitespaces_and_comments(p);
-                    if (p->current != ',')
+                    if (!at(p, MINISSD_TOKEN_COMMA))
                     {
                         DBG("No more attribute parameters\n");
                         break;
@@ -789,12 +1083,12 @@ parse_attributes(Parser* p, char const* context)
                 }
 
                 eat_whitespaces_and_comments(p);
-                if (p->current != ')')
+                if (!at(p, MINISSD_TOKEN_RPAREN))
                 {
-                    error(p, "Expected ')' after attribute argument");
-                    free_attribute_parameters(arg_head);
-                    free_attributes(attr);
-                    free_attributes(head);
+                    error(p, MINISSD_ERROR_EXPECTED_ATTRIBUTE_ARGUMENTS_CLOSE);
+                    free_attribute_parameters(arg_head, p->flags);
+                    free_attributes(attr, p->flags);
+                    free_attributes(head, p->flags);
 
                     return NULL;
                 }
@@ -813,7 +1107,7 @@ parse_attributes(Parser* p, char const* context)
             tail = attr;
 
             eat_whitespaces_and_comments(p);
-            if (p->current != ',')
+            if (!at(p, MINISSD_TOKEN_COMMA))
             {
                 DBG("No more attributes\n");
                 break;
@@ -822,10 +1116,10 @@ parse_attributes(Parser* p, char const* context)
         }
 
         eat_whitespaces_and_comments(p);
-        if (p->current != ']')
+        if (!at(p, MINISSD_TOKEN_RBRACKET))
         {
-            free_attributes(head);
-            error(p, "Expected ',' after attribute");
+            free_attributes(head, p->flags);
+            error(p, MINISSD_ERROR_EXPECTED_ATTRIBUTE_SEPARATOR);
             return NULL;
         }
         advance(p);
@@ -839,9 +1133,9 @@ static EnumVariant*
 parse_enum_variants(Parser* p)
 {
     DBG("Try parsing enum variants\n");
-    if (p->current != '{')
+    if (!at(p, MINISSD_TOKEN_LBRACE))
     {
-        error(p, "Expected '{' after enum name");
+        error(p, MINISSD_ERROR_EXPECTED_ENUM_OPEN);
         return NULL;
     }
     advance(p);
@@ -849,10 +1143,10 @@ parse_enum_variants(Parser* p)
     EnumVariant *head = NULL, *tail = NULL;
 
     eat_whitespaces_and_comments(p);
-    while (p->current != '}')
+    while (!at(p, MINISSD_TOKEN_RBRACE))
     {
         DBG("Parsing enum variant\n");
-        EnumVariant* ev = (EnumVariant*)calloc(1, sizeof(EnumVariant));
+        EnumVariant* ev = (EnumVariant*)parser_alloc(p, sizeof(EnumVariant));
         assert(ev);
 
         eat_whitespaces_and_comments(p);
@@ -863,30 +1157,43 @@ parse_enum_variants(Parser* p)
         }
 
         eat_whitespaces_and_comments(p);
-        ev->name = parse_identifier(p, CTX("enum variant"));
+        ev->name =
+            parse_identifier(p, CTX("enum variant"), &ev->name_length);
         if (!ev->name)
         {
-            free_enum_variants(ev);
-            free_enum_variants(head);
+            free_enum_variants(ev, p->flags);
+            free_enum_variants(head, p->flags);
             return NULL;
         };
         DBG("Enum variant name: %s\n", ev->name);
 
         eat_whitespaces_and_comments(p);
-        if (p->current == '=')
+        if (at(p, MINISSD_TOKEN_EQUALS))
         {
             advance(p);
             DBG("Parsing enum variant value\n");
 
             eat_whitespaces_and_comments(p);
-            ev->opt_value = parse_int(p, CTX("enum variant"));
-            if (!ev->opt_value)
+            if (!parse_int(p, CTX("enum variant"), &ev->value))
             {
-                free_enum_variants(ev);
-                free_enum_variants(head);
+                free_enum_variants(ev, p->flags);
+                free_enum_variants(head, p->flags);
                 return NULL;
             };
-            DBG("Enum variant value: %d\n", *ev->opt_value);
+            DBG("Enum variant value: %d\n", ev->value);
+            ev->has_value = true;
+        }
+        else if (tail && tail->value == INT_MAX)
+        {
+            // Like in C, the implied value has to fit as well
+            error(p, MINISSD_ERROR_INTEGER_TOO_LONG);
+            free_enum_variants(ev, p->flags);
+            free_enum_variants(head, p->flags);
+            return NULL;
+        }
+        else
+        {
+            ev->value = tail ? tail->value + 1 : 0;
         }
 
         if (!head)
@@ -900,7 +1207,7 @@ parse_enum_variants(Parser* p)
         tail = ev;
 
         eat_whitespaces_and_comments(p);
-        if (p->current != ',')
+        if (!at(p, MINISSD_TOKEN_COMMA))
         {
             DBG("No more enum variants\n");
             break;
@@ -910,104 +1217,76 @@ parse_enum_variants(Parser* p)
     }
 
     eat_whitespaces_and_comments(p);
-    if (p->current != '}')
+    if (!at(p, MINISSD_TOKEN_RBRACE))
     {
-        error(p, "Expected ',' after enum value");
-        free_enum_variants(head);
+        error(p, MINISSD_ERROR_EXPECTED_ENUM_SEPARATOR);
+        free_enum_variants(head, p->flags);
         return NULL;
     }
     advance(p);
     if (!head)
     {
-        error(p, "Enum must have at least one variant");
+        error(p, MINISSD_ERROR_EMPTY_ENUM);
         return NULL;
     }
     DBG("Parsed enum variants\n");
     return head;
 }
 
-static Type*
-parse_type(Parser* p)
+static bool
+parse_list_of(Parser* p)
 {
-    Type* type = (Type*)calloc(1, sizeof(Type));
-
-    size_t old_index   = p->index;
-    size_t old_current = p->current;
+    if (parse_keyword(p) != MINISSD_KEYWORD_OF)
+    {
+        error(p, MINISSD_ERROR_EXPECTED_OF);
+        return false;
+    }
+    eat_whitespaces_and_comments(p);
+    return true;
+}
 
-    char* list_ident = parse_identifier(p, CTX("property type 1"));
-    if (strcmp(list_ident, "list") == 0)
+// Fills the type embedded in its owner, which owns nothing on failure as the
+// name is parsed last
+static bool
+parse_type(Parser* p, Type* type)
+{
+    // `list of T` and `N of T` are told apart from plain type paths by their
+    // first token, so ordinary types never go through a failing parse
+    if (accept_keyword(p, MINISSD_KEYWORD_LIST))
     {
         eat_whitespaces_and_comments(p);
-        type->is_list  = true;
-        char* of_ident = parse_identifier(p, CTX("property type 2"));
-        if (!of_ident || strcmp(of_ident, "of") != 0)
+        type->is_list = true;
+        if (!parse_list_of(p))
         {
-            error(p, "Expected 'of' after 'list'");
-            if (of_ident)
-            {
-                free(of_ident);
-            }
-            free_type(type);
-            free(list_ident);
-            return NULL;
+            return false;
         }
-        eat_whitespaces_and_comments(p);
-        free(of_ident);
-    }
-    else
-    {
-        p->index   = old_index;
-        p->current = old_current;
     }
-    free(list_ident);
-
-    if (!type->is_list)
+    else if (at(p, MINISSD_TOKEN_INTEGER))
     {
-        int* number = parse_int(p, CTX("property type 1"));
-        if (number)
+        if (!parse_int(p, CTX("property type 1"), &type->count))
         {
-            eat_whitespaces_and_comments(p);
-            type->is_list  = true;
-            type->count    = number;
-            char* of_ident = parse_identifier(p, CTX("property type 2"));
-            if (!of_ident || strcmp(of_ident, "of") != 0)
-            {
-                error(p, "Expected 'of' after 'list'");
-                if (of_ident)
-                {
-                    free(of_ident);
-                }
-                free_type(type);
-                return NULL;
-            }
-            eat_whitespaces_and_comments(p);
-            free(of_ident);
+            return false;
         }
-        else
+        type->has_count = true;
+        eat_whitespaces_and_comments(p);
+        type->is_list = true;
+        if (!parse_list_of(p))
         {
-            p->index   = old_index;
-            p->current = old_current;
+            return false;
         }
     }
 
-    type->name = parse_path(p, CTX("property type"));
-
-    if (!type->name)
-    {
-        free_type(type);
-        return NULL;
-    };
-
-    return type;
+    type->name = parse_path(p, CTX("property type"), &type->name_length);
+    return type->name != NULL;
 }
 
 static Property*
 parse_properties(Parser* p)
 {
     DBG("Try parsing properties\n");
-    if (p->current != '{')
+    if (!at(p, MINISSD_TOKEN_LBRACE))
     {
-        error(p, "Expected '{' after data name");
+        error(p, MINISSD_ERROR_EXPECTED_DATA_OPEN);
         return NULL;
     }
     advance(p);
@@ -1015,11 +1294,11 @@ parse_properties(Parser* p)
     Property *head = NULL, *tail = NULL;
 
     eat_whitespaces_and_comments(p);
-    while (p->current != '}')
+    while (!at(p, MINISSD_TOKEN_RBRACE))
     {
         DBG("Parsing property\n");
 
-        Property* prop = (Property*)calloc(1, sizeof(Property));
+        Property* prop = (Property*)parser_alloc(p, sizeof(Property));
         assert(prop);
 
         eat_whitespaces_and_comments(p);
@@ -1030,21 +1309,22 @@ parse_properties(Parser* p)
         }
 
         eat_whitespaces_and_comments(p);
-        prop->name = parse_identifier(p, CTX("property"));
+        prop->name =
+            parse_identifier(p, CTX("property"), &prop->name_length);
         if (!prop->name)
         {
-            free_properties(prop);
-            free_properties(head);
+            free_properties(prop, p->flags);
+            free_properties(head, p->flags);
             return NULL;
         };
         DBG("Property name: %s\n", prop->name);
 
         eat_whitespaces_and_comments(p);
-        if (p->current != ':')
+        if (!at(p, MINISSD_TOKEN_COLON))
         {
-            error(p, "Expected ':' after property name");
-            free_properties(prop);
-            free_properties(head);
+            error(p, MINISSD_ERROR_EXPECTED_PROPERTY_COLON);
+            free_properties(prop, p->flags);
+            free_properties(head, p->flags);
             return NULL;
         }
         advance(p);
@@ -1052,13 +1332,10 @@ parse_properties(Parser* p)
 
         eat_whitespaces_and_comments(p);
 
-        DBG("Property type: %s\n", prop->type);
-
-        prop->type = parse_type(p);
-        if (!prop->type)
+        if (!parse_type(p, &prop->type))
         {
-            free_properties(prop);
-            free_properties(head);
+            free_properties(prop, p->flags);
+            free_properties(head, p->flags);
             return NULL;
         }
 
@@ -1073,7 +1350,7 @@ parse_properties(Parser* p)
         tail = prop;
 
         eat_whitespaces_and_comments(p);
-        if (p->current != ',')
+        if (!at(p, MINISSD_TOKEN_COMMA))
         {
             DBG("No more properties\n");
             break;
@@ -1083,17 +1360,17 @@ parse_properties(Parser* p)
     }
 
     eat_whitespaces_and_comments(p);
-    if (p->current != '}')
+    if (!at(p, MINISSD_TOKEN_RBRACE))
     {
-        error(p, "Expected ',' after property");
-        free_properties(head);
+        error(p, MINISSD_ERROR_EXPECTED_PROPERTY_SEPARATOR);
+        free_properties(head, p->flags);
         return NULL;
     }
     advance(p);
 
     if (!head)
     {
-        error(p, "Expected property");
+        error(p, MINISSD_ERROR_EXPECTED_PROPERTY);
         return NULL;
     }
     DBG("Parsed properties\n");
@@ -1106,10 +1383,10 @@ parse_handler_arguments(Parser* p)
 {
     DBG("Try parsing handler arguments\n");
     Argument *head = NULL, *tail = NULL;
-    while (p->current != ')')
+    while (!at(p, MINISSD_TOKEN_RPAREN))
     {
         DBG("Parsing handler argument\n");
-        Argument* arg = (Argument*)calloc(1, sizeof(Argument));
+        Argument* arg = (Argument*)parser_alloc(p, sizeof(Argument));
         assert(arg);
         eat_whitespaces_and_comments(p);
         arg->attributes = parse_attributes(p, CTX("handler argument"));
@@ -1118,36 +1395,37 @@ parse_handler_arguments(Parser* p)
             DBG("Found attributes\n");
         }
         eat_whitespaces_and_comments(p);
-        arg->name = parse_identifier(p, CTX("handler argument"));
+        arg->name =
+            parse_identifier(p, CTX("handler argument"), &arg->name_length);
         if (!arg->name)
         {
-            error(p, "Expected argument name");
-            free_arguments(arg);
-            free_arguments(head);
+            error(p, MINISSD_ERROR_EXPECTED_ARGUMENT_NAME);
+            free_arguments(arg, p->flags);
+            free_arguments(head, p->flags);
             return NULL;
         };
         DBG("Argument name: %s\n", arg->name);
         eat_whitespaces_and_comments(p);
-        if (p->current != ':')
+        if (!at(p, MINISSD_TOKEN_COLON))
         {
-            error(p, "Expected ':' after argument name");
-            free_arguments(arg);
-            free_arguments(head);
+            error(p, MINISSD_ERROR_EXPECTED_ARGUMENT_COLON);
+            free_arguments(arg, p->flags);
+            free_arguments(head, p->flags);
             return NULL;
         }
         advance(p);
         DBG("Parsing argument type\n");
         eat_whitespaces_and_comments(p);
-        arg->type = parse_type(p);
+        bool typed = parse_type(p, &arg->type);
         eat_whitespaces_and_comments(p);
-        if (!arg->type)
+        if (!typed)
         {
-            error(p, "Expected argument type");
-            free_arguments(arg);
-            free_arguments(head);
+            error(p, MINISSD_ERROR_EXPECTED_ARGUMENT_TYPE);
+            free_arguments(arg, p->flags);
+            free_arguments(head, p->flags);
             return NULL;
         };
-        DBG("Argument type: %s\n", arg->type);
+        DBG("Argument type: %s\n", arg->type.name);
 
         if (!head)
         {
@@ -1159,7 +1437,7 @@ parse_handler_arguments(Parser* p)
         }
         tail = arg;
 
-        if (p->current != ',')
+        if (!at(p, MINISSD_TOKEN_COMMA))
         {
             DBG("No more arguments\n");
             break;
@@ -1179,11 +1457,15 @@ typedef struct ServiceComponents
 } ServiceComponents;
 
 static void
-free_service_components(ServiceComponents* sc)
+free_service_components(ServiceComponents* sc, unsigned flags)
 {
-    free_handlers(sc->opt_ll_handlers);
-    free_dependencies(sc->opt_ll_dependencies);
-    free_events(sc->opt_ll_events);
+    if (flags & MINISSD_PARSE_ARENA)
+    {
+        return;
+    }
+    free_handlers(sc->opt_ll_handlers, flags);
+    free_dependencies(sc->opt_ll_dependencies, flags);
+    free_events(sc->opt_ll_events, flags);
     free(sc);
 }
 
@@ -1191,9 +1473,9 @@ static ServiceComponents*
 parse_service(Parser* p)
 {
     DBG("Try parsing service\n");
-    if (p->current != '{')
+    if (!at(p, MINISSD_TOKEN_LBRACE))
     {
-        error(p, "Expected '{' after service name");
+        error(p, MINISSD_ERROR_EXPECTED_SERVICE_OPEN);
         return NULL;
     }
     advance(p);
@@ -1202,7 +1484,7 @@ parse_service(Parser* p)
     Dependency *dep_head = NULL, *dep_tail = NULL;
     Event *     event_head = NULL, *event_tail = NULL;
 
-    while (p->current != '}')
+    while (!at(p, MINISSD_TOKEN_RBRACE))
     {
         DBG("Parsing service component\n");
         eat_whitespaces_and_comments(p);
@@ -1212,56 +1494,50 @@ parse_service(Parser* p)
             DBG("Found attributes\n");
         }
         eat_whitespaces_and_comments(p);
-        char* ident = parse_identifier(p, CTX("service component"));
-        if (!ident)
-        {
-            error(p, "Expected 'depends' or 'fn' keyword");
-            free(ident);
-            free_attributes(attributes);
-            free_dependencies(dep_head);
-            free_handlers(handler_head);
-            free_events(event_head);
+        if (!expect_identifier(p, CTX("service component")))
+        {
+            error(p, MINISSD_ERROR_EXPECTED_SERVICE_COMPONENT);
+            free_attributes(attributes, p->flags);
+            free_dependencies(dep_head, p->flags);
+            free_handlers(handler_head, p->flags);
+            free_events(event_head, p->flags);
             return NULL;
         };
-        DBG("Service component: %s\n", ident);
+        DBG("Service component: %.*s\n",
+            (int)p->token.length,
+            p->input + p->token.offset);
+        Keyword keyword = parse_keyword(p);
 
-        if (strcmp(ident, "depends") == 0)
+        if (keyword == MINISSD_KEYWORD_DEPENDS)
         {
             DBG("Parsing dependency\n");
-            Dependency* dep = (Dependency*)calloc(1, sizeof(Dependency));
+            Dependency* dep = (Dependency*)parser_alloc(p, sizeof(Dependency));
             assert(dep);
 
             dep->opt_ll_attributes = attributes;
 
             eat_whitespaces_and_comments(p);
-            char* on = parse_identifier(p, CTX("dependency"));
-            if (!on || strcmp(on, "on") != 0)
+            if (parse_keyword(p) != MINISSD_KEYWORD_ON)
             {
-                error(p, "Expected 'on' keyword");
-                free(ident);
-                if (on)
-                {
-                    free(on);
-                }
-                free_dependencies(dep);
-                free_dependencies(dep_head);
-                free_handlers(handler_head);
-                free_events(event_head);
+                error(p, MINISSD_ERROR_EXPECTED_ON);
+                free_dependencies(dep, p->flags);
+                free_dependencies(dep_head, p->flags);
+                free_handlers(handler_head, p->flags);
+                free_events(event_head, p->flags);
                 return NULL;
             }
-            free(on);
             eat_whitespaces_and_comments(p);
             DBG("Parsing dependency path\n");
 
-            dep->path = parse_path(p, CTX("dependency"));
+            dep->path =
+                parse_path(p, CTX("dependency"), &dep->path_length);
             if (!dep->path)
             {
-                error(p, "Expected dependency path");
-                free(ident);
-                free_dependencies(dep);
-                free_dependencies(dep_head);
-                free_handlers(handler_head);
-                free_events(event_head);
+                error(p, MINISSD_ERROR_EXPECTED_DEPENDENCY_PATH);
+                free_dependencies(dep, p->flags);
+                free_dependencies(dep_head, p->flags);
+                free_handlers(handler_head, p->flags);
+                free_events(event_head, p->flags);
                 return NULL;
             };
             DBG("Dependency path: %s\n", dep->path);
@@ -1276,39 +1552,38 @@ parse_service(Parser* p)
             }
             dep_tail = dep;
         }
-        else if (strcmp(ident, "fn") == 0)
+        else if (keyword == MINISSD_KEYWORD_FN)
         {
             DBG("Parsing handler\n");
-            Handler* handler = (Handler*)calloc(1, sizeof(Handler));
+            Handler* handler = (Handler*)parser_alloc(p, sizeof(Handler));
             assert(handler);
 
             handler->opt_ll_attributes = attributes;
 
             eat_whitespaces_and_comments(p);
-            handler->name = parse_identifier(p, CTX("handler"));
+            handler->name = parse_identifier(
+                p, CTX("handler"), &handler->name_length);
 
             if (!handler->name)
             {
-                error(p, "Expected handler name");
-                free(ident);
-                free_handlers(handler);
-                free_handlers(handler_head);
-                free_events(event_head);
-                free_dependencies(dep_head);
+                error(p, MINISSD_ERROR_EXPECTED_HANDLER_NAME);
+                free_handlers(handler, p->flags);
+                free_handlers(handler_head, p->flags);
+                free_events(event_head, p->flags);
+                free_dependencies(dep_head, p->flags);
                 return NULL;
             };
 
             DBG("Handler name: %s\n", handler->name);
 
             eat_whitespaces_and_comments(p);
-            if (p->current != '(')
+            if (!at(p, MINISSD_TOKEN_LPAREN))
             {
-                error(p, "Expected '(' after handler name");
-                free(ident);
-                free_handlers(handler);
-                free_handlers(handler_head);
-                free_events(event_head);
-                free_dependencies(dep_head);
+                error(p, MINISSD_ERROR_EXPECTED_HANDLER_OPEN);
+                free_handlers(handler, p->flags);
+                free_handlers(handler_head, p->flags);
+                free_events(event_head, p->flags);
+                free_dependencies(dep_head, p->flags);
                 return NULL;
             }
             advance(p);
@@ -1326,38 +1601,36 @@ parse_service(Parser* p)
             }
             eat_whitespaces_and_comments(p);
 
-            if (p->current != ')')
+            if (!at(p, MINISSD_TOKEN_RPAREN))
             {
-                error(p, "Expected ')' after handler arguments");
-                free(ident);
-                free_handlers(handler);
-                free_handlers(handler_head);
-                free_events(event_head);
-                free_dependencies(dep_head);
+                error(p, MINISSD_ERROR_EXPECTED_HANDLER_CLOSE);
+                free_handlers(handler, p->flags);
+                free_handlers(handler_head, p->flags);
+                free_events(event_head, p->flags);
+                free_dependencies(dep_head, p->flags);
                 return NULL;
             }
             advance(p);
 
             eat_whitespaces_and_comments(p);
-            if (p->current == '-' && peek(p) == '>')
+            if (at(p, MINISSD_TOKEN_ARROW))
             {
-                advance(p);
                 advance(p);
                 DBG("Parsing handler return type\n");
                 eat_whitespaces_and_comments(p);
-                handler->opt_return_type = parse_type(p);
+                handler->has_return_type =
+                    parse_type(p, &handler->return_type);
                 eat_whitespaces_and_comments(p);
-                if (!handler->opt_return_type)
+                if (!handler->has_return_type)
                 {
-                    error(p, "Expected return type after ':'");
-                    free(ident);
-                    free_handlers(handler);
-                    free_handlers(handler_head);
-                    free_events(event_head);
-                    free_dependencies(dep_head);
+                    error(p, MINISSD_ERROR_EXPECTED_RETURN_TYPE);
+                    free_handlers(handler, p->flags);
+                    free_handlers(handler_head, p->flags);
+                    free_events(event_head, p->flags);
+                    free_dependencies(dep_head, p->flags);
                     return NULL;
                 };
-                DBG("Handler return type: %s\n", handler->opt_return_type);
+                DBG("Handler return type: %s\n", handler->return_type.name);
             }
 
             if (!handler_head)
@@ -1370,36 +1643,35 @@ parse_service(Parser* p)
             }
             handler_tail = handler;
         }
-        else if (strcmp(ident, "event") == 0)
+        else if (keyword == MINISSD_KEYWORD_EVENT)
         {
             DBG("Parsing event\n");
-            Event* event = (Event*)calloc(1, sizeof(Event));
+            Event* event = (Event*)parser_alloc(p, sizeof(Event));
             assert(event);
             event->opt_ll_attributes = attributes;
 
             eat_whitespaces_and_comments(p);
-            event->name = parse_identifier(p, CTX("event"));
+            event->name =
+                parse_identifier(p, CTX("event"), &event->name_length);
             if (!event->name)
             {
-                error(p, "Expected event name");
-                free(ident);
-                free_events(event);
-                free_events(event_head);
-                free_dependencies(dep_head);
-                free_handlers(handler_head);
+                error(p, MINISSD_ERROR_EXPECTED_EVENT_NAME);
+                free_events(event, p->flags);
+                free_events(event_head, p->flags);
+                free_dependencies(dep_head, p->flags);
+                free_handlers(handler_head, p->flags);
                 return NULL;
             };
             DBG("Event name: %s\n", event->name);
 
             eat_whitespaces_and_comments(p);
-            if (p->current != '(')
+            if (!at(p, MINISSD_TOKEN_LPAREN))
             {
-                error(p, "Expected '(' after event name");
-                free(ident);
-                free_events(event);
-                free_events(event_head);
-                free_dependencies(dep_head);
-                free_handlers(handler_head);
+                error(p, MINISSD_ERROR_EXPECTED_EVENT_OPEN);
+                free_events(event, p->flags);
+                free_events(event_head, p->flags);
+                free_dependencies(dep_head, p->flags);
+                free_handlers(handler_head, p->flags);
                 return NULL;
             }
             advance(p);
@@ -1416,14 +1688,13 @@ parse_service(Parser* p)
                 DBG("No event arguments\n");
             }
             eat_whitespaces_and_comments(p);
-            if (p->current != ')')
+            if (!at(p, MINISSD_TOKEN_RPAREN))
             {
-                error(p, "Expected ')' after event arguments");
-                free(ident);
-                free_events(event);
-                free_events(event_head);
-                free_dependencies(dep_head);
-                free_handlers(handler_head);
+                error(p, MINISSD_ERROR_EXPECTED_EVENT_CLOSE);
+                free_events(event, p->flags);
+                free_events(event_head, p->flags);
+                free_dependencies(dep_head, p->flags);
+                free_handlers(handler_head, p->flags);
                 return NULL;
             }
             advance(p);
@@ -1442,24 +1713,21 @@ parse_service(Parser* p)
         }
         else
         {
-            error(p, "Expected 'depends' or 'fn' keyword");
-            free(ident);
-            free_events(event_head);
-            free_attributes(attributes);
-            free_dependencies(dep_head);
-            free_handlers(handler_head);
+            error(p, MINISSD_ERROR_EXPECTED_SERVICE_COMPONENT);
+            free_events(event_head, p->flags);
+            free_attributes(attributes, p->flags);
+            free_dependencies(dep_head, p->flags);
+            free_handlers(handler_head, p->flags);
             return NULL;
         }
 
-        free(ident);
-
         eat_whitespaces_and_comments(p);
-        if (p->current != ';')
+        if (!at(p, MINISSD_TOKEN_SEMICOLON))
         {
-            error(p, "Expected ';' after service component");
-            free_events(event_head);
-            free_dependencies(dep_head);
-            free_handlers(handler_head);
+            error(p, MINISSD_ERROR_EXPECTED_COMPONENT_END);
+            free_events(event_head, p->flags);
+            free_dependencies(dep_head, p->flags);
+            free_handlers(handler_head, p->flags);
             return NULL;
         }
         advance(p);
@@ -1472,7 +1740,7 @@ parse_service(Parser* p)
     DBG("Parsed service\n");
 
     ServiceComponents* sc =
-        (ServiceComponents*)calloc(1, sizeof(ServiceComponents));
+        (ServiceComponents*)parser_alloc(p, sizeof(ServiceComponents));
     sc->opt_ll_handlers     = handler_head;
     sc->opt_ll_dependencies = dep_head;
     sc->opt_ll_events       = event_head;
@@ -1484,6 +1752,7 @@ parse_node(Parser* p)
 {
     DBG("Parsing node\n");
     eat_whitespaces_and_comments(p);
+    size_t     start      = p->token.offset;
     Attribute* attributes = parse_attributes(p, CTX("node"));
     if (attributes)
     {
@@ -1491,42 +1760,44 @@ parse_node(Parser* p)
     }
 
     eat_whitespaces_and_comments(p);
-    char* ident = parse_identifier(p, CTX("node"));
-    if (!ident)
+    if (!expect_identifier(p, CTX("node")))
     {
-        free_attributes(attributes);
+        free_attributes(attributes, p->flags);
         return NULL;
     };
-    DBG("Node type: %s\n", ident);
-    AstNode* node = (AstNode*)calloc(1, sizeof(AstNode));
-    assert(node);
+    DBG("Node type: %.*s\n",
+        (int)p->token.length,
+        p->input + p->token.offset);
+    Keyword keyword = parse_keyword(p);
+    AstNode* node = (AstNode*)parser_alloc(p, sizeof(AstNode));
+    node->flags   = p->flags;
 
     eat_whitespaces_and_comments(p);
     node->opt_ll_attributes = attributes;
-    if (strcmp(ident, "import") == 0)
+    if (keyword == MINISSD_KEYWORD_IMPORT)
     {
         DBG("Parsing import\n");
         node->type                  = NODE_IMPORT;
-        node->node.import_node.path = parse_path(p, CTX("import"));
+        node->node.import_node.path = parse_path(
+            p, CTX("import"), &node->node.import_node.path_length);
         if (!node->node.import_node.path)
         {
-            error(p, "Expected import path");
-            free(ident);
-            free_ast(node);
+            error(p, MINISSD_ERROR_EXPECTED_IMPORT_PATH);
+            free_ast(node, p->flags);
             return NULL;
         };
         DBG("Import path: %s\n", node->node.import_node.path);
     }
-    else if (strcmp(ident, "data") == 0)
+    else if (keyword == MINISSD_KEYWORD_DATA)
     {
         DBG("Parsing data\n");
         node->type                = NODE_DATA;
-        node->node.data_node.name = parse_identifier(p, CTX("data"));
+        node->node.data_node.name = parse_identifier(
+            p, CTX("data"), &node->node.data_node.name_length);
         if (!node->node.data_node.name)
         {
-            error(p, "Expected data name");
-            free(ident);
-            free_ast(node);
+            error(p, MINISSD_ERROR_EXPECTED_DATA_NAME);
+            free_ast(node, p->flags);
             return NULL;
         };
         DBG("Data name: %s\n", node->node.data_node.name);
@@ -1534,22 +1805,21 @@ parse_node(Parser* p)
         node->node.data_node.ll_properties = parse_properties(p);
         if (!node->node.data_node.ll_properties)
         {
-            free(ident);
-            free_ast(node);
+            free_ast(node, p->flags);
             return NULL;
         };
         DBG("Parsed properties\n");
     }
-    else if (strcmp(ident, "enum") == 0)
+    else if (keyword == MINISSD_KEYWORD_ENUM)
     {
         DBG("Parsing enum\n");
         node->type                = NODE_ENUM;
-        node->node.enum_node.name = parse_identifier(p, CTX("enum"));
+        node->node.enum_node.name = parse_identifier(
+            p, CTX("enum"), &node->node.enum_node.name_length);
         if (!node->node.enum_node.name)
         {
-            error(p, "Expected enum name");
-            free(ident);
-            free_ast(node);
+            error(p, MINISSD_ERROR_EXPECTED_ENUM_NAME);
+            free_ast(node, p->flags);
             return NULL;
         };
         DBG("Enum name: %s\n", node->node.enum_node.name);
@@ -1557,152 +1827,5223 @@ parse_node(Parser* p)
         node->node.enum_node.ll_variants = parse_enum_variants(p);
         if (!node->node.enum_node.ll_variants)
         {
-            free(ident);
-            free_ast(node);
+            free_ast(node, p->flags);
             return NULL;
         };
         DBG("Parsed enum variants\n");
     }
-    else if (strcmp(ident, "service") == 0)
+    else if (keyword == MINISSD_KEYWORD_SERVICE)
+    {
+        DBG("Parsing service\n");
+        node->type                   = NODE_SERVICE;
+        node->node.service_node.name = parse_identifier(
+            p, CTX("service"), &node->node.service_node.name_length);
+        if (!node->node.service_node.name)
+        {
+            error(p, MINISSD_ERROR_EXPECTED_SERVICE_NAME);
+            free_ast(node, p->flags);
+            return NULL;
+        };
+        DBG("Service name: %s\n", node->node.service_node.name);
+        eat_whitespaces_and_comments(p);
+        ServiceComponents* sc = parse_service(p);
+        if (!sc)
+        {
+            free_ast(node, p->flags);
+            return NULL;
+        };
+        if (!sc->opt_ll_handlers && !sc->opt_ll_events)
+        {
+            error(p, MINISSD_ERROR_EMPTY_SERVICE);
+            free_service_components(sc, p->flags);
+            free_ast(node, p->flags);
+            return NULL;
+        }
+        DBG("Parsed service components\n");
+        node->node.service_node.opt_ll_handlers     = sc->opt_ll_handlers;
+        node->node.service_node.opt_ll_dependencies = sc->opt_ll_dependencies;
+        node->node.service_node.opt_ll_events       = sc->opt_ll_events;
+        release(p, sc);
+    }
+    else
+    {
+        error(p, MINISSD_ERROR_UNKNOWN_NODE);
+        free_ast(node, p->flags);
+        node = NULL;
+    }
+    if (node)
+    {
+        eat_whitespaces_and_comments(p);
+        if (!at(p, MINISSD_TOKEN_SEMICOLON))
+        {
+            switch (node->type)
+            {
+            case NODE_IMPORT:
+                error(p, MINISSD_ERROR_EXPECTED_IMPORT_END);
+                break;
+            case NODE_DATA:
+                error(p, MINISSD_ERROR_EXPECTED_DATA_END);
+                break;
+            case NODE_ENUM:
+                error(p, MINISSD_ERROR_EXPECTED_ENUM_END);
+                break;
+            case NODE_SERVICE:
+                error(p, MINISSD_ERROR_EXPECTED_SERVICE_END);
+                break;
+            }
+            free_ast(node, p->flags);
+            return NULL;
+        }
+        advance(p);
+        node->offset = start;
+        node->length = p->index - start;
+    }
+    DBG("Parsed node\n");
+    eat_whitespaces_and_comments(p);
+    return node;
+}
+
+// Parses nodes up to the end of the input into the list from *ast to *last,
+// which stays empty for input without nodes. Returns false on errors
+static bool
+parse_nodes(Parser* p, AstNode** ast, AstNode** last)
+{
+    *ast  = NULL;
+    *last = NULL;
+    while (!at(p, MINISSD_TOKEN_EOF))
+    {
+        AstNode* node = parse_node(p);
+        if (!node)
+        {
+            free_ast(*ast, p->flags);
+            *ast = NULL;
+            return false;
+        }
+        if (!*ast)
+        {
+            *ast = node;
+        }
+        else
+        {
+            (*last)->next = node;
+        }
+        *last = node;
+    }
+    return true;
+}
+
+static AstNode*
+parse(Parser* p)
+{
+    AstNode *ast, *last;
+    p->token = minissd_next_token(&p->lexer);
+    if (!parse_nodes(p, &ast, &last))
+    {
+        return NULL;
+    }
+    if (!ast)
+    {
+        error(p, MINISSD_ERROR_EMPTY_INPUT);
+        return NULL;
+    }
+    DBG("Parsed AST\n");
+    return ast;
+}
+
+// Push parsing state
+// A top-level declaration ends at a ';' at depth 0 outside strings and
+// comments. The scanner finds those ends without parsing and can be resumed
+// when the input arrives in pieces
+enum
+{
+    DECLARATION_CODE,
+    DECLARATION_SLASH,  // After a '/', which may start a comment
+    DECLARATION_STRING,
+    DECLARATION_COMMENT,
+    DECLARATION_NUL  // The input ended at a NUL
+};
+
+typedef struct
+{
+    long        depth;
+    uint8_t     state;
+    ScanKernels kernels;
+} DeclarationScanner;
+
+// Fed input is buffered until it holds complete declarations, which are
+// parsed and dropped from the buffer right away. The buffer thus only keeps
+// the declaration in progress, and offsets of the dropped input are
+// accounted for in base, lines and line_start
+struct PushState
+{
+    char*              buffer;
+    size_t             length;
+    size_t             capacity;
+    size_t             scanned;     // Bytes of buffer scanned for ends
+    size_t             complete;    // Bytes of buffer up to the last end
+    size_t             base;        // Stream offset of buffer[0]
+    size_t             lines;       // Newlines before buffer[0]
+    size_t             line_start;  // Stream offset of the current line
+    DeclarationScanner scanner;
+    AstNode*           ready;       // Parsed nodes not handed out yet
+    AstNode*           ready_last;
+    size_t             node_count;  // Nodes parsed so far
+    bool               ended;       // A NUL ended the input
+    bool               failed;
+};
+
+static void
+free_push_state(PushState* push)
+{
+    if (push)
+    {
+        minissd_free_ast(push->ready);
+        free(push->buffer);
+        free(push);
+    }
+}
+
+// Line and column of a stream offset, offsets in front of the buffered input
+// resolve to its start
+static void
+push_line_col(PushState const* push, size_t offset, int* line, int* column)
+{
+    size_t lines = push->lines;
+    size_t start = push->line_start;
+    size_t i;
+    offset = offset < push->base ? push->base : offset;
+    for (i = push->base; i < offset && i - push->base < push->length; i++)
+    {
+        if (push->buffer[i - push->base] == '\n')
+        {
+            lines++;
+            start = i + 1;
+        }
+    }
+    if (line)
+    {
+        *line = (int)lines + 1;
+    }
+    if (column)
+    {
+        *column = (int)(offset - start) + 1;
+    }
+}
+
+static Parser*
+create_parser(const char* input, size_t length)
+{
+    DBG("Creating parser\n");
+    assert(input || length == 0);
+    Parser* p = (Parser*)calloc(1, sizeof(Parser));
+    assert(p);
+    p->input        = input ? input : "";
+    p->input_length = length;
+    minissd_init_lexer(&p->lexer, p->input, length);
+    return p;
+}
+
+// Parser functions
+Parser*
+minissd_create_parser(const char* input)
+{
+    assert(input);
+    return create_parser(input, strlen(input));
+}
+
+Parser*
+minissd_create_parser_n(const char* input, size_t length)
+{
+    return create_parser(input, length);
+}
+
+void
+minissd_free_parser(Parser* p)
+{
+    if (!p)
+    {
+        return;
+    }
+    minissd_free_arena(&p->owned_arena);
+    free_intern_table(p->intern_table);
+    free_push_state(p->push);
+    free(p->line_starts);
+#if !defined(WASM) && !defined(_WIN32)
+    if (p->mapping)
+    {
+        munmap(p->mapping, p->mapping_length);
+    }
+#endif
+    free(p->owned_input);
+    free(p);
+}
+
+void
+minissd_set_parser_flags(Parser* p, unsigned flags)
+{
+    p->flags = flags;
+}
+
+void
+minissd_set_parser_arena(Parser* p, Arena* arena)
+{
+    p->arena = arena;
+    p->flags |= MINISSD_PARSE_ARENA;
+}
+
+// Positions
+static void
+build_line_index(Parser* p)
+{
+    size_t  capacity = 64;
+    size_t  count    = 0;
+    size_t* starts   = (size_t*)malloc(capacity * sizeof(size_t));
+    assert(starts);
+    starts[count++] = 0;
+
+    char const* cursor = p->input;
+    char const* end    = p->input + p->input_length;
+    while ((cursor = (char const*)memchr(cursor, '\n', end - cursor)))
+    {
+        cursor++;
+        if (count == capacity)
+        {
+            size_t* grown = (size_t*)malloc(capacity * 2 * sizeof(size_t));
+            assert(grown);
+            memcpy(grown, starts, capacity * sizeof(size_t));
+            free(starts);
+            starts = grown;
+            capacity *= 2;
+        }
+        starts[count++] = (size_t)(cursor - p->input);
+    }
+    p->line_starts = starts;
+    p->line_count  = count;
+}
+
+void
+minissd_offset_to_line_col(Parser* p, size_t offset, int* line, int* column)
+{
+    if (p->push)
+    {
+        push_line_col(p->push, offset, line, column);
+        return;
+    }
+    if (!p->line_starts)
+    {
+        build_line_index(p);
+    }
+    if (offset > p->input_length)
+    {
+        offset = p->input_length;
+    }
+
+    // Last line starting at or before offset
+    size_t low  = 0;
+    size_t high = p->line_count;
+    while (high - low > 1)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (p->line_starts[mid] <= offset)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    if (line)
+    {
+        *line = (int)low + 1;
+    }
+    if (column)
+    {
+        *column = (int)(offset - p->line_starts[low]) + 1;
+    }
+}
+
+// Error reporting
+ParseError const*
+minissd_get_error(Parser const* p)
+{
+    return p->last_error.code != MINISSD_ERROR_NONE ? &p->last_error : NULL;
+}
+
+size_t
+minissd_format_error(Parser* p, char* buffer, size_t size)
+{
+    ParseError const* e = minissd_get_error(p);
+    if (!e)
+    {
+        if (size)
+        {
+            buffer[0] = '\0';
+        }
+        return 0;
+    }
+
+    int line   = 0;
+    int column = 0;
+    minissd_offset_to_line_col(p, e->offset, &line, &column);
+
+    int written;
+    if (e->context)
+    {
+        written = snprintf(buffer,
+                           size,
+                           "Error: %s in context: %s at line %d, column %d",
+                           minissd_get_error_message(e->code),
+                           e->context,
+                           line,
+                           column);
+    }
+    else
+    {
+        written = snprintf(buffer,
+                           size,
+                           "Error: %s at line %d, column %d",
+                           minissd_get_error_message(e->code),
+                           line,
+                           column);
+    }
+    return written < 0 ? 0 : (size_t)written;
+}
+
+char const*
+minissd_get_error_message(ErrorCode code)
+{
+    if ((size_t)code >= sizeof(error_messages) / sizeof(error_messages[0]))
+    {
+        return NULL;
+    }
+    return error_messages[code];
+}
+
+// Interning
+int
+minissd_intern_id(char const* interned)
+{
+    return interned ? (int)intern_header(interned)->id : -1;
+}
+
+int
+minissd_intern_lookup(Parser const* p, char const* name, size_t length)
+{
+    return intern_find(
+        p->intern_table, name, length, hash_bytes(name, length));
+}
+
+char const*
+minissd_intern_string(Parser const* p, int id)
+{
+    InternTable const* t = p->intern_table;
+    return (t && id >= 0 && (size_t)id < t->count) ? t->strings[id] : NULL;
+}
+
+size_t
+minissd_intern_count(Parser const* p)
+{
+    return p->intern_table ? p->intern_table->count : 0;
+}
+
+// Arena functions
+void
+minissd_init_arena(Arena* arena, size_t block_size)
+{
+    arena->blocks           = NULL;
+    arena->block_size       = block_size;
+    arena->allocation_count = 0;
+    arena->block_count      = 0;
+}
+
+void
+minissd_free_arena(Arena* arena)
+{
+    ArenaBlock* block = arena->blocks;
+    while (block)
+    {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    minissd_init_arena(arena, arena->block_size);
+}
+
+// Lexer
+typedef struct KeywordSpelling
+{
+    char const* text;
+    size_t      length;
+} KeywordSpelling;
+
+// Indexed by Keyword
+static const KeywordSpelling keyword_spellings[] = {
+    { "", 0 },       { "import", 6 }, { "data", 4 }, { "enum", 4 },
+    { "service", 7 }, { "depends", 7 }, { "on", 2 },   { "fn", 2 },
+    { "event", 5 },  { "list", 4 },   { "of", 2 },
+};
+
+// Keyword candidate for each value of keyword_hash, collision free
+static const uint8_t keyword_slots[32] = {
+    0, 0, 5, 8, 0, 0, 10, 0, 0, 0, 0, 0, 1, 2, 6, 0,
+    9, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 3, 7, 0, 0, 0,
+};
+
+static unsigned
+keyword_hash(char const* s, size_t length)
+{
+    return ((unsigned char)s[0] * 2u + (unsigned char)s[length - 1] +
+            (unsigned)length) %
+           32u;
+}
+
+static uint8_t
+keyword_of(char const* s, size_t length)
+{
+    uint8_t                k        = keyword_slots[keyword_hash(s, length)];
+    KeywordSpelling const* spelling = &keyword_spellings[k];
+    if (k && spelling->length == length &&
+        memcmp(spelling->text, s, length) == 0)
+    {
+        return k;
+    }
+    return MINISSD_KEYWORD_NONE;
+}
+
+// Character classes of the lexer, independent of the C locale
+#define CHAR_SPACE 1
+#define CHAR_WORD 2
+#define CHAR_DIGIT 4
+
+static const unsigned char char_classes[256] = {
+    // 1: whitespace, 2: identifier character, 6: digit
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 0, 0, 0, 0, 0, 0,
+    0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 2,
+    0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 0,
+};
+
+static bool
+is_char(char c, unsigned char char_class)
+{
+    return (char_classes[(unsigned char)c] & char_class) != 0;
+}
+
+// Whitespace and identifier characters are classified a block at a time into
+// one bit per byte, runs of them then end at the next clear bit
+#define SCAN_BLOCK 64
+
+static void
+classify_scalar(char const* s, size_t n, uint64_t* space, uint64_t* word)
+{
+    uint64_t space_bits = 0;
+    uint64_t word_bits  = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        unsigned char char_class = char_classes[(unsigned char)s[i]];
+        space_bits |= (uint64_t)(char_class & CHAR_SPACE) << i;
+        word_bits |= (uint64_t)((char_class & CHAR_WORD) >> 1) << i;
+    }
+    *space = space_bits;
+    *word  = word_bits;
+}
+
+// Up to the end of a line comment
+static size_t
+scan_line_scalar(char const* s, size_t i, size_t end)
+{
+    while (i < end && s[i] != '\n' && s[i] != '\0')
+    {
+        i++;
+    }
+    return i;
+}
+
+// Up to the closing quote of a string
+static size_t
+scan_quote_scalar(char const* s, size_t i, size_t end)
+{
+    while (i < end && s[i] != '"' && s[i] != '\0')
+    {
+        i++;
+    }
+    return i;
+}
+
+typedef struct ScanFunctions
+{
+    // Classifies a full block of SCAN_BLOCK bytes
+    void (*classify)(char const* s, size_t n, uint64_t* space, uint64_t* word);
+    size_t (*line)(char const* s, size_t i, size_t end);
+    size_t (*quote)(char const* s, size_t i, size_t end);
+} ScanFunctions;
+
+#ifdef MINISSD_X86_KERNELS
+// Lanes of x within [lo, hi], using a signed compare after moving lo to -128
+#define IN_RANGE(set1, cmplt, add, x, lo, hi)                                  \
+    cmplt(add(x, set1((char)(0x80 - (lo)))),                                   \
+          set1((char)(-128 + (hi) - (lo) + 1)))
+
+#define SSE2_IN_RANGE(x, lo, hi)                                               \
+    IN_RANGE(_mm_set1_epi8, _mm_cmplt_epi8, _mm_add_epi8, x, lo, hi)
+
+__attribute__((target("sse2"))) static void
+classify_sse2(char const* s, size_t n, uint64_t* space, uint64_t* word)
+{
+    uint64_t space_bits = 0;
+    uint64_t word_bits  = 0;
+    for (size_t i = 0; i < n; i += 16)
+    {
+        __m128i v      = _mm_loadu_si128((__m128i const*)(s + i));
+        __m128i blank  = _mm_or_si128(SSE2_IN_RANGE(v, '\t', '\r'),
+                                     _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+        __m128i letter = SSE2_IN_RANGE(_mm_or_si128(v, _mm_set1_epi8(0x20)),
+                                       'a',
+                                       'z');
+        __m128i ident  = _mm_or_si128(
+            _mm_or_si128(letter, SSE2_IN_RANGE(v, '0', '9')),
+            _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+        space_bits |= (uint64_t)(uint16_t)_mm_movemask_epi8(blank) << i;
+        word_bits |= (uint64_t)(uint16_t)_mm_movemask_epi8(ident) << i;
+    }
+    *space = space_bits;
+    *word  = word_bits;
+}
+
+// The string and comment kernels test 16 bytes per step and leave the tail
+// to the scalar ones
+__attribute__((target("sse2"))) static size_t
+scan_line_sse2(char const* s, size_t i, size_t end)
+{
+    for (; i + 16 <= end; i += 16)
+    {
+        __m128i  v    = _mm_loadu_si128((__m128i const*)(s + i));
+        __m128i  hit  = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+                                   _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+        unsigned stop = (unsigned)_mm_movemask_epi8(hit);
+        if (stop)
+        {
+            return i + (size_t)__builtin_ctz(stop);
+        }
+    }
+    return scan_line_scalar(s, i, end);
+}
+
+__attribute__((target("sse2"))) static size_t
+scan_quote_sse2(char const* s, size_t i, size_t end)
+{
+    for (; i + 16 <= end; i += 16)
+    {
+        __m128i  v    = _mm_loadu_si128((__m128i const*)(s + i));
+        __m128i  hit  = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                                   _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+        unsigned stop = (unsigned)_mm_movemask_epi8(hit);
+        if (stop)
+        {
+            return i + (size_t)__builtin_ctz(stop);
+        }
+    }
+    return scan_quote_scalar(s, i, end);
+}
+
+#define AVX2_CMPLT(a, b) _mm256_cmpgt_epi8(b, a)
+#define AVX2_IN_RANGE(x, lo, hi)                                               \
+    IN_RANGE(_mm256_set1_epi8, AVX2_CMPLT, _mm256_add_epi8, x, lo, hi)
+
+__attribute__((target("avx2"))) static void
+classify_avx2(char const* s, size_t n, uint64_t* space, uint64_t* word)
+{
+    uint64_t space_bits = 0;
+    uint64_t word_bits  = 0;
+    for (size_t i = 0; i < n; i += 32)
+    {
+        __m256i v      = _mm256_loadu_si256((__m256i const*)(s + i));
+        __m256i blank  = _mm256_or_si256(
+            AVX2_IN_RANGE(v, '\t', '\r'),
+            _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+        __m256i letter = AVX2_IN_RANGE(
+            _mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z');
+        __m256i ident  = _mm256_or_si256(
+            _mm256_or_si256(letter, AVX2_IN_RANGE(v, '0', '9')),
+            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+        space_bits |= (uint64_t)(uint32_t)_mm256_movemask_epi8(blank) << i;
+        word_bits |= (uint64_t)(uint32_t)_mm256_movemask_epi8(ident) << i;
+    }
+    *space = space_bits;
+    *word  = word_bits;
+}
+
+// 32 bytes per step, finishing with the SSE2 kernels
+__attribute__((target("avx2"))) static size_t
+scan_line_avx2(char const* s, size_t i, size_t end)
+{
+    for (; i + 32 <= end; i += 32)
+    {
+        __m256i  v    = _mm256_loadu_si256((__m256i const*)(s + i));
+        __m256i  hit  = _mm256_or_si256(
+            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+            _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+        uint32_t stop = (uint32_t)_mm256_movemask_epi8(hit);
+        if (stop)
+        {
+            return i + (size_t)__builtin_ctz(stop);
+        }
+    }
+    return scan_line_sse2(s, i, end);
+}
+
+__attribute__((target("avx2"))) static size_t
+scan_quote_avx2(char const* s, size_t i, size_t end)
+{
+    for (; i + 32 <= end; i += 32)
+    {
+        __m256i  v    = _mm256_loadu_si256((__m256i const*)(s + i));
+        __m256i  hit  = _mm256_or_si256(
+            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+            _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+        uint32_t stop = (uint32_t)_mm256_movemask_epi8(hit);
+        if (stop)
+        {
+            return i + (size_t)__builtin_ctz(stop);
+        }
+    }
+    return scan_quote_sse2(s, i, end);
+}
+
+// Indexed by ScanKernels
+static const ScanFunctions scan_functions[] = {
+    { classify_scalar, scan_line_scalar, scan_quote_scalar },
+    { classify_sse2, scan_line_sse2, scan_quote_sse2 },
+    { classify_avx2, scan_line_avx2, scan_quote_avx2 },
+};
+#else
+static const ScanFunctions scan_functions[] = {
+    { classify_scalar, scan_line_scalar, scan_quote_scalar },
+    { classify_scalar, scan_line_scalar, scan_quote_scalar },
+    { classify_scalar, scan_line_scalar, scan_quote_scalar },
+};
+#endif
+
+static unsigned
+count_trailing_zeros(uint64_t bits)
+{
+#ifdef __GNUC__
+    return (unsigned)__builtin_ctzll(bits);
+#else
+    unsigned n = 0;
+    while (!(bits & 1))
+    {
+        bits >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+// Makes the lexer's classified block the one holding offset i
+static void
+load_block(Lexer* lexer, size_t i)
+{
+    size_t base = i - i % SCAN_BLOCK;
+    size_t n    = lexer->length - base;
+    if (n >= SCAN_BLOCK)
+    {
+        scan_functions[lexer->kernels].classify(lexer->input + base,
+                                                SCAN_BLOCK,
+                                                &lexer->space_bits,
+                                                &lexer->word_bits);
+    }
+    else
+    {
+        // Bytes past the end stay unclassified, which ends every run
+        classify_scalar(
+            lexer->input + base, n, &lexer->space_bits, &lexer->word_bits);
+    }
+    lexer->block = base;
+}
+
+// End of the run of whitespace (or identifier characters) starting at i
+static size_t
+scan_run(Lexer* lexer, size_t i, bool word)
+{
+    while (i < lexer->length)
+    {
+        if (i < lexer->block || i - lexer->block >= SCAN_BLOCK)
+        {
+            load_block(lexer, i);
+        }
+        uint64_t bits = word ? lexer->word_bits : lexer->space_bits;
+        uint64_t stop = ~bits >> (i - lexer->block);
+        if (stop)
+        {
+            return i + count_trailing_zeros(stop);
+        }
+        i = lexer->block + SCAN_BLOCK;
+    }
+    return lexer->length;
+}
+
+static TokenKind
+punctuation_kind(char c)
+{
+    switch (c)
+    {
+    case '#':
+        return MINISSD_TOKEN_HASH;
+    case '[':
+        return MINISSD_TOKEN_LBRACKET;
+    case ']':
+        return MINISSD_TOKEN_RBRACKET;
+    case '(':
+        return MINISSD_TOKEN_LPAREN;
+    case ')':
+        return MINISSD_TOKEN_RPAREN;
+    case '{':
+        return MINISSD_TOKEN_LBRACE;
+    case '}':
+        return MINISSD_TOKEN_RBRACE;
+    case ',':
+        return MINISSD_TOKEN_COMMA;
+    case ':':
+        return MINISSD_TOKEN_COLON;
+    case ';':
+        return MINISSD_TOKEN_SEMICOLON;
+    case '=':
+        return MINISSD_TOKEN_EQUALS;
+    default:
+        return MINISSD_TOKEN_UNKNOWN;
+    }
+}
+
+// Skips whitespace and `//` comments, a NUL ends the input like its length
+static size_t
+skip_trivia(Lexer* lexer, size_t i)
+{
+    char const* input = lexer->input;
+    for (;;)
+    {
+        // Tokens often follow each other directly
+        if (i < lexer->length && is_char(input[i], CHAR_SPACE))
+        {
+            i = scan_run(lexer, i, false);
+        }
+        if (i + 1 < lexer->length && input[i] == '/' && input[i + 1] == '/')
+        {
+            i = scan_functions[lexer->kernels].line(
+                input, i + 2, lexer->length);
+            continue;
+        }
+        if (i < lexer->length && input[i] == '\0')
+        {
+            lexer->length = i;
+        }
+        return i;
+    }
+}
+
+ScanKernels
+minissd_detect_scan_kernels(void)
+{
+#ifdef MINISSD_X86_KERNELS
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return MINISSD_SCAN_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return MINISSD_SCAN_SSE2;
+    }
+#endif
+    return MINISSD_SCAN_SCALAR;
+}
+
+void
+minissd_init_lexer(Lexer* lexer, const char* input, size_t length)
+{
+    lexer->input      = input;
+    lexer->length     = length;
+    lexer->offset     = 0;
+    lexer->kernels    = minissd_detect_scan_kernels();
+    lexer->block      = SIZE_MAX;
+    lexer->space_bits = 0;
+    lexer->word_bits  = 0;
+}
+
+Token
+minissd_next_token(Lexer* lexer)
+{
+    char const* input = lexer->input;
+    size_t      start = skip_trivia(lexer, lexer->offset);
+    size_t      end   = lexer->length;
+    size_t      i     = start;
+
+    Token token   = { 0 };
+    token.offset  = start;
+    token.kind    = MINISSD_TOKEN_EOF;
+    token.keyword = MINISSD_KEYWORD_NONE;
+    if (start == end)
+    {
+        lexer->offset = end;
+        return token;
+    }
+
+    char c = input[i];
+    if (is_char(c, CHAR_WORD))
+    {
+        i = scan_run(lexer, i, true);
+        // Words are integers when every character is a digit
+        size_t digit = start;
+        while (digit < i && is_char(input[digit], CHAR_DIGIT))
+        {
+            digit++;
+        }
+        if (digit == i)
+        {
+            token.kind = MINISSD_TOKEN_INTEGER;
+        }
+        else
+        {
+            token.kind    = MINISSD_TOKEN_IDENTIFIER;
+            token.keyword = keyword_of(input + start, i - start);
+        }
+    }
+    else if (c == '"')
+    {
+        i = scan_functions[lexer->kernels].quote(input, i + 1, end);
+        if (i < end && input[i] == '"')
+        {
+            token.kind = MINISSD_TOKEN_STRING;
+            i++;
+        }
+        else
+        {
+            token.kind = MINISSD_TOKEN_UNTERMINATED_STRING;
+            if (i < end && input[i] == '\0')
+            {
+                lexer->length = i;
+            }
+        }
+    }
+    else if (c == '-' && i + 1 < end && input[i + 1] == '>')
+    {
+        token.kind = MINISSD_TOKEN_ARROW;
+        i += 2;
+    }
+    else
+    {
+        token.kind = punctuation_kind(c);
+        i++;
+    }
+    // Token lengths are 32 bit, longer runs cannot be represented
+    if (i - start > UINT32_MAX)
+    {
+        token.kind    = MINISSD_TOKEN_UNKNOWN;
+        token.keyword = MINISSD_KEYWORD_NONE;
+        i             = start + UINT32_MAX;
+    }
+    token.length  = (uint32_t)(i - start);
+    lexer->offset = i;
+    return token;
+}
+
+Token*
+minissd_tokenize(const char* input, size_t length, size_t* opt_count)
+{
+    Lexer lexer;
+    minissd_init_lexer(&lexer, input, length);
+
+    size_t capacity = 64;
+    size_t count    = 0;
+    Token* tokens   = (Token*)malloc(capacity * sizeof(Token));
+    assert(tokens);
+    for (;;)
+    {
+        if (count == capacity)
+        {
+            Token* grown = (Token*)malloc(capacity * 2 * sizeof(Token));
+            assert(grown);
+            memcpy(grown, tokens, count * sizeof(Token));
+            free(tokens);
+            tokens = grown;
+            capacity *= 2;
+        }
+        tokens[count] = minissd_next_token(&lexer);
+        if (tokens[count++].kind == MINISSD_TOKEN_EOF)
+        {
+            break;
+        }
+    }
+    if (opt_count)
+    {
+        *opt_count = count;
+    }
+    return tokens;
+}
+
+void
+minissd_free_tokens(Token* tokens)
+{
+    free(tokens);
+}
+
+// Parsing
+// Fills in the position and message of the last error
+static void
+report_error(Parser* p)
+{
+    minissd_offset_to_line_col(p, p->last_error.offset, &p->line, &p->column);
+    minissd_format_error(p, p->error, MAX_ERROR_SIZE);
+}
+
+AstNode*
+minissd_parse(Parser* p)
+{
+    AstNode* ast = parse(p);
+    if (!ast)
+    {
+        report_error(p);
+    }
+    return ast;
+}
+
+void
+minissd_free_ast(AstNode* ast)
+{
+    if (ast)
+    {
+        free_ast(ast, ast->flags);
+    }
+}
+
+// Incremental parsing
+// The nodes in front of the edit are kept and parsing resumes behind the
+// last of them. It stops once the lookahead is past the edit and at the
+// start of an old node, as the input from there on is the same as before and
+// parses into the same nodes
+AstNode*
+minissd_reparse(Parser*     p,
+                AstNode*    old_ast,
+                const char* input,
+                size_t      length,
+                EditRange   edit)
+{
+    assert(input || length == 0);
+    assert(edit.start <= edit.old_end && edit.start <= edit.new_end);
+    assert(edit.new_end <= length);
+    p->input           = input ? input : "";
+    p->input_length    = length;
+    p->last_error.code = MINISSD_ERROR_NONE;
+    p->error[0]        = '\0';
+    free(p->line_starts);
+    p->line_starts = NULL;
+    p->line_count  = 0;
+    minissd_init_lexer(&p->lexer, p->input, length);
+    if (p->flags & MINISSD_PARSE_ZERO_COPY)
+    {
+        AstNode* ast = minissd_parse(p);
+        if (ast)
+        {
+            minissd_free_ast(old_ast);
+        }
+        return ast;
+    }
+    if ((p->flags & MINISSD_PARSE_ARENA) && !p->arena)
+    {
+        // The bytes of replaced nodes stay in the arena, compact it once
+        // they could outweigh the live AST
+        size_t      used  = 0;
+        ArenaBlock* block = p->owned_arena.blocks;
+        for (; block; block = block->next)
+        {
+            used += block->used;
+        }
+        size_t block_size = p->owned_arena.block_size
+                                ? p->owned_arena.block_size
+                                : MINISSD_ARENA_BLOCK_SIZE;
+        if (!p->reparse_live)
+        {
+            p->reparse_live = used;
+        }
+        if (used > 2 * p->reparse_live + block_size)
+        {
+            Arena old = p->owned_arena;
+            minissd_init_arena(&p->owned_arena, old.block_size);
+            AstNode* ast = minissd_parse(p);
+            if (!ast)
+            {
+                minissd_free_arena(&p->owned_arena);
+                p->owned_arena = old;
+                return NULL;
+            }
+            minissd_free_arena(&old);
+            block = p->owned_arena.blocks;
+            for (used = 0; block; block = block->next)
+            {
+                used += block->used;
+            }
+            p->reparse_live = used;
+            return ast;
+        }
+    }
+
+    AstNode* before = NULL;  // Last node kept in front of the edit
+    AstNode* node   = old_ast;
+    while (node && node->offset + node->length <= edit.start)
+    {
+        before = node;
+        node   = node->next;
+    }
+    AstNode* dropped = node;  // First node that may be parsed again
+    while (node && node->offset < edit.old_end)
+    {
+        node = node->next;
+    }
+    AstNode* behind = node;  // Candidate to resume the old nodes at
+
+    AstNode *ast = NULL, *last = NULL;
+    bool     synced = false;
+    p->lexer.offset = before ? before->offset + before->length : 0;
+    p->token        = minissd_next_token(&p->lexer);
+    while (!synced && !at(p, MINISSD_TOKEN_EOF))
+    {
+        size_t offset = p->token.offset;
+        while (offset >= edit.new_end && behind &&
+               behind->offset - edit.old_end + edit.new_end < offset)
+        {
+            behind = behind->next;
+        }
+        synced = offset >= edit.new_end && behind &&
+                 behind->offset - edit.old_end + edit.new_end == offset;
+        if (synced)
+        {
+            break;
+        }
+        AstNode* parsed = parse_node(p);
+        if (!parsed)
+        {
+            free_ast(ast, p->flags);
+            report_error(p);
+            return NULL;
+        }
+        if (last)
+        {
+            last->next = parsed;
+        }
+        else
+        {
+            ast = parsed;
+        }
+        last = parsed;
+    }
+    behind = synced ? behind : NULL;
+    if (!before && !ast && !behind)
+    {
+        error(p, MINISSD_ERROR_EMPTY_INPUT);
+        report_error(p);
+        return NULL;
+    }
+
+    // Only now that parsing succeeded is old_ast changed
+    if (dropped != behind)
+    {
+        node = dropped;
+        while (node->next != behind)
+        {
+            node = node->next;
+        }
+        node->next = NULL;
+        free_ast(dropped, dropped->flags);
+    }
+    for (node = behind; node; node = node->next)
+    {
+        node->offset = node->offset - edit.old_end + edit.new_end;
+    }
+    if (last)
+    {
+        last->next = behind;
+    }
+    else
+    {
+        ast = behind;
+    }
+    if (before)
+    {
+        before->next = ast;
+        return old_ast;
+    }
+    return ast;
+}
+
+// Event parsing
+static StringView
+string_view(char const* data, size_t length)
+{
+    StringView view;
+    view.data   = data;
+    view.length = length;
+    return view;
+}
+
+static bool
+emit_attributes(Attribute const*      attribute,
+                ParseCallbacks const* callbacks,
+                void*                 userdata)
+{
+    for (; attribute; attribute = attribute->next)
+    {
+        if (callbacks->on_attribute &&
+            !callbacks->on_attribute(
+                userdata,
+                string_view(attribute->name, attribute->name_length)))
+        {
+            return false;
+        }
+        AttributeParameter const* parameter = attribute->opt_ll_arguments;
+        for (; parameter; parameter = parameter->next)
+        {
+            if (callbacks->on_attribute_param &&
+                !callbacks->on_attribute_param(
+                    userdata,
+                    string_view(parameter->key, parameter->key_length),
+                    string_view(parameter->opt_value,
+                                parameter->value_length)))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool
+emit_arguments(Argument const*       argument,
+               ParseCallbacks const* callbacks,
+               void*                 userdata)
+{
+    for (; argument; argument = argument->next)
+    {
+        if (callbacks->on_argument &&
+            !callbacks->on_argument(
+                userdata,
+                string_view(argument->name, argument->name_length),
+                &argument->type))
+        {
+            return false;
+        }
+        if (!emit_attributes(argument->attributes, callbacks, userdata))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reports node through the callbacks, false once one of them returns false
+static bool
+emit_node(AstNode const* node, ParseCallbacks const* c, void* userdata)
+{
+    StringView name;
+    name.data = node_name(node, &name.length);
+    if ((c->begin_node && !c->begin_node(userdata, node->type, name)) ||
+        !emit_attributes(node->opt_ll_attributes, c, userdata))
+    {
+        return false;
+    }
+
+    if (node->type == NODE_DATA)
+    {
+        Property const* property = node->node.data_node.ll_properties;
+        for (; property; property = property->next)
+        {
+            if ((c->on_property &&
+                 !c->on_property(
+                     userdata,
+                     string_view(property->name, property->name_length),
+                     &property->type)) ||
+                !emit_attributes(property->attributes, c, userdata))
+            {
+                return false;
+            }
+        }
+    }
+    else if (node->type == NODE_ENUM)
+    {
+        EnumVariant const* variant = node->node.enum_node.ll_variants;
+        for (; variant; variant = variant->next)
+        {
+            if ((c->on_enum_variant &&
+                 !c->on_enum_variant(
+                     userdata,
+                     string_view(variant->name, variant->name_length),
+                     variant->has_value ? &variant->value : NULL)) ||
+                !emit_attributes(variant->attributes, c, userdata))
+            {
+                return false;
+            }
+        }
+    }
+    else if (node->type == NODE_SERVICE)
+    {
+        Service const*    service    = &node->node.service_node;
+        Dependency const* dependency = service->opt_ll_dependencies;
+        for (; dependency; dependency = dependency->next)
+        {
+            if ((c->on_dependency &&
+                 !c->on_dependency(userdata,
+                                   string_view(dependency->path,
+                                               dependency->path_length))) ||
+                !emit_attributes(dependency->opt_ll_attributes, c, userdata))
+            {
+                return false;
+            }
+        }
+        Handler const* handler = service->opt_ll_handlers;
+        for (; handler; handler = handler->next)
+        {
+            if ((c->on_handler &&
+                 !c->on_handler(
+                     userdata,
+                     string_view(handler->name, handler->name_length),
+                     minissd_get_handler_return_type(handler))) ||
+                !emit_attributes(handler->opt_ll_attributes, c, userdata) ||
+                !emit_arguments(handler->opt_ll_arguments, c, userdata))
+            {
+                return false;
+            }
+        }
+        Event const* event = service->opt_ll_events;
+        for (; event; event = event->next)
+        {
+            if ((c->on_event &&
+                 !c->on_event(userdata,
+                              string_view(event->name, event->name_length))) ||
+                !emit_attributes(event->opt_ll_attributes, c, userdata) ||
+                !emit_arguments(event->opt_ll_arguments, c, userdata))
+            {
+                return false;
+            }
+        }
+    }
+    return !c->end_node || c->end_node(userdata, node->type);
+}
+
+// Each declaration is parsed into a scratch arena as views into the input,
+// reported and dropped again, so memory stays bounded by the largest
+// declaration and nothing is copied or freed one by one
+bool
+minissd_parse_events(Parser*               p,
+                     ParseCallbacks const* callbacks,
+                     void*                 userdata)
+{
+    unsigned flags = p->flags;
+    Arena*   arena = p->arena;
+    Arena    scratch;
+    minissd_init_arena(&scratch, 0);
+    p->flags = (flags & ~(unsigned)MINISSD_PARSE_INTERN) |
+               MINISSD_PARSE_ARENA | MINISSD_PARSE_ZERO_COPY;
+    p->arena = &scratch;
+
+    bool ok      = true;
+    bool any     = false;
+    bool stopped = false;
+    p->token     = minissd_next_token(&p->lexer);
+    while (!stopped && !at(p, MINISSD_TOKEN_EOF))
+    {
+        AstNode* node = parse_node(p);
+        if (!node)
+        {
+            ok = false;
+            break;
+        }
+        any     = true;
+        stopped = !emit_node(node, callbacks, userdata);
+        arena_reset(&scratch);
+    }
+    if (ok && !any)
+    {
+        error(p, MINISSD_ERROR_EMPTY_INPUT);
+        ok = false;
+    }
+    minissd_free_arena(&scratch);
+    p->flags = flags;
+    p->arena = arena;
+    if (!ok)
+    {
+        report_error(p);
+    }
+    return ok;
+}
+
+// Declaration ends
+static void
+init_declaration_scanner(DeclarationScanner* scanner, ScanKernels kernels)
+{
+    scanner->depth   = 0;
+    scanner->state   = DECLARATION_CODE;
+    scanner->kernels = kernels;
+}
+
+// Scans s[*at, length) up to the next declaration end. Returns true with
+// *at just past its ';', or false with *at at the end of what was scanned
+static bool
+next_declaration_end(DeclarationScanner* scanner,
+                     char const*         s,
+                     size_t*             at,
+                     size_t              length)
+{
+    ScanFunctions const* scan = &scan_functions[scanner->kernels];
+    size_t               i    = *at;
+    while (i < length && scanner->state != DECLARATION_NUL)
+    {
+        if (scanner->state == DECLARATION_STRING ||
+            scanner->state == DECLARATION_COMMENT)
+        {
+            i = scanner->state == DECLARATION_STRING
+                    ? scan->quote(s, i, length)
+                    : scan->line(s, i, length);
+            if (i < length)
+            {
+                scanner->state =
+                    s[i] == '\0' ? DECLARATION_NUL : DECLARATION_CODE;
+                i++;
+            }
+            continue;
+        }
+        if (scanner->state == DECLARATION_SLASH)
+        {
+            scanner->state = DECLARATION_CODE;
+            if (s[i] == '/')
+            {
+                scanner->state = DECLARATION_COMMENT;
+                i++;
+                continue;
+            }
+        }
+        // Most bytes are whitespace or identifier characters
+        while (i < length && char_classes[(unsigned char)s[i]])
+        {
+            i++;
+        }
+        if (i == length)
+        {
+            break;
+        }
+        switch (s[i++])
+        {
+        case '\0':
+            scanner->state = DECLARATION_NUL;
+            i--;
+            break;
+        case '"':
+            scanner->state = DECLARATION_STRING;
+            break;
+        case '/':
+            scanner->state = DECLARATION_SLASH;
+            break;
+        case '{':
+        case '(':
+        case '[':
+            scanner->depth++;
+            break;
+        case '}':
+        case ')':
+        case ']':
+            scanner->depth--;
+            break;
+        case ';':
+            if (scanner->depth == 0)
+            {
+                *at = i;
+                return true;
+            }
+            break;
+        }
+    }
+    *at = i;
+    return false;
+}
+
+// Push parsing
+Parser*
+minissd_create_push_parser(void)
+{
+    Parser*    p    = create_parser(NULL, 0);
+    PushState* push = (PushState*)calloc(1, sizeof(PushState));
+    assert(push);
+    init_declaration_scanner(&push->scanner, p->lexer.kernels);
+    p->push = push;
+    return p;
+}
+
+// Parses buffer[0, length) into the ready nodes and drops it from the
+// buffer. The last piece of input also fails if there were no nodes at all
+static bool
+parse_buffered(Parser* p, size_t length, bool last_piece)
+{
+    PushState* push = p->push;
+    AstNode *  ast, *last;
+    p->input        = push->buffer;
+    p->input_length = length;
+    p->index        = 0;
+    p->flags &= ~(unsigned)MINISSD_PARSE_ZERO_COPY;
+    minissd_init_lexer(&p->lexer, push->buffer, length);
+    p->token = minissd_next_token(&p->lexer);
+    bool ok  = parse_nodes(p, &ast, &last);
+    if (ok && last_piece && !ast && push->node_count == 0)
+    {
+        error(p, MINISSD_ERROR_EMPTY_INPUT);
+        ok = false;
+    }
+    if (!ok)
+    {
+        push->failed = true;
+        p->last_error.offset += push->base;
+        report_error(p);
+        return false;
+    }
+
+    AstNode* node;
+    for (node = ast; node; node = node->next)
+    {
+        node->offset += push->base;
+        push->node_count++;
+    }
+    if (ast)
+    {
+        if (push->ready_last)
+        {
+            push->ready_last->next = ast;
+        }
+        else
+        {
+            push->ready = ast;
+        }
+        push->ready_last = last;
+    }
+
+    size_t i;
+    for (i = 0; i < length; i++)
+    {
+        if (push->buffer[i] == '\n')
+        {
+            push->lines++;
+            push->line_start = push->base + i + 1;
+        }
+    }
+    memmove(push->buffer, push->buffer + length, push->length - length);
+    push->length -= length;
+    push->scanned -= length;
+    push->complete -= length;
+    push->base += length;
+    return true;
+}
+
+bool
+minissd_parser_feed(Parser* p, const char* chunk, size_t length)
+{
+    PushState* push = p->push;
+    assert(push && (chunk || length == 0));
+    if (push->failed)
+    {
+        return false;
+    }
+    // Input ends at a NUL, like for minissd_parse
+    if (push->ended)
+    {
+        return true;
+    }
+    char const* nul = length ? (char const*)memchr(chunk, '\0', length) : NULL;
+    if (nul)
+    {
+        length      = (size_t)(nul - chunk);
+        push->ended = true;
+    }
+    if (push->length + length > push->capacity)
+    {
+        size_t capacity = push->capacity ? push->capacity : 4096;
+        while (capacity < push->length + length)
+        {
+            capacity *= 2;
+        }
+        char* buffer = (char*)malloc(capacity);
+        assert(buffer);
+        if (push->length)
+        {
+            memcpy(buffer, push->buffer, push->length);
+        }
+        free(push->buffer);
+        push->buffer   = buffer;
+        push->capacity = capacity;
+    }
+    if (length)
+    {
+        memcpy(push->buffer + push->length, chunk, length);
+    }
+    push->length += length;
+
+    while (next_declaration_end(
+        &push->scanner, push->buffer, &push->scanned, push->length))
+    {
+        push->complete = push->scanned;
+    }
+    return push->complete == 0 || parse_buffered(p, push->complete, false);
+}
+
+bool
+minissd_parser_finish(Parser* p)
+{
+    PushState* push = p->push;
+    assert(push);
+    return !push->failed && parse_buffered(p, push->length, true);
+}
+
+AstNode*
+minissd_parser_next_node(Parser* p)
+{
+    PushState* push = p->push;
+    AstNode*   node = push->ready;
+    if (node)
+    {
+        push->ready = node->next;
+        node->next  = NULL;
+        if (!push->ready)
+        {
+            push->ready_last = NULL;
+        }
+    }
+    return node;
+}
+
+// Parallel parsing of one input
+#ifndef MINISSD_PARALLEL_MIN_CHUNK
+#define MINISSD_PARALLEL_MIN_CHUNK (64 * 1024)
+#endif
+#define PARALLEL_CHUNKS_PER_THREAD 4
+
+#ifdef MINISSD_THREADS
+// Records the end of the first top-level declaration at or after every
+// multiple of target bytes. Returns how many ends were found
+static size_t
+find_chunk_ends(Lexer const* lexer, size_t target, size_t* ends, size_t max)
+{
+    DeclarationScanner scanner;
+    size_t             count = 0;
+    size_t             next  = target;
+    size_t             i     = 0;
+    init_declaration_scanner(&scanner, lexer->kernels);
+    while (count < max &&
+           next_declaration_end(&scanner, lexer->input, &i, lexer->length))
+    {
+        if (i >= next)
+        {
+            ends[count++] = i;
+            next          = i + target;
+        }
+    }
+    return count;
+}
+
+typedef struct
+{
+    Parser   parser;  // Lexes its slice of the shared input
+    AstNode* ast;
+    AstNode* last;
+    bool     ok;
+} ParseChunk;
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    ParseChunk*     chunks;
+    size_t          count;
+    size_t          next;
+    bool            failed;  // Remaining chunks are skipped
+} ChunkQueue;
+
+static void*
+parse_chunk_worker(void* arg)
+{
+    ChunkQueue* queue = (ChunkQueue*)arg;
+    for (;;)
+    {
+        pthread_mutex_lock(&queue->lock);
+        size_t i = queue->failed ? queue->count : queue->next++;
+        pthread_mutex_unlock(&queue->lock);
+        if (i >= queue->count)
+        {
+            return NULL;
+        }
+        ParseChunk* chunk  = &queue->chunks[i];
+        Parser*     parser = &chunk->parser;
+        parser->token      = minissd_next_token(&parser->lexer);
+        chunk->ok          = parse_nodes(parser, &chunk->ast, &chunk->last);
+        if (!chunk->ok)
+        {
+            pthread_mutex_lock(&queue->lock);
+            queue->failed = true;
+            pthread_mutex_unlock(&queue->lock);
+        }
+    }
+}
+
+// Moves the blocks of from behind those of to, keeping to's current block
+static void
+arena_adopt(Arena* to, Arena* from)
+{
+    ArenaBlock** tail = &to->blocks;
+    while (*tail)
+    {
+        tail = &(*tail)->next;
+    }
+    *tail = from->blocks;
+    to->allocation_count += from->allocation_count;
+    to->block_count += from->block_count;
+    from->blocks           = NULL;
+    from->allocation_count = 0;
+    from->block_count      = 0;
+}
+
+// Parses the chunks on up to threads threads and stitches their nodes in
+// source order, NULL if any chunk failed
+static AstNode*
+parse_chunks(Parser* p, ParseChunk* chunks, size_t count, unsigned threads)
+{
+    ChunkQueue queue;
+    pthread_t* workers = (pthread_t*)calloc(threads, sizeof(pthread_t));
+    bool*      started = (bool*)calloc(threads, sizeof(bool));
+    unsigned   t;
+    pthread_mutex_init(&queue.lock, NULL);
+    queue.chunks = chunks;
+    queue.count  = count;
+    queue.next   = 0;
+    queue.failed = false;
+    for (t = 1; workers && started && t < threads; t++)
+    {
+        started[t] =
+            pthread_create(&workers[t], NULL, parse_chunk_worker, &queue) == 0;
+    }
+    parse_chunk_worker(&queue);
+    for (t = 1; workers && started && t < threads; t++)
+    {
+        if (started[t])
+        {
+            pthread_join(workers[t], NULL);
+        }
+    }
+    pthread_mutex_destroy(&queue.lock);
+    free(workers);
+    free(started);
+
+    AstNode* ast  = NULL;
+    AstNode* last = NULL;
+    size_t   i;
+    for (i = 0; i < count; i++)
+    {
+        ParseChunk* chunk = &chunks[i];
+        if (queue.failed)
+        {
+            free_ast(chunk->ast, p->flags);
+            minissd_free_arena(&chunk->parser.owned_arena);
+            continue;
+        }
+        if (chunk->ast)
+        {
+            if (last)
+            {
+                last->next = chunk->ast;
+            }
+            else
+            {
+                ast = chunk->ast;
+            }
+            last = chunk->last;
+        }
+        p->allocation_count += chunk->parser.allocation_count;
+        arena_adopt(parser_arena(p), &chunk->parser.owned_arena);
+    }
+    return queue.failed ? NULL : ast;
+}
+#endif
+
+AstNode*
+minissd_parse_parallel(Parser* p, unsigned threads)
+{
+#ifdef MINISSD_THREADS
+    if (threads == 0)
+    {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads     = online > 0 ? (unsigned)online : 1;
+    }
+    size_t target = p->input_length / (threads * PARALLEL_CHUNKS_PER_THREAD);
+    if (target < MINISSD_PARALLEL_MIN_CHUNK)
+    {
+        target = MINISSD_PARALLEL_MIN_CHUNK;
+    }
+    // Interning shares one table, which the chunks cannot
+    if (threads < 2 || p->input_length < 2 * target ||
+        (p->flags & MINISSD_PARSE_INTERN))
+    {
+        return minissd_parse(p);
+    }
+
+    size_t      max    = p->input_length / target;
+    size_t*     ends   = (size_t*)malloc(max * sizeof(size_t));
+    ParseChunk* chunks = (ParseChunk*)calloc(max + 1, sizeof(ParseChunk));
+    size_t      count  = ends ? find_chunk_ends(&p->lexer, target, ends, max)
+                              : 0;
+    AstNode*    ast    = NULL;
+    if (chunks && count > 0)
+    {
+        // The last chunk runs to the end of the input
+        size_t start = 0;
+        size_t i;
+        for (i = 0; i <= count; i++)
+        {
+            size_t  end   = i < count ? ends[i] : p->input_length;
+            Parser* chunk = &chunks[i].parser;
+            chunk->input                  = p->input;
+            chunk->input_length           = end;
+            chunk->flags                  = p->flags;
+            chunk->owned_arena.block_size = parser_arena(p)->block_size;
+            minissd_init_lexer(&chunk->lexer, p->input, end);
+            chunk->lexer.offset = start;
+            start               = end;
+        }
+        ast = parse_chunks(p, chunks, count + 1, threads);
+    }
+    free(ends);
+    free(chunks);
+    // Failures are parsed again in sequence, which reports the same error
+    // minissd_parse would
+    return ast ? ast : minissd_parse(p);
+#else
+    (void)threads;
+    return minissd_parse(p);
+#endif
+}
+
+// File input
+#ifndef WASM
+// Reads a stream of unknown size, such as a pipe, into a heap buffer
+static char*
+read_stream(FILE* f, size_t* length)
+{
+    size_t capacity = 4096;
+    size_t size     = 0;
+    char*  buffer   = (char*)malloc(capacity);
+    while (buffer)
+    {
+        size += fread(buffer + size, 1, capacity - size, f);
+        if (size < capacity)
+        {
+            break;
+        }
+        capacity *= 2;
+        char* grown = (char*)realloc(buffer, capacity);
+        if (!grown)
+        {
+            free(buffer);
+        }
+        buffer = grown;
+    }
+    if (!buffer || ferror(f))
+    {
+        free(buffer);
+        return NULL;
+    }
+    *length = size;
+    return buffer;
+}
+
+static Parser*
+create_parser_from_stream(FILE* f)
+{
+    size_t length = 0;
+    char*  input  = read_stream(f, &length);
+    fclose(f);
+    if (!input)
+    {
+        return NULL;
+    }
+    Parser* p      = create_parser(input, length);
+    p->owned_input = input;
+    return p;
+}
+
+Parser*
+minissd_create_parser_from_file(const char* path)
+{
+#ifdef _WIN32
+    FILE* f = fopen(path, "rb");
+    return f ? create_parser_from_stream(f) : NULL;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+        (uintmax_t)st.st_size <= SIZE_MAX)
+    {
+        size_t length  = (size_t)st.st_size;
+        void*  mapping = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED)
+        {
+            close(fd);
+            posix_madvise(mapping, length, POSIX_MADV_SEQUENTIAL);
+            Parser* p         = create_parser((const char*)mapping, length);
+            p->mapping        = mapping;
+            p->mapping_length = length;
+            return p;
+        }
+    }
+    // Pipes, character devices and empty files cannot be mapped
+    FILE* f = fdopen(fd, "rb");
+    if (!f)
+    {
+        close(fd);
+        return NULL;
+    }
+    return create_parser_from_stream(f);
+#endif
+}
+
+AstNode*
+minissd_parse_file(const char* path, unsigned flags, Parser** parser)
+{
+    *parser = minissd_create_parser_from_file(path);
+    if (!*parser)
+    {
+        return NULL;
+    }
+    minissd_set_parser_flags(*parser, flags);
+    return minissd_parse(*parser);
+}
+
+// Parallel parsing
+// Files are dealt largest first and round-robin into one queue per worker.
+// Workers take the largest file left in their own queue and, once it is
+// empty, steal the smallest one left in another queue. Every parser is
+// independent, so the only shared state are the queues.
+typedef struct
+{
+    size_t size;
+    size_t index;
+} FileTask;
+
+static int
+compare_file_tasks(void const* a, void const* b)
+{
+    FileTask const* x = (FileTask const*)a;
+    FileTask const* y = (FileTask const*)b;
+    if (x->size != y->size)
+    {
+        return x->size > y->size ? -1 : 1;
+    }
+    return x->index < y->index ? -1 : x->index > y->index;
+}
+
+#ifdef MINISSD_THREADS
+typedef struct
+{
+    pthread_mutex_t lock;
+    size_t*         tasks;  // File indices, largest first
+    size_t          head;   // Taken by the owner
+    size_t          tail;   // Stolen by other workers
+} WorkQueue;
+
+typedef struct
+{
+    WorkQueue*         queues;
+    unsigned           queue_count;
+    const char* const* paths;
+    unsigned           flags;
+    ParseResult*       results;
+} ParsePool;
+
+typedef struct
+{
+    ParsePool* pool;
+    unsigned   index;
+    pthread_t  thread;
+} ParseWorker;
+
+static bool
+take_file(WorkQueue* q, bool steal, size_t* task)
+{
+    bool taken = false;
+    pthread_mutex_lock(&q->lock);
+    if (q->head < q->tail)
+    {
+        *task = steal ? q->tasks[--q->tail] : q->tasks[q->head++];
+        taken = true;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return taken;
+}
+
+static void*
+parse_worker(void* arg)
+{
+    ParseWorker* worker = (ParseWorker*)arg;
+    ParsePool*   pool   = worker->pool;
+    size_t       task;
+    for (;;)
+    {
+        bool     found = take_file(&pool->queues[worker->index], false, &task);
+        unsigned i;
+        for (i = 1; !found && i < pool->queue_count; i++)
+        {
+            unsigned victim = (worker->index + i) % pool->queue_count;
+            found           = take_file(&pool->queues[victim], true, &task);
+        }
+        // Nothing is ever queued again once all queues ran dry
+        if (!found)
+        {
+            return NULL;
+        }
+        ParseResult* result = &pool->results[task];
+        result->ast =
+            minissd_parse_file(pool->paths[task], pool->flags, &result->parser);
+    }
+}
+
+static bool
+parse_files_pooled(FileTask const*    order,
+                   size_t             count,
+                   unsigned           threads,
+                   unsigned           flags,
+                   const char* const* paths,
+                   ParseResult*       results)
+{
+    size_t       per_queue = (count + threads - 1) / threads;
+    size_t       capacity  = threads * per_queue;
+    WorkQueue*   queues    = (WorkQueue*)calloc(threads, sizeof(WorkQueue));
+    ParseWorker* workers = (ParseWorker*)calloc(threads, sizeof(ParseWorker));
+    size_t*      tasks   = (size_t*)malloc(capacity * sizeof(size_t));
+    ParsePool    pool;
+    unsigned     i;
+    if (!queues || !workers || !tasks)
+    {
+        free(queues);
+        free(workers);
+        free(tasks);
+        return false;
+    }
+    for (i = 0; i < threads; i++)
+    {
+        pthread_mutex_init(&queues[i].lock, NULL);
+        queues[i].tasks = tasks + i * per_queue;
+    }
+    size_t t;
+    for (t = 0; t < count; t++)
+    {
+        WorkQueue* q        = &queues[t % threads];
+        q->tasks[q->tail++] = order[t].index;
+    }
+
+    pool.queues      = queues;
+    pool.queue_count = threads;
+    pool.paths       = paths;
+    pool.flags       = flags;
+    pool.results     = results;
+    // The calling thread is worker 0, workers that fail to start leave
+    // their queue to be stolen
+    for (i = 0; i < threads; i++)
+    {
+        workers[i].pool  = &pool;
+        workers[i].index = i;
+    }
+    bool* started = (bool*)calloc(threads, sizeof(bool));
+    for (i = 1; started && i < threads; i++)
+    {
+        started[i] = pthread_create(&workers[i].thread,
+                                    NULL,
+                                    parse_worker,
+                                    &workers[i]) == 0;
+    }
+    parse_worker(&workers[0]);
+    for (i = 1; started && i < threads; i++)
+    {
+        if (started[i])
+        {
+            pthread_join(workers[i].thread, NULL);
+        }
+    }
+
+    for (i = 0; i < threads; i++)
+    {
+        pthread_mutex_destroy(&queues[i].lock);
+    }
+    free(started);
+    free(queues);
+    free(workers);
+    free(tasks);
+    return true;
+}
+#endif
+
+size_t
+minissd_parse_files(const char* const* paths,
+                    size_t             count,
+                    unsigned           threads,
+                    unsigned           flags,
+                    ParseResult*       results)
+{
+    size_t i;
+    assert(paths || count == 0);
+    memset(results, 0, count * sizeof(ParseResult));
+#ifdef MINISSD_THREADS
+    if (threads == 0)
+    {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads     = online > 0 ? (unsigned)online : 1;
+    }
+    if (threads > count)
+    {
+        threads = (unsigned)count;
+    }
+    bool      pooled = false;
+    FileTask* order  = NULL;
+    if (threads > 1)
+    {
+        order = (FileTask*)malloc(count * sizeof(FileTask));
+    }
+    if (order)
+    {
+        for (i = 0; i < count; i++)
+        {
+            struct stat st;
+            order[i].index = i;
+            order[i].size  = stat(paths[i], &st) == 0 ? (size_t)st.st_size : 0;
+        }
+        qsort(order, count, sizeof(FileTask), compare_file_tasks);
+        pooled =
+            parse_files_pooled(order, count, threads, flags, paths, results);
+        free(order);
+    }
+#else
+    bool pooled = false;
+    (void)threads;
+#endif
+    size_t failed = 0;
+    for (i = 0; i < count; i++)
+    {
+        // Without a pool the files are parsed here, in order
+        if (!pooled)
+        {
+            results[i].ast =
+                minissd_parse_file(paths[i], flags, &results[i].parser);
+        }
+        failed += results[i].ast == NULL;
+    }
+    return failed;
+}
+
+void
+minissd_free_parse_results(ParseResult* results, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        minissd_free_ast(results[i].ast);
+        minissd_free_parser(results[i].parser);
+        results[i].ast    = NULL;
+        results[i].parser = NULL;
+    }
+}
+
+// Modules
+// Workers take the next module not taken yet, parse it and resolve its
+// imports right away, adding every file not seen before. Files are keyed in
+// an intern table, whose dense ids are the module indices until the graph
+// is renumbered in breadth-first order at the end.
+typedef struct
+{
+    InternTable        files;    // Canonical file paths
+    Module**           modules;  // Indexed by file id
+    size_t             capacity;
+    size_t             head;  // Modules before it have been taken
+    size_t             busy;  // Modules being parsed
+    const char* const* roots;
+    size_t             root_count;
+    unsigned           flags;
+    bool               failed;  // Allocation failure, stop taking work
+#ifdef MINISSD_THREADS
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;
+#endif
+} ModuleLoader;
+
+static void
+loader_lock(ModuleLoader* l)
+{
+#ifdef MINISSD_THREADS
+    pthread_mutex_lock(&l->lock);
+#else
+    (void)l;
+#endif
+}
+
+static void
+loader_unlock(ModuleLoader* l)
+{
+#ifdef MINISSD_THREADS
+    pthread_mutex_unlock(&l->lock);
+#else
+    (void)l;
+#endif
+}
+
+static char*
+copy_string(char const* s, size_t length)
+{
+    char* copy = (char*)malloc(length + 1);
+    if (copy)
+    {
+        memcpy(copy, s, length);
+        copy[length] = '\0';
+    }
+    return copy;
+}
+
+static bool
+is_file(char const* path)
+{
+#ifdef _WIN32
+    FILE* f = fopen(path, "rb");
+    if (f)
+    {
+        fclose(f);
+    }
+    return f != NULL;
+#else
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode);
+#endif
+}
+
+enum
+{
+    IMPORT_FOUND,
+    IMPORT_MISSING,
+    IMPORT_OUT_OF_MEMORY  // Whether a file matches is unknown
+};
+
+// Finds the file of the import path, trying the whole path as a module
+// before its parent. *path and *name receive copies of the file and module
+// path if it is found
+static int
+resolve_import(ModuleLoader const* l,
+               char const*         import,
+               size_t              length,
+               char**              path,
+               char**              name)
+{
+    // Module paths are ::-separated identifiers, the file path uses '/'
+    size_t last = 0;  // Start of the last segment
+    size_t i;
+    for (i = 0; i < length; i++)
+    {
+        if (import[i] == ':' &&
+            (i + 1 >= length || import[i + 1] != ':' || i == 0 ||
+             i + 2 >= length || import[i + 2] == ':'))
+        {
+            return IMPORT_MISSING;
+        }
+        if (import[i] == ':')
+        {
+            last = i + 2;
+            i++;
+        }
+    }
+    size_t candidates[2] = { length, last ? last - 2 : 0 };
+    int    c;
+    for (c = 0; c < 2 && candidates[c]; c++)
+    {
+        size_t r;
+        for (r = 0; r < l->root_count; r++)
+        {
+            size_t root   = strlen(l->roots[r]);
+            size_t size   = root + candidates[c] + 6;
+            char*  buffer = (char*)malloc(size);
+            if (!buffer)
+            {
+                return IMPORT_OUT_OF_MEMORY;
+            }
+            memcpy(buffer, l->roots[r], root);
+            size_t n      = root;
+            buffer[n++]   = '/';
+            for (i = 0; i < candidates[c]; i++)
+            {
+                buffer[n++] = import[i];
+                if (import[i] == ':')
+                {
+                    buffer[n - 1] = '/';
+                    i++;
+                }
+            }
+            memcpy(buffer + n, ".ssd", 5);
+            if (is_file(buffer))
+            {
+                *name = copy_string(import, candidates[c]);
+                if (!*name)
+                {
+                    free(buffer);
+                    return IMPORT_OUT_OF_MEMORY;
+                }
+                *path = buffer;
+                return IMPORT_FOUND;
+            }
+            free(buffer);
+        }
+    }
+    return IMPORT_MISSING;
+}
+
+// Identifies files independent of how their path is spelled
+static char*
+file_key(char const* path)
+{
+#ifndef _WIN32
+    char* resolved = realpath(path, NULL);
+    if (resolved)
+    {
+        return resolved;
+    }
+#endif
+    return copy_string(path, strlen(path));
+}
+
+// Adds the module unless its file is known already, called under the lock
+// and taking over the strings. Returns its index or -1 on allocation failure
+static long
+add_module(ModuleLoader* l, char* key, char* path, char* name)
+{
+    size_t length = key ? strlen(key) : 0;
+    int    id     = -1;
+    if (key && path && name)
+    {
+        id = intern_find(&l->files, key, length, hash_bytes(key, length));
+    }
+    Module* module = NULL;
+    if (id < 0 && key && path && name)
+    {
+        module = (Module*)calloc(1, sizeof(Module));
+    }
+    if (module && l->files.count == l->capacity)
+    {
+        size_t   capacity = l->capacity ? l->capacity * 2 : 16;
+        Module** modules =
+            (Module**)realloc(l->modules, capacity * sizeof(Module*));
+        if (modules)
+        {
+            l->modules  = modules;
+            l->capacity = capacity;
+        }
+        else
+        {
+            free(module);
+            module = NULL;
+        }
+    }
+    if (module)
+    {
+        module->path = path;
+        module->name = name;
+        id           = (int)intern_header(intern_in(&l->files,
+                                                    key,
+                                                    length,
+                                                    hash_bytes(key, length)))
+                 ->id;
+        l->modules[id] = module;
+#ifdef MINISSD_THREADS
+        pthread_cond_signal(&l->wake);
+#endif
+    }
+    else
+    {
+        free(path);
+        free(name);
+    }
+    free(key);
+    return id;
+}
+
+// Parses the module and links it to the modules it imports
+static void
+load_module(ModuleLoader* l, Module* module)
+{
+    module->ast = minissd_parse_file(module->path, l->flags, &module->parser);
+    AstNode const* node;
+    size_t         count = 0;
+    for (node = module->ast; node; node = node->next)
+    {
+        count += node->type == NODE_IMPORT;
+    }
+    // Resolved outside the lock, one file per import
+    char**  keys    = (char**)calloc(count + 1, sizeof(char*));
+    char**  paths   = (char**)calloc(count + 1, sizeof(char*));
+    char**  names   = (char**)calloc(count + 1, sizeof(char*));
+    size_t* imports = (size_t*)malloc((count + 1) * sizeof(size_t));
+    bool    ok      = keys && paths && names && imports;
+    size_t  found   = 0;
+    for (node = module->ast; ok && node; node = node->next)
+    {
+        Import const* import = &node->node.import_node;
+        if (node->type != NODE_IMPORT)
+        {
+            continue;
+        }
+        int resolution = resolve_import(l,
+                                        import->path,
+                                        import->path_length,
+                                        &paths[found],
+                                        &names[found]);
+        if (resolution == IMPORT_FOUND)
+        {
+            keys[found] = file_key(paths[found]);
+            found++;
+        }
+        else if (resolution == IMPORT_OUT_OF_MEMORY)
+        {
+            // Never reported as a missing module
+            ok = false;
+        }
+        else if (!module->unresolved)
+        {
+            module->unresolved = copy_string(import->path, import->path_length);
+            ok                 = module->unresolved != NULL;
+        }
+    }
+
+    loader_lock(l);
+    l->failed |= !ok;
+    size_t i;
+    for (i = 0; i < found; i++)
+    {
+        long id = -1;
+        if (!l->failed)
+        {
+            id = add_module(l, keys[i], paths[i], names[i]);
+        }
+        else
+        {
+            free(keys[i]);
+            free(paths[i]);
+            free(names[i]);
+        }
+        if (id < 0)
+        {
+            l->failed = true;
+            continue;
+        }
+        size_t j;
+        for (j = 0; j < module->import_count; j++)
+        {
+            if (imports[j] == (size_t)id)
+            {
+                break;
+            }
+        }
+        if (j == module->import_count)
+        {
+            imports[module->import_count++] = (size_t)id;
+        }
+    }
+    module->imports = imports;
+    l->busy--;
+#ifdef MINISSD_THREADS
+    if (l->busy == 0)
+    {
+        pthread_cond_broadcast(&l->wake);
+    }
+#endif
+    loader_unlock(l);
+    free(keys);
+    free(paths);
+    free(names);
+}
+
+static void*
+module_worker(void* arg)
+{
+    ModuleLoader* l = (ModuleLoader*)arg;
+    loader_lock(l);
+    for (;;)
+    {
+        bool idle = l->head == l->files.count || l->failed;
+        if (idle && l->busy == 0)
+        {
+            break;
+        }
+        if (idle)
+        {
+#ifdef MINISSD_THREADS
+            pthread_cond_wait(&l->wake, &l->lock);
+#endif
+            continue;
+        }
+        Module* module = l->modules[l->head++];
+        l->busy++;
+        loader_unlock(l);
+        load_module(l, module);
+        loader_lock(l);
+    }
+    loader_unlock(l);
+    return NULL;
+}
+
+static void
+free_module(Module* module)
+{
+    minissd_free_ast(module->ast);
+    minissd_free_parser(module->parser);
+    free(module->name);
+    free(module->path);
+    free(module->imports);
+    free(module->unresolved);
+}
+
+static char const*
+module_label(Module const* module)
+{
+    return module->name[0] ? module->name : module->path;
+}
+
+// Appends to graph->error as long as there is room
+static void
+append_error(ModuleGraph* graph, size_t* used, char const* a, char const* b)
+{
+    if (*used < MAX_ERROR_SIZE)
+    {
+        int n = snprintf(
+            graph->error + *used, MAX_ERROR_SIZE - *used, "%s%s", a, b);
+        *used += n > 0 ? (size_t)n : 0;
+    }
+}
+
+// Fills graph->order depth first, imports before importers. Returns false
+// at the first cycle and describes it in graph->error
+static bool
+order_modules(ModuleGraph* graph)
+{
+    size_t   n       = graph->module_count;
+    size_t*  stack   = (size_t*)malloc(n * sizeof(size_t));
+    size_t*  next    = (size_t*)calloc(n, sizeof(size_t));
+    uint8_t* state   = (uint8_t*)calloc(n, 1);  // 1 on the stack, 2 ordered
+    size_t   depth   = 0;
+    size_t   ordered = 0;
+    bool     acyclic = stack && next && state;
+    if (acyclic)
+    {
+        stack[depth++] = 0;
+        state[0]       = 1;
+    }
+    while (acyclic && depth > 0)
+    {
+        size_t  top    = stack[depth - 1];
+        Module* module = &graph->modules[top];
+        if (next[top] == module->import_count)
+        {
+            state[top]              = 2;
+            graph->order[ordered++] = top;
+            depth--;
+            continue;
+        }
+        size_t imported = module->imports[next[top]++];
+        if (state[imported] == 0)
+        {
+            state[imported] = 1;
+            stack[depth++]  = imported;
+        }
+        else if (state[imported] == 1)
+        {
+            // The stack holds the cycle from the imported module on
+            size_t used = 0;
+            size_t from = depth - 1;
+            while (stack[from] != imported)
+            {
+                from--;
+            }
+            append_error(graph, &used, "Error: Import cycle ", "");
+            for (; from < depth; from++)
+            {
+                append_error(graph,
+                             &used,
+                             module_label(&graph->modules[stack[from]]),
+                             " -> ");
+            }
+            append_error(
+                graph, &used, module_label(&graph->modules[imported]), "");
+            acyclic = false;
+        }
+    }
+    free(stack);
+    free(next);
+    free(state);
+    return acyclic;
+}
+
+// Moves the loaded modules into graph, numbered breadth first from the root
+// so the numbering does not depend on which thread found a module first
+static bool
+number_modules(ModuleGraph* graph, ModuleLoader* l)
+{
+    size_t  n     = l->files.count;
+    size_t* index = (size_t*)malloc(n * sizeof(size_t));  // Loader to graph
+    size_t* bfs   = (size_t*)malloc(n * sizeof(size_t));  // Graph to loader
+    graph->modules = (Module*)calloc(n, sizeof(Module));
+    graph->order   = (size_t*)malloc(n * sizeof(size_t));
+    if (!index || !bfs || !graph->modules || !graph->order)
+    {
+        free(index);
+        free(bfs);
+        return false;
+    }
+    size_t i;
+    for (i = 0; i < n; i++)
+    {
+        index[i] = SIZE_MAX;
+    }
+    size_t count = 0;
+    bfs[count++] = 0;
+    index[0]     = 0;
+    for (i = 0; i < count; i++)
+    {
+        Module const* module = l->modules[bfs[i]];
+        size_t        j;
+        for (j = 0; j < module->import_count; j++)
+        {
+            if (index[module->imports[j]] == SIZE_MAX)
+            {
+                index[module->imports[j]] = count;
+                bfs[count++]              = module->imports[j];
+            }
+        }
+    }
+    // Every module was discovered through an import, so all are reachable
+    assert(count == n);
+    for (i = 0; i < n; i++)
+    {
+        Module* module = l->modules[bfs[i]];
+        size_t  j;
+        for (j = 0; j < module->import_count; j++)
+        {
+            module->imports[j] = index[module->imports[j]];
+        }
+        graph->modules[i] = *module;
+        free(module);
+        l->modules[bfs[i]] = NULL;
+    }
+    graph->module_count = n;
+    free(index);
+    free(bfs);
+    return true;
+}
+
+// Reports the first module, in graph order, that failed to load
+static bool
+check_modules(ModuleGraph* graph)
+{
+    size_t i;
+    for (i = 0; i < graph->module_count; i++)
+    {
+        Module const* module = &graph->modules[i];
+        if (!module->parser)
+        {
+            graph->status = MINISSD_MODULES_UNREADABLE;
+            snprintf(graph->error,
+                     MAX_ERROR_SIZE,
+                     "Error: Cannot read module file %s",
+                     module->path);
+            return false;
+        }
+        if (!module->ast)
+        {
+            size_t used   = 0;
+            graph->status = MINISSD_MODULES_PARSE_ERROR;
+            append_error(graph, &used, module->path, ": ");
+            append_error(graph, &used, module->parser->error, "");
+            return false;
+        }
+        if (module->unresolved)
+        {
+            graph->status = MINISSD_MODULES_UNRESOLVED;
+            snprintf(graph->error,
+                     MAX_ERROR_SIZE,
+                     "Error: Cannot resolve import %s in %s",
+                     module->unresolved,
+                     module->path);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Lists the declarations of all modules, imports before importers
+static bool
+merge_modules(ModuleGraph* graph)
+{
+    size_t         count = 0;
+    size_t         i;
+    AstNode const* node;
+    for (i = 0; i < graph->module_count; i++)
+    {
+        for (node = graph->modules[i].ast; node; node = node->next)
+        {
+            count += node->type != NODE_IMPORT;
+        }
+    }
+    graph->nodes =
+        (AstNode const**)malloc((count ? count : 1) * sizeof(AstNode*));
+    if (!graph->nodes)
+    {
+        return false;
+    }
+    for (i = 0; i < graph->module_count; i++)
+    {
+        node = graph->modules[graph->order[i]].ast;
+        for (; node; node = node->next)
+        {
+            if (node->type != NODE_IMPORT)
+            {
+                graph->nodes[graph->node_count++] = node;
+            }
+        }
+    }
+    return true;
+}
+
+// Directory part of path, "." if it has none
+static char*
+directory_of(char const* path)
+{
+    char const* slash = strrchr(path, '/');
+#ifdef _WIN32
+    char const* backslash = strrchr(path, '\\');
+    slash = backslash && (!slash || backslash > slash) ? backslash : slash;
+#endif
+    return slash ? copy_string(path, (size_t)(slash - path))
+                 : copy_string(".", 1);
+}
+
+ModuleGraph*
+minissd_load_modules(const char*        path,
+                     const char* const* search_roots,
+                     size_t             root_count,
+                     unsigned           threads,
+                     unsigned           flags)
+{
+    ModuleLoader l;
+    ModuleGraph* graph     = (ModuleGraph*)calloc(1, sizeof(ModuleGraph));
+    char*        directory = root_count ? NULL : directory_of(path);
+    assert(path);
+    memset(&l, 0, sizeof(l));
+    l.roots      = root_count ? search_roots : (const char* const*)&directory;
+    l.root_count = root_count ? root_count : 1;
+    l.flags      = flags;
+    if (!graph || (!root_count && !directory))
+    {
+        free(graph);
+        free(directory);
+        return NULL;
+    }
+
+#ifdef MINISSD_THREADS
+    pthread_mutex_init(&l.lock, NULL);
+    pthread_cond_init(&l.wake, NULL);
+#endif
+    bool loaded = add_module(&l,
+                             file_key(path),
+                             copy_string(path, strlen(path)),
+                             copy_string("", 0)) == 0;
+#ifdef MINISSD_THREADS
+    if (threads == 0)
+    {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads     = online > 0 ? (unsigned)online : 1;
+    }
+    pthread_t* workers = (pthread_t*)calloc(threads, sizeof(pthread_t));
+    bool*      started = (bool*)calloc(threads, sizeof(bool));
+    unsigned   t;
+    for (t = 1; loaded && workers && started && t < threads; t++)
+    {
+        started[t] =
+            pthread_create(&workers[t], NULL, module_worker, &l) == 0;
+    }
+#else
+    (void)threads;
+#endif
+    if (loaded)
+    {
+        module_worker(&l);
+    }
+#ifdef MINISSD_THREADS
+    for (t = 1; workers && started && t < threads; t++)
+    {
+        if (started[t])
+        {
+            pthread_join(workers[t], NULL);
+        }
+    }
+    free(workers);
+    free(started);
+    pthread_mutex_destroy(&l.lock);
+    pthread_cond_destroy(&l.wake);
+#endif
+
+    loaded = loaded && !l.failed && number_modules(graph, &l);
+    size_t i;
+    for (i = 0; i < l.files.count; i++)
+    {
+        if (l.modules[i])
+        {
+            free_module(l.modules[i]);
+            free(l.modules[i]);
+        }
+    }
+    free(l.modules);
+    clear_intern_table(&l.files);
+    free(directory);
+    if (!loaded)
+    {
+        minissd_free_module_graph(graph);
+        return NULL;
+    }
+
+    if (check_modules(graph))
+    {
+        if (!order_modules(graph))
+        {
+            graph->status = MINISSD_MODULES_CYCLE;
+        }
+        else if (!merge_modules(graph))
+        {
+            minissd_free_module_graph(graph);
+            return NULL;
+        }
+    }
+    return graph;
+}
+
+void
+minissd_free_module_graph(ModuleGraph* graph)
+{
+    if (!graph)
+    {
+        return;
+    }
+    size_t i;
+    for (i = 0; i < graph->module_count; i++)
+    {
+        free_module(&graph->modules[i]);
+    }
+    free(graph->modules);
+    free(graph->order);
+    free(graph->nodes);
+    free(graph);
+}
+
+FlatAst*
+minissd_load_ast_file(const char* path, unsigned flags)
+{
+    void*  data    = NULL;
+    size_t length  = 0;
+    void*  mapping = NULL;
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+        (uintmax_t)st.st_size <= SIZE_MAX)
+    {
+        length  = (size_t)st.st_size;
+        mapping = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        mapping = mapping == MAP_FAILED ? NULL : mapping;
+    }
+    FILE* f = mapping ? NULL : fdopen(fd, "rb");
+    if (mapping || !f)
+    {
+        close(fd);
+    }
+#else
+    FILE* f = fopen(path, "rb");
+#endif
+    // Unmappable files are read into a buffer, which malloc aligns
+    if (f)
+    {
+        data = read_stream(f, &length);
+        fclose(f);
+    }
+    FlatAst* flat = minissd_load_ast(mapping ? mapping : data, length, flags);
+    if (!flat)
+    {
+#ifndef _WIN32
+        if (mapping)
+        {
+            munmap(mapping, length);
+        }
+#endif
+        free(data);
+        return NULL;
+    }
+    flat->storage        = data;
+    flat->mapping        = mapping;
+    flat->mapping_length = length;
+    return flat;
+}
+#endif
+
+// Flat AST
+// Flattening runs twice over the AST, first counting into a FlatAst without
+// arrays and collecting the distinct strings, then filling the arrays of one
+// allocation sized by the first run.
+// Each run reserves all children of an element before visiting them, which
+// keeps siblings adjacent even though their own children are appended in
+// between.
+typedef struct
+{
+    FlatAst*    flat;
+    bool        fill;     // Arrays are allocated, else only count
+    InternTable strings;  // Distinct strings, each stored once in the pool
+    uint32_t*   offsets;  // Pool offset of each string id while filling
+} FlatBuilder;
+
+#define FLAT_SLOT(b, array, i, scratch)                                        \
+    ((b)->fill ? &(b)->flat->array[i] : &(scratch))
+
+static FlatString
+flat_string(FlatBuilder* b, char const* s, size_t length)
+{
+    FlatString result = { MINISSD_FLAT_NONE, 0 };
+    if (!s)
+    {
+        return result;
+    }
+    char const* canonical =
+        intern_in(&b->strings, s, length, hash_bytes(s, length));
+    if (b->fill)
+    {
+        result.offset = b->offsets[intern_header(canonical)->id];
+    }
+    result.length = (uint32_t)length;
+    return result;
+}
+
+static FlatType
+flat_type(FlatBuilder* b, Type const* type)
+{
+    FlatType result;
+    memset(&result, 0, sizeof(result));
+    result.name      = flat_string(b, type->name, type->name_length);
+    result.is_list   = type->is_list;
+    result.has_count = type->has_count;
+    result.count     = type->count;
+    return result;
+}
+
+static FlatRange
+flat_parameters(FlatBuilder* b, AttributeParameter const* head)
+{
+    FlatRange                 range = { b->flat->parameter_count, 0 };
+    AttributeParameter const* param;
+    for (param = head; param; param = param->next)
+    {
+        range.count++;
+    }
+    b->flat->parameter_count += range.count;
+
+    uint32_t i = range.first;
+    for (param = head; param; param = param->next, i++)
+    {
+        FlatAttributeParameter  scratch;
+        FlatAttributeParameter* out = FLAT_SLOT(b, parameters, i, scratch);
+        out->key   = flat_string(b, param->key, param->key_length);
+        out->value = flat_string(b, param->opt_value, param->value_length);
+    }
+    return range;
+}
+
+static FlatRange
+flat_attributes(FlatBuilder* b, Attribute const* head)
+{
+    FlatRange        range = { b->flat->attribute_count, 0 };
+    Attribute const* attr;
+    for (attr = head; attr; attr = attr->next)
+    {
+        range.count++;
+    }
+    b->flat->attribute_count += range.count;
+
+    uint32_t i = range.first;
+    for (attr = head; attr; attr = attr->next, i++)
+    {
+        FlatAttribute  scratch;
+        FlatAttribute* out = FLAT_SLOT(b, attributes, i, scratch);
+        out->name          = flat_string(b, attr->name, attr->name_length);
+        out->parameters    = flat_parameters(b, attr->opt_ll_arguments);
+    }
+    return range;
+}
+
+static FlatRange
+flat_arguments(FlatBuilder* b, Argument const* head)
+{
+    FlatRange       range = { b->flat->argument_count, 0 };
+    Argument const* arg;
+    for (arg = head; arg; arg = arg->next)
+    {
+        range.count++;
+    }
+    b->flat->argument_count += range.count;
+
+    uint32_t i = range.first;
+    for (arg = head; arg; arg = arg->next, i++)
+    {
+        FlatArgument  scratch;
+        FlatArgument* out = FLAT_SLOT(b, arguments, i, scratch);
+        out->attributes   = flat_attributes(b, arg->attributes);
+        out->name         = flat_string(b, arg->name, arg->name_length);
+        out->type         = flat_type(b, &arg->type);
+    }
+    return range;
+}
+
+static FlatRange
+flat_properties(FlatBuilder* b, Property const* head)
+{
+    FlatRange       range = { b->flat->property_count, 0 };
+    Property const* prop;
+    for (prop = head; prop; prop = prop->next)
+    {
+        range.count++;
+    }
+    b->flat->property_count += range.count;
+
+    uint32_t i = range.first;
+    for (prop = head; prop; prop = prop->next, i++)
+    {
+        FlatProperty  scratch;
+        FlatProperty* out = FLAT_SLOT(b, properties, i, scratch);
+        out->attributes   = flat_attributes(b, prop->attributes);
+        out->name         = flat_string(b, prop->name, prop->name_length);
+        out->type         = flat_type(b, &prop->type);
+    }
+    return range;
+}
+
+static FlatRange
+flat_variants(FlatBuilder* b, EnumVariant const* head)
+{
+    FlatRange          range = { b->flat->variant_count, 0 };
+    EnumVariant const* variant;
+    for (variant = head; variant; variant = variant->next)
+    {
+        range.count++;
+    }
+    b->flat->variant_count += range.count;
+
+    uint32_t i = range.first;
+    for (variant = head; variant; variant = variant->next, i++)
+    {
+        FlatEnumVariant  scratch;
+        FlatEnumVariant* out = FLAT_SLOT(b, variants, i, scratch);
+        out->attributes      = flat_attributes(b, variant->attributes);
+        out->name      = flat_string(b, variant->name, variant->name_length);
+        out->has_value = variant->has_value;
+        out->value     = variant->value;
+    }
+    return range;
+}
+
+static FlatRange
+flat_handlers(FlatBuilder* b, Handler const* head)
+{
+    FlatRange      range = { b->flat->handler_count, 0 };
+    Handler const* handler;
+    for (handler = head; handler; handler = handler->next)
+    {
+        range.count++;
+    }
+    b->flat->handler_count += range.count;
+
+    uint32_t i = range.first;
+    for (handler = head; handler; handler = handler->next, i++)
+    {
+        FlatHandler  scratch;
+        FlatHandler* out = FLAT_SLOT(b, handlers, i, scratch);
+        out->attributes  = flat_attributes(b, handler->opt_ll_attributes);
+        out->name = flat_string(b, handler->name, handler->name_length);
+        out->arguments       = flat_arguments(b, handler->opt_ll_arguments);
+        out->has_return_type = handler->has_return_type;
+        if (handler->has_return_type)
+        {
+            out->return_type = flat_type(b, &handler->return_type);
+        }
+        else
+        {
+            memset(&out->return_type, 0, sizeof(out->return_type));
+            out->return_type.name.offset = MINISSD_FLAT_NONE;
+        }
+    }
+    return range;
+}
+
+static FlatRange
+flat_events(FlatBuilder* b, Event const* head)
+{
+    FlatRange    range = { b->flat->event_count, 0 };
+    Event const* event;
+    for (event = head; event; event = event->next)
+    {
+        range.count++;
+    }
+    b->flat->event_count += range.count;
+
+    uint32_t i = range.first;
+    for (event = head; event; event = event->next, i++)
+    {
+        FlatEvent  scratch;
+        FlatEvent* out  = FLAT_SLOT(b, events, i, scratch);
+        out->attributes = flat_attributes(b, event->opt_ll_attributes);
+        out->name       = flat_string(b, event->name, event->name_length);
+        out->arguments  = flat_arguments(b, event->opt_ll_arguments);
+    }
+    return range;
+}
+
+static FlatRange
+flat_dependencies(FlatBuilder* b, Dependency const* head)
+{
+    FlatRange         range = { b->flat->dependency_count, 0 };
+    Dependency const* dep;
+    for (dep = head; dep; dep = dep->next)
+    {
+        range.count++;
+    }
+    b->flat->dependency_count += range.count;
+
+    uint32_t i = range.first;
+    for (dep = head; dep; dep = dep->next, i++)
+    {
+        FlatDependency  scratch;
+        FlatDependency* out = FLAT_SLOT(b, dependencies, i, scratch);
+        out->attributes     = flat_attributes(b, dep->opt_ll_attributes);
+        out->path           = flat_string(b, dep->path, dep->path_length);
+    }
+    return range;
+}
+
+static void
+flat_nodes(FlatBuilder* b, AstNode const* head)
+{
+    static FlatRange const none = { 0, 0 };
+    AstNode const*         node;
+    for (node = head; node; node = node->next)
+    {
+        b->flat->node_count++;
+    }
+
+    uint32_t i = 0;
+    for (node = head; node; node = node->next, i++)
+    {
+        FlatNode  scratch;
+        FlatNode* out     = FLAT_SLOT(b, nodes, i, scratch);
+        out->type         = (uint32_t)node->type;
+        out->attributes   = flat_attributes(b, node->opt_ll_attributes);
+        out->members      = none;
+        out->dependencies = none;
+        out->events       = none;
+        switch (node->type)
+        {
+        case NODE_IMPORT:
+            out->name = flat_string(b,
+                                    node->node.import_node.path,
+                                    node->node.import_node.path_length);
+            break;
+        case NODE_DATA:
+            out->name    = flat_string(b,
+                                       node->node.data_node.name,
+                                       node->node.data_node.name_length);
+            out->members =
+                flat_properties(b, node->node.data_node.ll_properties);
+            break;
+        case NODE_ENUM:
+            out->name    = flat_string(b,
+                                       node->node.enum_node.name,
+                                       node->node.enum_node.name_length);
+            out->members = flat_variants(b, node->node.enum_node.ll_variants);
+            break;
+        case NODE_SERVICE:
+            out->name = flat_string(b,
+                                    node->node.service_node.name,
+                                    node->node.service_node.name_length);
+            out->dependencies = flat_dependencies(
+                b, node->node.service_node.opt_ll_dependencies);
+            out->members =
+                flat_handlers(b, node->node.service_node.opt_ll_handlers);
+            out->events =
+                flat_events(b, node->node.service_node.opt_ll_events);
+            break;
+        }
+    }
+}
+
+// Rounds array sizes up so every array in the storage stays aligned
+static size_t
+flat_array_size(uint32_t count, size_t element_size)
+{
+    size_t size = (size_t)count * element_size;
+    return (size + 7) & ~(size_t)7;
+}
+
+// Bytes of storage the counted arrays and strings of flat need, false if
+// that exceeds the address space
+static bool
+flat_storage_size(FlatAst const* flat, size_t* size)
+{
+    uint32_t const counts[9] = {
+        flat->node_count,      flat->property_count,   flat->variant_count,
+        flat->handler_count,   flat->event_count,      flat->dependency_count,
+        flat->argument_count,  flat->attribute_count,  flat->parameter_count,
+    };
+    size_t const element_sizes[9] = {
+        sizeof(FlatNode),       sizeof(FlatProperty),
+        sizeof(FlatEnumVariant), sizeof(FlatHandler),
+        sizeof(FlatEvent),      sizeof(FlatDependency),
+        sizeof(FlatArgument),   sizeof(FlatAttribute),
+        sizeof(FlatAttributeParameter),
+    };
+    uint64_t total = flat->string_size;
+    int      i;
+    for (i = 0; i < 9; i++)
+    {
+        total += ((uint64_t)counts[i] * element_sizes[i] + 7) & ~(uint64_t)7;
+    }
+    if (total != (size_t)total)
+    {
+        return false;
+    }
+    *size = (size_t)total;
+    return true;
+}
+
+// Points the arrays of flat at their place in storage
+static void
+flat_bind(FlatAst* flat, char* storage)
+{
+    flat->nodes = (FlatNode*)storage;
+    storage += flat_array_size(flat->node_count, sizeof(FlatNode));
+    flat->properties = (FlatProperty*)storage;
+    storage += flat_array_size(flat->property_count, sizeof(FlatProperty));
+    flat->variants = (FlatEnumVariant*)storage;
+    storage += flat_array_size(flat->variant_count, sizeof(FlatEnumVariant));
+    flat->handlers = (FlatHandler*)storage;
+    storage += flat_array_size(flat->handler_count, sizeof(FlatHandler));
+    flat->events = (FlatEvent*)storage;
+    storage += flat_array_size(flat->event_count, sizeof(FlatEvent));
+    flat->dependencies = (FlatDependency*)storage;
+    storage +=
+        flat_array_size(flat->dependency_count, sizeof(FlatDependency));
+    flat->arguments = (FlatArgument*)storage;
+    storage += flat_array_size(flat->argument_count, sizeof(FlatArgument));
+    flat->attributes = (FlatAttribute*)storage;
+    storage += flat_array_size(flat->attribute_count, sizeof(FlatAttribute));
+    flat->parameters = (FlatAttributeParameter*)storage;
+    storage += flat_array_size(flat->parameter_count,
+                               sizeof(FlatAttributeParameter));
+    flat->strings = storage;
+}
+
+FlatAst*
+minissd_flatten_ast(AstNode const* ast)
+{
+    FlatAst     counts;
+    FlatBuilder b;
+    FlatAst*    flat    = NULL;
+    char*       storage = NULL;
+    size_t      size;
+    size_t      i;
+    memset(&counts, 0, sizeof(counts));
+    memset(&b, 0, sizeof(b));
+    b.flat = &counts;
+    flat_nodes(&b, ast);
+
+    // Lay out the pool in order of first appearance
+    uint64_t string_size = 0;
+    b.offsets = (uint32_t*)malloc((b.strings.count + 1) * sizeof(uint32_t));
+    for (i = 0; b.offsets && i < b.strings.count; i++)
+    {
+        b.offsets[i] = (uint32_t)string_size;
+        string_size += intern_header(b.strings.strings[i])->length + 1;
+    }
+    counts.string_size = (uint32_t)string_size;
+    if (b.offsets && string_size <= UINT32_MAX &&
+        flat_storage_size(&counts, &size))
+    {
+        // Zeroed, so the padding inside the arrays serializes the same way
+        flat    = (FlatAst*)calloc(1, sizeof(FlatAst));
+        storage = (char*)calloc(1, size ? size : 1);
+    }
+    if (!flat || !storage)
+    {
+        free(flat);
+        free(storage);
+        free(b.offsets);
+        clear_intern_table(&b.strings);
+        return NULL;
+    }
+
+    *flat         = counts;
+    flat->storage = storage;
+    flat_bind(flat, storage);
+    for (i = 0; i < b.strings.count; i++)
+    {
+        memcpy(flat->strings + b.offsets[i],
+               b.strings.strings[i],
+               intern_header(b.strings.strings[i])->length + 1);
+    }
+    flat->node_count       = 0;
+    flat->property_count   = 0;
+    flat->variant_count    = 0;
+    flat->handler_count    = 0;
+    flat->event_count      = 0;
+    flat->dependency_count = 0;
+    flat->argument_count   = 0;
+    flat->attribute_count  = 0;
+    flat->parameter_count  = 0;
+
+    b.flat = flat;
+    b.fill = true;
+    flat_nodes(&b, ast);
+    free(b.offsets);
+    clear_intern_table(&b.strings);
+    return flat;
+}
+
+void
+minissd_free_flat_ast(FlatAst* flat)
+{
+    if (!flat)
+    {
+        return;
+    }
+#if !defined(WASM) && !defined(_WIN32)
+    if (flat->mapping)
+    {
+        munmap(flat->mapping, flat->mapping_length);
+    }
+#endif
+    free(flat->storage);
+    free(flat);
+}
+
+char const*
+minissd_flat_string(FlatAst const* flat, FlatString s)
+{
+    assert(flat);
+    return s.offset == MINISSD_FLAT_NONE ? NULL : flat->strings + s.offset;
+}
+
+FlatProperty const*
+minissd_flat_get_properties(FlatAst const*  flat,
+                            FlatNode const* node,
+                            uint32_t*       count)
+{
+    assert(flat && node && count);
+    *count = node->type == NODE_DATA ? node->members.count : 0;
+    return flat->properties + (*count ? node->members.first : 0);
+}
+
+FlatEnumVariant const*
+minissd_flat_get_variants(FlatAst const*  flat,
+                          FlatNode const* node,
+                          uint32_t*       count)
+{
+    assert(flat && node && count);
+    *count = node->type == NODE_ENUM ? node->members.count : 0;
+    return flat->variants + (*count ? node->members.first : 0);
+}
+
+FlatHandler const*
+minissd_flat_get_handlers(FlatAst const*  flat,
+                          FlatNode const* node,
+                          uint32_t*       count)
+{
+    assert(flat && node && count);
+    *count = node->type == NODE_SERVICE ? node->members.count : 0;
+    return flat->handlers + (*count ? node->members.first : 0);
+}
+
+FlatDependency const*
+minissd_flat_get_dependencies(FlatAst const*  flat,
+                              FlatNode const* node,
+                              uint32_t*       count)
+{
+    assert(flat && node && count);
+    *count = node->dependencies.count;
+    return flat->dependencies + node->dependencies.first;
+}
+
+FlatEvent const*
+minissd_flat_get_events(FlatAst const*  flat,
+                        FlatNode const* node,
+                        uint32_t*       count)
+{
+    assert(flat && node && count);
+    *count = node->events.count;
+    return flat->events + node->events.first;
+}
+
+FlatArgument const*
+minissd_flat_get_arguments(FlatAst const* flat,
+                           FlatRange      arguments,
+                           uint32_t*      count)
+{
+    assert(flat && count);
+    *count = arguments.count;
+    return flat->arguments + arguments.first;
+}
+
+FlatAttribute const*
+minissd_flat_get_attributes(FlatAst const* flat,
+                            FlatRange      attributes,
+                            uint32_t*      count)
+{
+    assert(flat && count);
+    *count = attributes.count;
+    return flat->attributes + attributes.first;
+}
+
+FlatAttributeParameter const*
+minissd_flat_get_parameters(FlatAst const*       flat,
+                            FlatAttribute const* attr,
+                            uint32_t*            count)
+{
+    assert(flat && attr && count);
+    *count = attr->parameters.count;
+    return flat->parameters + attr->parameters.first;
+}
+
+// Serialized AST
+// Header: magic, version, byte order, header length, header checksum,
+// payload checksum, then the counts of the FlatAst as LEB128 varints, zero
+// padded to 8 bytes. The payload is the FlatAst storage, so loading only
+// points the arrays into it.
+#define AST_MAGIC "MSSD"
+#define AST_HEADER_FIXED 16
+#define AST_HEADER_MAX 72  // Fixed part and ten 5-byte varints, padded
+#define AST_LITTLE_ENDIAN 1
+#define AST_BIG_ENDIAN 2
+
+static uint8_t
+ast_byte_order(void)
+{
+    uint16_t probe = 1;
+    return *(uint8_t const*)&probe ? AST_LITTLE_ENDIAN : AST_BIG_ENDIAN;
+}
+
+static uint32_t
+ast_checksum(unsigned char const* data, size_t length)
+{
+    uint32_t hash = FNV_OFFSET_BASIS;
+    size_t   i;
+    for (i = 0; i < length; i++)
+    {
+        hash = (hash ^ data[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+static size_t
+write_varint(unsigned char* out, uint32_t value)
+{
+    size_t n = 0;
+    while (value >= 0x80)
+    {
+        out[n++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (unsigned char)value;
+    return n;
+}
+
+// Advances *at past the varint, false if it is cut off by end or too large
+static bool
+read_varint(unsigned char const** at, unsigned char const* end, uint32_t* value)
+{
+    uint64_t result = 0;
+    int      shift;
+    for (shift = 0; shift < 35 && *at < end; shift += 7)
+    {
+        unsigned char byte = *(*at)++;
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+        {
+            *value = (uint32_t)result;
+            return result <= UINT32_MAX;
+        }
+    }
+    return false;
+}
+
+// Counts of flat in header order
+static uint32_t*
+ast_header_count(FlatAst* flat, int i)
+{
+    uint32_t* const counts[10] = {
+        &flat->node_count,       &flat->property_count,
+        &flat->variant_count,    &flat->handler_count,
+        &flat->event_count,      &flat->dependency_count,
+        &flat->argument_count,   &flat->attribute_count,
+        &flat->parameter_count,  &flat->string_size,
+    };
+    return counts[i];
+}
+
+void*
+minissd_serialize_flat_ast(FlatAst const* flat, size_t* length)
+{
+    assert(flat && length);
+    FlatAst       counts = *flat;
+    unsigned char header[AST_HEADER_MAX];
+    size_t        size;
+    size_t        header_length = AST_HEADER_FIXED;
+    int           i;
+    if (!flat_storage_size(flat, &size))
+    {
+        return NULL;
+    }
+    memset(header, 0, sizeof(header));
+    memcpy(header, AST_MAGIC, 4);
+    header[4] = MINISSD_AST_FORMAT_VERSION;
+    header[5] = ast_byte_order();
+    for (i = 0; i < 10; i++)
+    {
+        header_length +=
+            write_varint(header + header_length, *ast_header_count(&counts, i));
+    }
+    header_length = (header_length + 7) & ~(size_t)7;
+
+    unsigned char* data = (unsigned char*)malloc(header_length + size);
+    if (!data)
+    {
+        return NULL;
+    }
+    // The arrays of a FlatAst are laid out back to back from nodes on
+    uint16_t header_length16 = (uint16_t)header_length;
+    uint32_t payload_checksum =
+        ast_checksum((unsigned char const*)flat->nodes, size);
+    memcpy(header + 6, &header_length16, sizeof(header_length16));
+    memcpy(header + 12, &payload_checksum, sizeof(payload_checksum));
+    uint32_t header_checksum = ast_checksum(header, header_length);
+    memcpy(header + 8, &header_checksum, sizeof(header_checksum));
+
+    memcpy(data, header, header_length);
+    memcpy(data + header_length, flat->nodes, size);
+    *length = header_length + size;
+    return data;
+}
+
+void*
+minissd_serialize_ast(AstNode const* ast, size_t* length)
+{
+    FlatAst* flat = minissd_flatten_ast(ast);
+    if (!flat)
+    {
+        return NULL;
+    }
+    void* data = minissd_serialize_flat_ast(flat, length);
+    minissd_free_flat_ast(flat);
+    return data;
+}
+
+void
+minissd_free_serialized_ast(void* data)
+{
+    free(data);
+}
+
+static bool
+flat_range_valid(FlatRange range, uint32_t count)
+{
+    return range.first <= count && range.count <= count - range.first;
+}
+
+static bool
+flat_string_valid(FlatAst const* flat, FlatString s)
+{
+    return s.offset == MINISSD_FLAT_NONE ||
+           (s.offset < flat->string_size &&
+            s.length < flat->string_size - s.offset &&
+            flat->strings[s.offset + s.length] == '\0');
+}
+
+static bool
+flat_type_valid(FlatAst const* flat, FlatType const* type)
+{
+    return flat_string_valid(flat, type->name);
+}
+
+// Bounds checks every range and string, so accessors stay inside the data
+static bool
+flat_verify(FlatAst const* flat)
+{
+    uint32_t i;
+    for (i = 0; i < flat->node_count; i++)
+    {
+        FlatNode const* node    = &flat->nodes[i];
+        uint32_t        members = 0;
+        switch (node->type)
+        {
+        case NODE_IMPORT:
+            break;
+        case NODE_DATA:
+            members = flat->property_count;
+            break;
+        case NODE_ENUM:
+            members = flat->variant_count;
+            break;
+        case NODE_SERVICE:
+            members = flat->handler_count;
+            break;
+        default:
+            return false;
+        }
+        if (!flat_range_valid(node->attributes, flat->attribute_count) ||
+            !flat_string_valid(flat, node->name) ||
+            !flat_range_valid(node->members, members) ||
+            !flat_range_valid(node->dependencies, flat->dependency_count) ||
+            !flat_range_valid(node->events, flat->event_count))
+        {
+            return false;
+        }
+    }
+    for (i = 0; i < flat->property_count; i++)
+    {
+        FlatProperty const* prop = &flat->properties[i];
+        if (!flat_range_valid(prop->attributes, flat->attribute_count) ||
+            !flat_string_valid(flat, prop->name) ||
+            !flat_type_valid(flat, &prop->type))
+        {
+            return false;
+        }
+    }
+    for (i = 0; i < flat->variant_count; i++)
+    {
+        FlatEnumVariant const* variant = &flat->variants[i];
+        if (!flat_range_valid(variant->attributes, flat->attribute_count) ||
+            !flat_string_valid(flat, variant->name))
+        {
+            return false;
+        }
+    }
+    for (i = 0; i < flat->handler_count; i++)
+    {
+        FlatHandler const* handler = &flat->handlers[i];
+        if (!flat_range_valid(handler->attributes, flat->attribute_count) ||
+            !flat_string_valid(flat, handler->name) ||
+            !flat_range_valid(handler->arguments, flat->argument_count) ||
+            !flat_type_valid(flat, &handler->return_type))
+        {
+            return false;
+        }
+    }
+    for (i = 0; i < flat->event_count; i++)
+    {
+        FlatEvent const* event = &flat->events[i];
+        if (!flat_range_valid(event->attributes, flat->attribute_count) ||
+            !flat_string_valid(flat, event->name) ||
+            !flat_range_valid(event->arguments, flat->argument_count))
+        {
+            return false;
+        }
+    }
+    for (i = 0; i < flat->dependency_count; i++)
+    {
+        FlatDependency const* dep = &flat->dependencies[i];
+        if (!flat_range_valid(dep->attributes, flat->attribute_count) ||
+            !flat_string_valid(flat, dep->path))
+        {
+            return false;
+        }
+    }
+    for (i = 0; i < flat->argument_count; i++)
+    {
+        FlatArgument const* arg = &flat->arguments[i];
+        if (!flat_range_valid(arg->attributes, flat->attribute_count) ||
+            !flat_string_valid(flat, arg->name) ||
+            !flat_type_valid(flat, &arg->type))
+        {
+            return false;
+        }
+    }
+    for (i = 0; i < flat->attribute_count; i++)
+    {
+        FlatAttribute const* attr = &flat->attributes[i];
+        if (!flat_string_valid(flat, attr->name) ||
+            !flat_range_valid(attr->parameters, flat->parameter_count))
+        {
+            return false;
+        }
+    }
+    for (i = 0; i < flat->parameter_count; i++)
+    {
+        FlatAttributeParameter const* param = &flat->parameters[i];
+        if (!flat_string_valid(flat, param->key) ||
+            !flat_string_valid(flat, param->value))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+FlatAst*
+minissd_load_ast(void const* data, size_t length, unsigned flags)
+{
+    unsigned char const* bytes = (unsigned char const*)data;
+    unsigned char        header[AST_HEADER_MAX];
+    uint16_t             header_length;
+    uint32_t             header_checksum;
+    uint32_t             payload_checksum;
+    FlatAst              counts;
+    size_t               size;
+    int                  i;
+    if (!data || length < AST_HEADER_FIXED || ((uintptr_t)data & 7) ||
+        memcmp(bytes, AST_MAGIC, 4) != 0 ||
+        bytes[4] != MINISSD_AST_FORMAT_VERSION ||
+        bytes[5] != ast_byte_order())
+    {
+        return NULL;
+    }
+    memcpy(&header_length, bytes + 6, sizeof(header_length));
+    if (header_length < AST_HEADER_FIXED || header_length > AST_HEADER_MAX ||
+        header_length > length)
+    {
+        return NULL;
+    }
+    memcpy(header, bytes, header_length);
+    memcpy(&header_checksum, header + 8, sizeof(header_checksum));
+    memcpy(&payload_checksum, header + 12, sizeof(payload_checksum));
+    memset(header + 8, 0, sizeof(header_checksum));
+    if (ast_checksum(header, header_length) != header_checksum)
+    {
+        return NULL;
+    }
+
+    memset(&counts, 0, sizeof(counts));
+    unsigned char const* at = header + AST_HEADER_FIXED;
+    for (i = 0; i < 10; i++)
+    {
+        if (!read_varint(&at,
+                         header + header_length,
+                         ast_header_count(&counts, i)))
+        {
+            return NULL;
+        }
+    }
+    if (!flat_storage_size(&counts, &size) || size != length - header_length)
+    {
+        return NULL;
+    }
+    if ((flags & MINISSD_LOAD_VERIFY) &&
+        ast_checksum(bytes + header_length, size) != payload_checksum)
+    {
+        return NULL;
+    }
+
+    FlatAst* flat = (FlatAst*)malloc(sizeof(FlatAst));
+    if (!flat)
+    {
+        return NULL;
+    }
+    *flat = counts;
+    flat_bind(flat, (char*)bytes + header_length);
+    if ((flags & MINISSD_LOAD_VERIFY) && !flat_verify(flat))
+    {
+        free(flat);
+        return NULL;
+    }
+    return flat;
+}
+
+// Parse cache
+#if !defined(WASM) && !defined(_WIN32)
+#define CACHE_SUFFIX ".ssdb"
+#define CACHE_KEY_DIGITS 32
+
+struct ParseCache
+{
+    char*           directory;
+    size_t          max_bytes;
+    unsigned        load_flags;
+    unsigned        temp_count;  // Keeps temporary names unique per process
+    ParseCacheStats stats;
+};
+
+typedef struct
+{
+    char*  name;
+    time_t mtime;
+    size_t size;
+} CacheEntry;
+
+static uint64_t
+rotate_left(uint64_t x, int bits)
+{
+    return (x << bits) | (x >> (64 - bits));
+}
+
+static uint64_t
+mix_final(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    return x ^ (x >> 33);
+}
+
+// 128-bit content hash in hex, two multiply-rotate lanes over 8-byte words
+static void
+cache_key(char const* input, size_t length, char key[CACHE_KEY_DIGITS + 1])
+{
+    uint64_t a = 0x9e3779b97f4a7c15ull ^ length;
+    uint64_t b = 0xc2b2ae3d27d4eb4full + length;
+    size_t   i;
+    for (i = 0; i < length; i += 8)
+    {
+        uint64_t word = 0;
+        memcpy(&word, input + i, length - i < 8 ? length - i : 8);
+        a = rotate_left(a ^ (word * 0x87c37b91114253d5ull), 31) *
+            0x4cf5ad432745937full;
+        b = rotate_left(b ^ (word * 0x52dce729da3ed6ebull), 29) *
+            0x9fb21c651e98df25ull;
+    }
+    a = mix_final(a + b);
+    b = mix_final(b + a);
+    snprintf(key,
+             CACHE_KEY_DIGITS + 1,
+             "%016llx%016llx",
+             (unsigned long long)a,
+             (unsigned long long)b);
+}
+
+static char*
+cache_path(ParseCache const* cache, char const* name)
+{
+    size_t length = strlen(cache->directory) + strlen(name) + 2;
+    char*  path   = (char*)malloc(length);
+    if (path)
+    {
+        snprintf(path, length, "%s/%s", cache->directory, name);
+    }
+    return path;
+}
+
+static int
+compare_cache_entries(void const* a, void const* b)
+{
+    CacheEntry const* x = (CacheEntry const*)a;
+    CacheEntry const* y = (CacheEntry const*)b;
+    if (x->mtime != y->mtime)
+    {
+        return x->mtime < y->mtime ? -1 : 1;
+    }
+    return strcmp(x->name, y->name);
+}
+
+// Measures the entries and removes the least recently used ones, by
+// modification time, until the rest fits into max_bytes
+static void
+cache_scan(ParseCache* cache)
+{
+    DIR* dir = opendir(cache->directory);
+    if (!dir)
+    {
+        return;
+    }
+    CacheEntry*    entries  = NULL;
+    size_t         count    = 0;
+    size_t         capacity = 0;
+    size_t         total    = 0;
+    size_t         suffix   = strlen(CACHE_SUFFIX);
+    size_t         i;
+    struct dirent* d;
+    while ((d = readdir(dir)) != NULL)
+    {
+        struct stat st;
+        size_t      length = strlen(d->d_name);
+        if (length != CACHE_KEY_DIGITS + suffix ||
+            strcmp(d->d_name + CACHE_KEY_DIGITS, CACHE_SUFFIX) != 0)
+        {
+            continue;
+        }
+        char* path = cache_path(cache, d->d_name);
+        if (!path || stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+        {
+            free(path);
+            continue;
+        }
+        free(path);
+        if (count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            CacheEntry* grown =
+                (CacheEntry*)realloc(entries, capacity * sizeof(CacheEntry));
+            if (!grown)
+            {
+                break;
+            }
+            entries = grown;
+        }
+        entries[count].name  = strdup(d->d_name);
+        entries[count].mtime = st.st_mtime;
+        entries[count].size  = (size_t)st.st_size;
+        if (entries[count].name)
+        {
+            total += entries[count++].size;
+        }
+    }
+    closedir(dir);
+
+    if (total > cache->max_bytes)
+    {
+        qsort(entries, count, sizeof(CacheEntry), compare_cache_entries);
+        for (i = 0; i < count && total > cache->max_bytes; i++)
+        {
+            char* path = cache_path(cache, entries[i].name);
+            if (path && unlink(path) == 0)
+            {
+                total -= entries[i].size;
+                cache->stats.evictions++;
+            }
+            free(path);
+        }
+    }
+    cache->stats.bytes = total;
+
+    for (i = 0; i < count; i++)
+    {
+        free(entries[i].name);
+    }
+    free(entries);
+}
+
+static bool
+write_all(int fd, char const* data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(fd, data, length);
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written <= 0)
+        {
+            return false;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+    return true;
+}
+
+// Writes a temporary file next to the entry and renames it into place, so
+// readers find either no entry or a complete one
+static void
+cache_store(ParseCache* cache, char const* path, FlatAst const* flat)
+{
+    size_t length = 0;
+    void*  data   = minissd_serialize_flat_ast(flat, &length);
+    size_t size   = strlen(path) + 48;
+    char*  temp   = (char*)malloc(size);
+    if (!data || !temp)
+    {
+        free(data);
+        free(temp);
+        return;
+    }
+    snprintf(temp,
+             size,
+             "%s.%ld.%u.tmp",
+             path,
+             (long)getpid(),
+             cache->temp_count++);
+
+    int  fd     = open(temp, O_WRONLY | O_CREAT | O_EXCL, 0666);
+    bool stored = fd >= 0 && write_all(fd, (char const*)data, length);
+    if (fd >= 0)
+    {
+        stored = close(fd) == 0 && stored && rename(temp, path) == 0;
+        if (!stored)
+        {
+            unlink(temp);
+        }
+    }
+    if (stored)
+    {
+        cache->stats.stores++;
+        cache->stats.bytes += length;
+        if (cache->stats.bytes > cache->max_bytes)
+        {
+            cache_scan(cache);
+        }
+    }
+    free(data);
+    free(temp);
+}
+
+ParseCache*
+minissd_open_parse_cache(const char* directory,
+                         size_t      max_bytes,
+                         unsigned    load_flags)
+{
+    struct stat st;
+    assert(directory);
+    if ((mkdir(directory, 0777) != 0 && errno != EEXIST) ||
+        stat(directory, &st) != 0 || !S_ISDIR(st.st_mode))
+    {
+        return NULL;
+    }
+    ParseCache* cache = (ParseCache*)calloc(1, sizeof(ParseCache));
+    if (!cache)
+    {
+        return NULL;
+    }
+    cache->directory = strdup(directory);
+    if (!cache->directory)
+    {
+        free(cache);
+        return NULL;
+    }
+    cache->max_bytes  = max_bytes;
+    cache->load_flags = load_flags;
+    cache_scan(cache);
+    return cache;
+}
+
+void
+minissd_close_parse_cache(ParseCache* cache)
+{
+    if (cache)
+    {
+        free(cache->directory);
+        free(cache);
+    }
+}
+
+FlatAst*
+minissd_cache_parse(ParseCache* cache, Parser* p)
+{
+    assert(cache && p);
+    char key[CACHE_KEY_DIGITS + sizeof(CACHE_SUFFIX)];
+    cache_key(p->input, p->input_length, key);
+    memcpy(key + CACHE_KEY_DIGITS, CACHE_SUFFIX, sizeof(CACHE_SUFFIX));
+    char* path = cache_path(cache, key);
+
+    FlatAst* flat = NULL;
+    if (path)
+    {
+        flat = minissd_load_ast_file(path, cache->load_flags);
+    }
+    if (flat)
+    {
+        // Marks the entry as recently used for eviction
+        utimensat(AT_FDCWD, path, NULL, 0);
+        cache->stats.hits++;
+        free(path);
+        return flat;
+    }
+
+    // Missing or unusable entries are replaced
+    cache->stats.misses++;
+    AstNode* ast = minissd_parse(p);
+    if (ast)
+    {
+        flat = minissd_flatten_ast(ast);
+        minissd_free_ast(ast);
+    }
+    if (flat && path)
+    {
+        cache_store(cache, path, flat);
+    }
+    free(path);
+    return flat;
+}
+
+ParseCacheStats
+minissd_parse_cache_stats(ParseCache const* cache)
+{
+    assert(cache);
+    ParseCacheStats stats   = cache->stats;
+    size_t          lookups = stats.hits + stats.misses;
+    stats.hit_rate          = lookups ? (double)stats.hits / lookups : 0.0;
+    return stats;
+}
+#endif
+
+// Name index
+// Open addressing with linear probing at a load factor of at most one half.
+// Later entries of an equal name sit further along the probe sequence, so
+// the first match is the one inserted first
+typedef struct
+{
+    char const*    name;
+    size_t         length;
+    uint32_t       hash;
+    AstNode const* node;  // NULL for free slots
+} IndexEntry;
+
+struct AstIndex
+{
+    IndexEntry* entries;
+    size_t      mask;  // Slot count - 1, a power of two
+};
+
+static void
+index_insert(AstIndex*      index,
+             char const*    name,
+             size_t         length,
+             uint32_t       hash,
+             AstNode const* node)
+{
+    size_t slot = hash & index->mask;
+    while (index->entries[slot].node)
+    {
+        slot = (slot + 1) & index->mask;
+    }
+    index->entries[slot].name   = name;
+    index->entries[slot].length = length;
+    index->entries[slot].hash   = hash;
+    index->entries[slot].node   = node;
+}
+
+// First node of the name and type, any type if type is negative
+static AstNode const*
+index_find(AstIndex const* index, char const* name, size_t length, int type)
+{
+    uint32_t hash = hash_bytes(name, length);
+    size_t   slot = hash & index->mask;
+    for (; index->entries[slot].node; slot = (slot + 1) & index->mask)
+    {
+        IndexEntry const* entry = &index->entries[slot];
+        if (entry->hash == hash && entry->length == length &&
+            (type < 0 || entry->node->type == (NodeType)type) &&
+            memcmp(entry->name, name, length) == 0)
+        {
+            return entry->node;
+        }
+    }
+    return NULL;
+}
+
+AstIndex*
+minissd_build_index(AstNode const* ast)
+{
+    size_t         count = 0;
+    AstNode const* node;
+    for (node = ast; node; node = node->next)
+    {
+        // Imports may take a second entry for their last segment
+        count += node->type == NODE_IMPORT ? 2 : 1;
+    }
+    size_t slots = 8;
+    while (slots < count * 2)
+    {
+        slots *= 2;
+    }
+    AstIndex* index = (AstIndex*)malloc(sizeof(AstIndex));
+    if (!index)
+    {
+        return NULL;
+    }
+    index->entries = (IndexEntry*)calloc(slots, sizeof(IndexEntry));
+    index->mask    = slots - 1;
+    if (!index->entries)
+    {
+        free(index);
+        return NULL;
+    }
+
+    // Declarations go first so they win over imports of the same name
+    size_t      length;
+    char const* name;
+    for (node = ast; node; node = node->next)
+    {
+        if (node->type != NODE_IMPORT)
+        {
+            name = node_name(node, &length);
+            index_insert(index, name, length, hash_bytes(name, length), node);
+        }
+    }
+    for (node = ast; node; node = node->next)
+    {
+        if (node->type != NODE_IMPORT)
+        {
+            continue;
+        }
+        name = node_name(node, &length);
+        index_insert(index, name, length, hash_bytes(name, length), node);
+        // a::b::Thing also answers to Thing
+        size_t segment = length;
+        while (segment > 0 && name[segment - 1] != ':')
+        {
+            segment--;
+        }
+        if (segment > 0 && segment < length &&
+            !index_find(index, name + segment, length - segment, -1))
+        {
+            index_insert(index,
+                         name + segment,
+                         length - segment,
+                         hash_bytes(name + segment, length - segment),
+                         node);
+        }
+    }
+    return index;
+}
+
+void
+minissd_free_index(AstIndex* index)
+{
+    if (index)
+    {
+        free(index->entries);
+        free(index);
+    }
+}
+
+AstNode const*
+minissd_find_data(AstIndex const* index, char const* name, size_t length)
+{
+    return index_find(index, name, length, NODE_DATA);
+}
+
+AstNode const*
+minissd_find_enum(AstIndex const* index, char const* name, size_t length)
+{
+    return index_find(index, name, length, NODE_ENUM);
+}
+
+AstNode const*
+minissd_find_service(AstIndex const* index, char const* name, size_t length)
+{
+    return index_find(index, name, length, NODE_SERVICE);
+}
+
+AstNode const*
+minissd_find_import(AstIndex const* index, char const* path, size_t length)
+{
+    return index_find(index, path, length, NODE_IMPORT);
+}
+
+AstNode const*
+minissd_find_any(AstIndex const* index, char const* name, size_t length)
+{
+    return index_find(index, name, length, -1);
+}
+
+// Attribute index
+// Elements with attributes are collected once, then copied into one run per
+// attribute name, so a query is a hash lookup and a slice
+struct AttributeIndex
+{
+    InternTable        names;  // Attribute names, whose ids select a run
+    AttributedElement* elements;
+    size_t             element_count;
+    AttributedElement* runs;    // Elements by attribute name, in AST order
+    size_t*            starts;  // Run of id i is runs[starts[i], starts[i+1])
+};
+
+typedef struct
+{
+    AttributeIndex* index;
+    size_t          count;
+    bool            fill;
+} AttributeBuilder;
+
+uint64_t
+minissd_attribute_mask(char const* name, size_t length)
+{
+    uint32_t hash = hash_bytes(name, length);
+    return ((uint64_t)1 << (hash & 63)) | ((uint64_t)1 << ((hash >> 6) & 63));
+}
+
+Attribute const*
+minissd_get_attribute(Attribute const* attributes,
+                      char const*      name,
+                      size_t           length)
+{
+    for (; attributes; attributes = attributes->next)
+    {
+        if (attributes->name_length == length &&
+            memcmp(attributes->name, name, length) == 0)
+        {
+            return attributes;
+        }
+    }
+    return NULL;
+}
+
+// Counts or stores the element if it has attributes
+static void
+collect_attributed(AttributeBuilder*     b,
+                   AttributedElementKind kind,
+                   void const*           element,
+                   AstNode const*        node,
+                   Attribute const*      attributes)
+{
+    if (!attributes)
+    {
+        return;
+    }
+    AttributedElement e;
+    e.kind       = kind;
+    e.element    = element;
+    e.node       = node;
+    e.attributes = attributes;
+    e.mask       = 0;
+    for (; attributes; attributes = attributes->next)
+    {
+        char const* name   = attributes->name;
+        size_t      length = attributes->name_length;
+        e.mask |= minissd_attribute_mask(name, length);
+        if (!b->fill)
+        {
+            intern_in(&b->index->names, name, length, hash_bytes(name, length));
+        }
+    }
+    if (b->fill)
+    {
+        b->index->elements[b->count] = e;
+    }
+    b->count++;
+}
+
+static void
+collect_arguments(AttributeBuilder* b,
+                  Argument const*   argument,
+                  AstNode const*    node)
+{
+    for (; argument; argument = argument->next)
+    {
+        collect_attributed(
+            b, MINISSD_ELEMENT_ARGUMENT, argument, node, argument->attributes);
+    }
+}
+
+// Visits every element in AST order, members after their node
+static void
+collect_elements(AttributeBuilder* b, AstNode const* ast)
+{
+    AstNode const* node;
+    for (node = ast; node; node = node->next)
+    {
+        collect_attributed(
+            b, MINISSD_ELEMENT_NODE, node, node, node->opt_ll_attributes);
+        if (node->type == NODE_DATA)
+        {
+            Property const* property = node->node.data_node.ll_properties;
+            for (; property; property = property->next)
+            {
+                collect_attributed(b,
+                                   MINISSD_ELEMENT_PROPERTY,
+                                   property,
+                                   node,
+                                   property->attributes);
+            }
+        }
+        else if (node->type == NODE_ENUM)
+        {
+            EnumVariant const* variant = node->node.enum_node.ll_variants;
+            for (; variant; variant = variant->next)
+            {
+                collect_attributed(b,
+                                   MINISSD_ELEMENT_VARIANT,
+                                   variant,
+                                   node,
+                                   variant->attributes);
+            }
+        }
+        else if (node->type == NODE_SERVICE)
+        {
+            Service const*    service    = &node->node.service_node;
+            Dependency const* dependency = service->opt_ll_dependencies;
+            for (; dependency; dependency = dependency->next)
+            {
+                collect_attributed(b,
+                                   MINISSD_ELEMENT_DEPENDENCY,
+                                   dependency,
+                                   node,
+                                   dependency->opt_ll_attributes);
+            }
+            Handler const* handler = service->opt_ll_handlers;
+            for (; handler; handler = handler->next)
+            {
+                collect_attributed(b,
+                                   MINISSD_ELEMENT_HANDLER,
+                                   handler,
+                                   node,
+                                   handler->opt_ll_attributes);
+                collect_arguments(b, handler->opt_ll_arguments, node);
+            }
+            Event const* event = service->opt_ll_events;
+            for (; event; event = event->next)
+            {
+                collect_attributed(b,
+                                   MINISSD_ELEMENT_EVENT,
+                                   event,
+                                   node,
+                                   event->opt_ll_attributes);
+                collect_arguments(b, event->opt_ll_arguments, node);
+            }
+        }
+    }
+}
+
+// Calls add for each distinct attribute name of element i, by id
+static void
+attribute_ids(AttributeIndex* index,
+              size_t          i,
+              size_t*         last,
+              void (*add)(AttributeIndex* index, size_t i, size_t id))
+{
+    Attribute const* attribute = index->elements[i].attributes;
+    for (; attribute; attribute = attribute->next)
+    {
+        size_t id = (size_t)intern_find(
+            &index->names,
+            attribute->name,
+            attribute->name_length,
+            hash_bytes(attribute->name, attribute->name_length));
+        // An element repeating an attribute is listed once
+        if (last[id] != i + 1)
+        {
+            last[id] = i + 1;
+            add(index, i, id);
+        }
+    }
+}
+
+static void
+count_run(AttributeIndex* index, size_t i, size_t id)
+{
+    (void)i;
+    index->starts[id + 1]++;
+}
+
+// starts holds the next free position of each run while filling
+static void
+fill_run(AttributeIndex* index, size_t i, size_t id)
+{
+    index->runs[index->starts[id]++] = index->elements[i];
+}
+
+AttributeIndex*
+minissd_build_attribute_index(AstNode const* ast)
+{
+    AttributeIndex*  index = (AttributeIndex*)calloc(1, sizeof(AttributeIndex));
+    AttributeBuilder b;
+    if (!index)
+    {
+        return NULL;
+    }
+    b.index = index;
+    b.count = 0;
+    b.fill  = false;
+    collect_elements(&b, ast);
+
+    size_t  names = index->names.count;
+    size_t* last  = (size_t*)calloc(names + 1, sizeof(size_t));
+    index->elements = (AttributedElement*)malloc(
+        (b.count ? b.count : 1) * sizeof(AttributedElement));
+    index->starts = (size_t*)calloc(names + 1, sizeof(size_t));
+    if (!last || !index->elements || !index->starts)
+    {
+        free(last);
+        minissd_free_attribute_index(index);
+        return NULL;
+    }
+    index->element_count = b.count;
+    b.count              = 0;
+    b.fill               = true;
+    collect_elements(&b, ast);
+
+    size_t i;
+    for (i = 0; i < index->element_count; i++)
+    {
+        attribute_ids(index, i, last, count_run);
+    }
+    for (i = 0; i < names; i++)
+    {
+        index->starts[i + 1] += index->starts[i];
+    }
+    index->runs = (AttributedElement*)malloc(
+        (names ? index->starts[names] : 1) * sizeof(AttributedElement));
+    if (!index->runs)
+    {
+        free(last);
+        minissd_free_attribute_index(index);
+        return NULL;
+    }
+    memset(last, 0, (names + 1) * sizeof(size_t));
+    for (i = 0; i < index->element_count; i++)
+    {
+        attribute_ids(index, i, last, fill_run);
+    }
+    // Filling moved every start to the start of the next run
+    memmove(index->starts + 1, index->starts, names * sizeof(size_t));
+    index->starts[0] = 0;
+    free(last);
+    return index;
+}
+
+void
+minissd_free_attribute_index(AttributeIndex* index)
+{
+    if (index)
+    {
+        clear_intern_table(&index->names);
+        free(index->elements);
+        free(index->runs);
+        free(index->starts);
+        free(index);
+    }
+}
+
+AttributedElement const*
+minissd_find_attribute(AttributeIndex const* index,
+                       char const*           name,
+                       size_t                length,
+                       size_t*               count)
+{
+    int id = intern_find(&index->names, name, length, hash_bytes(name, length));
+    *count = id < 0 ? 0 : index->starts[id + 1] - index->starts[id];
+    return id < 0 ? NULL : index->runs + index->starts[id];
+}
+
+AttributedElement const*
+minissd_attributed_elements(AttributeIndex const* index, size_t* count)
+{
+    *count = index->element_count;
+    return index->elements;
+}
+
+// Diagnostics
+static char const* const diagnostic_messages[] = {
+    "Unknown type",         "Not a type",         "Duplicate declaration",
+    "Duplicate import",     "Duplicate property", "Duplicate variant",
+    "Duplicate enum value", "Duplicate handler",  "Duplicate event",
+    "Duplicate argument",   "Empty service",
+};
+
+static char const* const node_kinds[] = { "import", "data", "enum", "service" };
+
+// Adds a diagnostic about name in node, with a message naming both. The node
+// is left out of the message when it is the element
+static void
+add_diagnostic(Diagnostics*   diagnostics,
+               DiagnosticCode code,
+               AstNode const* node,
+               void const*    element,
+               char const*    name,
+               size_t         name_length)
+{
+    if (diagnostics->count == diagnostics->capacity)
+    {
+        size_t capacity = diagnostics->capacity ? diagnostics->capacity * 2 : 8;
+        Diagnostic* grown = (Diagnostic*)malloc(capacity * sizeof(Diagnostic));
+        assert(grown);
+        if (diagnostics->count)
+        {
+            memcpy(grown,
+                   diagnostics->items,
+                   diagnostics->count * sizeof(Diagnostic));
+        }
+        free(diagnostics->items);
+        diagnostics->items    = grown;
+        diagnostics->capacity = capacity;
+    }
+
+    size_t      node_length;
+    char const* node_text = node_name(node, &node_length);
+    // Arguments left over by the shorter format are ignored
+    char const* format =
+        element == node ? "%s '%.*s'" : "%s '%.*s' in %s '%.*s'";
+    char const* text      = diagnostic_messages[code];
+    char const* kind      = node_kinds[node->type];
+    int size = snprintf(NULL,
+                        0,
+                        format,
+                        text,
+                        (int)name_length,
+                        name,
+                        kind,
+                        (int)node_length,
+                        node_text);
+    char* message = (char*)malloc((size_t)size + 1);
+    assert(message);
+    snprintf(message,
+             (size_t)size + 1,
+             format,
+             text,
+             (int)name_length,
+             name,
+             kind,
+             (int)node_length,
+             node_text);
+
+    Diagnostic* d  = &diagnostics->items[diagnostics->count++];
+    d->code        = code;
+    d->node        = node;
+    d->element     = element;
+    d->name        = name;
+    d->name_length = name_length;
+    d->message     = message;
+}
+
+void
+minissd_free_diagnostics(Diagnostics* diagnostics)
+{
+    size_t i;
+    for (i = 0; i < diagnostics->count; i++)
+    {
+        free(diagnostics->items[i].message);
+    }
+    free(diagnostics->items);
+    diagnostics->items    = NULL;
+    diagnostics->count    = 0;
+    diagnostics->capacity = 0;
+}
+
+// Type resolution
+typedef struct
+{
+    char const* text;
+    size_t      length;
+} BuiltinSpelling;
+
+// Indexed by BuiltinType
+static const BuiltinSpelling builtin_spellings[] = {
+    { "", 0 },      { "bool", 4 },  { "byte", 4 },   { "char", 4 },
+    { "string", 6 }, { "int", 3 },   { "uint", 4 },   { "i8", 2 },
+    { "i16", 3 },   { "i32", 3 },   { "i64", 3 },    { "u8", 2 },
+    { "u16", 3 },   { "u32", 3 },   { "u64", 3 },    { "f32", 3 },
+    { "f64", 3 },   { "float", 5 }, { "double", 6 },
+};
+
+static BuiltinType
+find_builtin(char const* name, size_t length)
+{
+    size_t count = sizeof(builtin_spellings) / sizeof(builtin_spellings[0]);
+    size_t i;
+    for (i = 1; i < count; i++)
+    {
+        if (builtin_spellings[i].length == length &&
+            memcmp(builtin_spellings[i].text, name, length) == 0)
+        {
+            return (BuiltinType)i;
+        }
+    }
+    return MINISSD_BUILTIN_NONE;
+}
+
+typedef struct
+{
+    AstIndex*    index;
+    Diagnostics* diagnostics;  // Nullable
+    bool         resolved;     // No type failed so far
+} TypeResolver;
+
+// Import whose path is a proper prefix of the name, longest first
+static AstNode const*
+find_import_prefix(AstIndex const* index, char const* name, size_t length)
+{
+    while (length > 2)
+    {
+        length--;
+        if (name[length] == ':' && name[length - 1] == ':')
+        {
+            AstNode const* import =
+                minissd_find_import(index, name, length - 1);
+            if (import)
+            {
+                return import;
+            }
+            length--;
+        }
+    }
+    return NULL;
+}
+
+static void
+resolve_type(TypeResolver* r, Type* type, AstNode const* node)
+{
+    char const*    name  = type->name;
+    size_t         len   = type->name_length;
+    AstNode const* found = minissd_find_any(r->index, name, len);
+
+    type->builtin      = MINISSD_BUILTIN_NONE;
+    type->opt_resolved = NULL;
+    type->kind         = MINISSD_TYPE_UNRESOLVED;
+    if (found && found->type == NODE_DATA)
+    {
+        type->kind = MINISSD_TYPE_DATA;
+    }
+    else if (found && found->type == NODE_ENUM)
+    {
+        type->kind = MINISSD_TYPE_ENUM;
+    }
+    else if (found && found->type == NODE_SERVICE)
+    {
+        r->resolved = false;
+        if (r->diagnostics)
+        {
+            add_diagnostic(r->diagnostics,
+                           MINISSD_DIAGNOSTIC_NOT_A_TYPE,
+                           node,
+                           type,
+                           name,
+                           len);
+        }
+        return;
+    }
+    else if ((type->builtin = find_builtin(name, len)) != MINISSD_BUILTIN_NONE)
+    {
+        type->kind = MINISSD_TYPE_BUILTIN;
+        return;
+    }
+    else if (found || (found = find_import_prefix(r->index, name, len)))
+    {
+        type->kind = MINISSD_TYPE_IMPORT;
+    }
+    else
+    {
+        r->resolved = false;
+        if (r->diagnostics)
+        {
+            add_diagnostic(r->diagnostics,
+                           MINISSD_DIAGNOSTIC_UNKNOWN_TYPE,
+                           node,
+                           type,
+                           name,
+                           len);
+        }
+        return;
+    }
+    type->opt_resolved = found;
+}
+
+static void
+resolve_arguments(TypeResolver* r, Argument* argument, AstNode const* node)
+{
+    for (; argument; argument = argument->next)
+    {
+        resolve_type(r, &argument->type, node);
+    }
+}
+
+bool
+minissd_resolve_types(AstNode* ast, Diagnostics* opt_diagnostics)
+{
+    TypeResolver r;
+    r.index       = minissd_build_index(ast);
+    r.diagnostics = opt_diagnostics;
+    r.resolved    = true;
+    if (!r.index)
+    {
+        return false;
+    }
+
+    AstNode* node;
+    for (node = ast; node; node = node->next)
+    {
+        if (node->type == NODE_DATA)
+        {
+            Property* property = node->node.data_node.ll_properties;
+            for (; property; property = property->next)
+            {
+                resolve_type(&r, &property->type, node);
+            }
+        }
+        else if (node->type == NODE_SERVICE)
+        {
+            Handler* handler = node->node.service_node.opt_ll_handlers;
+            for (; handler; handler = handler->next)
+            {
+                resolve_arguments(&r, handler->opt_ll_arguments, node);
+                if (handler->has_return_type)
+                {
+                    resolve_type(&r, &handler->return_type, node);
+                }
+            }
+            Event* event = node->node.service_node.opt_ll_events;
+            for (; event; event = event->next)
+            {
+                resolve_arguments(&r, event->opt_ll_arguments, node);
+            }
+        }
+    }
+    minissd_free_index(r.index);
+    return r.resolved;
+}
+
+// Validation
+// Open addressing set of names or enum values. Entries of older scopes count
+// as free, so starting a new scope is O(1) however large the set grew
+typedef struct
+{
+    char const* name;  // NULL for a value
+    size_t      length;
+    int         value;
+    uint32_t    hash;
+    uint32_t    scope;
+} NameSlot;
+
+typedef struct
+{
+    NameSlot* slots;
+    size_t    capacity;  // Power of two
+    size_t    count;     // Entries of the current scope
+    uint32_t  scope;
+} NameSet;
+
+static void
+name_set_clear(NameSet* set)
+{
+    set->count = 0;
+    if (++set->scope == 0)
     {
-        DBG("Parsing service\n");
-        node->type                   = NODE_SERVICE;
-        node->node.service_node.name = parse_identifier(p, CTX("service"));
-        if (!node->node.service_node.name)
-        {
-            error(p, "Expected service name");
-            free(ident);
-            free_ast(node);
-            return NULL;
-        };
-        DBG("Service name: %s\n", node->node.service_node.name);
-        eat_whitespaces_and_comments(p);
-        ServiceComponents* sc = parse_service(p);
-        if (!sc)
-        {
-            free(ident);
-            free_ast(node);
-            return NULL;
-        };
-        if (!sc->opt_ll_handlers && !sc->opt_ll_events)
+        if (set->slots)
         {
-            error(p, "Service must have at least one handler or event");
-            free_service_components(sc);
-            free(ident);
-            free_ast(node);
-            return NULL;
+            memset(set->slots, 0, set->capacity * sizeof(NameSlot));
         }
-        DBG("Parsed service components\n");
-        node->node.service_node.opt_ll_handlers     = sc->opt_ll_handlers;
-        node->node.service_node.opt_ll_dependencies = sc->opt_ll_dependencies;
-        node->node.service_node.opt_ll_events       = sc->opt_ll_events;
-        free(sc);
+        set->scope = 1;
     }
-    else
+}
+
+static NameSlot*
+name_set_probe(NameSet const* set, NameSlot const* key)
+{
+    size_t    mask = set->capacity - 1;
+    size_t    i    = key->hash & mask;
+    NameSlot* slot = &set->slots[i];
+    while (slot->scope == set->scope)
     {
-        error(p, "Unknown node type");
-        free_ast(node);
-        node = NULL;
+        if (slot->hash == key->hash && (slot->name == NULL) == !key->name &&
+            (key->name ? slot->length == key->length &&
+                             memcmp(slot->name, key->name, key->length) == 0
+                       : slot->value == key->value))
+        {
+            return slot;
+        }
+        i    = (i + 1) & mask;
+        slot = &set->slots[i];
     }
-    free(ident);
-    if (node)
+    return slot;
+}
+
+// Adds the key to the current scope, false if it is there already
+static bool
+name_set_add(NameSet* set, NameSlot key)
+{
+    key.scope = set->scope;
+    if ((set->count + 1) * 2 > set->capacity)
     {
-        eat_whitespaces_and_comments(p);
-        if (p->current != ';')
+        NameSlot* old      = set->slots;
+        size_t    capacity = set->capacity;
+        size_t    i;
+        set->capacity = capacity ? capacity * 2 : 16;
+        set->slots    = (NameSlot*)calloc(set->capacity, sizeof(NameSlot));
+        assert(set->slots);
+        for (i = 0; i < capacity; i++)
         {
-            switch (node->type)
+            if (old[i].scope == set->scope)
             {
-            case NODE_IMPORT:
-                error(p, "Expected ';' after import declaration");
-                break;
-            case NODE_DATA:
-                error(p, "Expected ';' after data declaration");
-                break;
-            case NODE_ENUM:
-                error(p, "Expected ';' after enum declaration");
-                break;
-            case NODE_SERVICE:
-                error(p, "Expected ';' after service declaration");
-                break;
+                *name_set_probe(set, &old[i]) = old[i];
             }
-            free_ast(node);
-            return NULL;
         }
-        advance(p);
+        free(old);
     }
-    DBG("Parsed node\n");
-    eat_whitespaces_and_comments(p);
-    return node;
+    NameSlot* slot = name_set_probe(set, &key);
+    if (slot->scope == set->scope)
+    {
+        return false;
+    }
+    *slot = key;
+    set->count++;
+    return true;
 }
 
-static AstNode*
-parse(Parser* p)
+typedef struct
 {
-    advance(p);
-    AstNode *ast = NULL, *last = NULL;
-    while (p->current != '\0')
+    NameSet      declarations;
+    NameSet      imports;
+    NameSet      members;  // Of the current data, enum or service
+    NameSet      values;
+    NameSet      events;
+    NameSet      arguments;
+    Diagnostics* diagnostics;  // Nullable
+    bool         valid;
+} Validator;
+
+static void
+report(Validator*     v,
+       DiagnosticCode code,
+       AstNode const* node,
+       void const*    element,
+       char const*    name,
+       size_t         length)
+{
+    v->valid = false;
+    if (v->diagnostics)
     {
-        AstNode* node = parse_node(p);
-        if (!node)
+        add_diagnostic(v->diagnostics, code, node, element, name, length);
+    }
+}
+
+// Adds the name to the set, reporting it if it was there
+static void
+check_name(Validator*     v,
+           NameSet*       set,
+           DiagnosticCode code,
+           AstNode const* node,
+           void const*    element,
+           char const*    name,
+           size_t         length)
+{
+    NameSlot key;
+    memset(&key, 0, sizeof(key));
+    key.name   = name;
+    key.length = length;
+    key.hash   = hash_bytes(name, length);
+    if (!name_set_add(set, key))
+    {
+        report(v, code, node, element, name, length);
+    }
+}
+
+static void
+check_arguments(Validator* v, Argument const* argument, AstNode const* node)
+{
+    name_set_clear(&v->arguments);
+    for (; argument; argument = argument->next)
+    {
+        check_name(v,
+                   &v->arguments,
+                   MINISSD_DIAGNOSTIC_DUPLICATE_ARGUMENT,
+                   node,
+                   argument,
+                   argument->name,
+                   argument->name_length);
+    }
+}
+
+static void
+check_enum(Validator* v, AstNode const* node)
+{
+    EnumVariant const* variant = node->node.enum_node.ll_variants;
+    name_set_clear(&v->values);
+    for (; variant; variant = variant->next)
+    {
+        check_name(v,
+                   &v->members,
+                   MINISSD_DIAGNOSTIC_DUPLICATE_VARIANT,
+                   node,
+                   variant,
+                   variant->name,
+                   variant->name_length);
+
+        NameSlot key;
+        memset(&key, 0, sizeof(key));
+        key.value = variant->value;
+        key.hash  = hash_bytes((char const*)&key.value, sizeof(key.value));
+        if (!name_set_add(&v->values, key))
         {
-            free_ast(ast);
-            return NULL;
+            report(v,
+                   MINISSD_DIAGNOSTIC_DUPLICATE_VALUE,
+                   node,
+                   variant,
+                   variant->name,
+                   variant->name_length);
+        }
+    }
+}
+
+static void
+check_service(Validator* v, AstNode const* node)
+{
+    Service const* service = &node->node.service_node;
+    Handler const* handler = service->opt_ll_handlers;
+    Event const*   event   = service->opt_ll_events;
+    if (!handler && !event)
+    {
+        // The parser rejects these, but ASTs may be built by hand
+        report(v,
+               MINISSD_DIAGNOSTIC_EMPTY_SERVICE,
+               node,
+               node,
+               service->name,
+               service->name_length);
+        return;
+    }
+    name_set_clear(&v->events);
+    for (; handler; handler = handler->next)
+    {
+        check_name(v,
+                   &v->members,
+                   MINISSD_DIAGNOSTIC_DUPLICATE_HANDLER,
+                   node,
+                   handler,
+                   handler->name,
+                   handler->name_length);
+        check_arguments(v, handler->opt_ll_arguments, node);
+    }
+    for (; event; event = event->next)
+    {
+        check_name(v,
+                   &v->events,
+                   MINISSD_DIAGNOSTIC_DUPLICATE_EVENT,
+                   node,
+                   event,
+                   event->name,
+                   event->name_length);
+        check_arguments(v, event->opt_ll_arguments, node);
+    }
+}
+
+bool
+minissd_validate(AstNode const* ast, Diagnostics* opt_diagnostics)
+{
+    Validator v;
+    memset(&v, 0, sizeof(v));
+    v.diagnostics = opt_diagnostics;
+    v.valid       = true;
+    name_set_clear(&v.declarations);
+    name_set_clear(&v.imports);
+
+    AstNode const* node;
+    for (node = ast; node; node = node->next)
+    {
+        size_t      length;
+        char const* name   = node_name(node, &length);
+        bool        import = node->type == NODE_IMPORT;
+        check_name(&v,
+                   import ? &v.imports : &v.declarations,
+                   import ? MINISSD_DIAGNOSTIC_DUPLICATE_IMPORT
+                          : MINISSD_DIAGNOSTIC_DUPLICATE_DECLARATION,
+                   node,
+                   node,
+                   name,
+                   length);
+
+        name_set_clear(&v.members);
+        if (node->type == NODE_DATA)
+        {
+            Property const* property = node->node.data_node.ll_properties;
+            for (; property; property = property->next)
+            {
+                check_name(&v,
+                           &v.members,
+                           MINISSD_DIAGNOSTIC_DUPLICATE_PROPERTY,
+                           node,
+                           property,
+                           property->name,
+                           property->name_length);
+            }
         }
-        if (!ast)
+        else if (node->type == NODE_ENUM)
         {
-            ast = node;
+            check_enum(&v, node);
         }
-        else
+        else if (node->type == NODE_SERVICE)
         {
-            last->next = node;
+            check_service(&v, node);
         }
-        last = node;
     }
-    if (!ast)
+    free(v.declarations.slots);
+    free(v.imports.slots);
+    free(v.members.slots);
+    free(v.values.slots);
+    free(v.events.slots);
+    free(v.arguments.slots);
+    return v.valid;
+}
+
+// Enum tables
+static int
+compare_entry_values(EnumEntry const* a, EnumEntry const* b)
+{
+    return a->value < b->value ? -1 : a->value > b->value;
+}
+
+static int
+compare_entry_names(EnumEntry const* a, EnumEntry const* b)
+{
+    size_t length = a->name_length < b->name_length ? a->name_length
+                                                      : b->name_length;
+    int    order  = memcmp(a->name, b->name, length);
+    if (order)
     {
-        error(p, "Expected at least one node");
-        return NULL;
+        return order;
     }
-    DBG("Parsed AST\n");
-    return ast;
+    return a->name_length < b->name_length ? -1
+                                           : a->name_length > b->name_length;
 }
 
-static Parser*
-create_parser(const char* input)
+// Stable merge sort, qsort is neither stable nor available in WASM builds
+static void
+sort_entries(EnumEntry* entries,
+             EnumEntry* scratch,
+             size_t     count,
+             int (*compare)(EnumEntry const* a, EnumEntry const* b))
 {
-    DBG("Creating parser\n");
-    assert(input);
-    Parser* p = (Parser*)calloc(1, sizeof(Parser));
-    assert(p);
-    p->input        = input;
-    p->input_length = strlen(input);
-    return p;
+    if (count < 2)
+    {
+        return;
+    }
+    size_t half = count / 2;
+    sort_entries(entries, scratch, half, compare);
+    sort_entries(entries + half, scratch, count - half, compare);
+    size_t i = 0, j = half, k = 0;
+    while (i < half && j < count)
+    {
+        // Taking the left one on ties keeps equal entries in order
+        scratch[k++] = compare(&entries[j], &entries[i]) < 0 ? entries[j++]
+                                                             : entries[i++];
+    }
+    while (i < half)
+    {
+        scratch[k++] = entries[i++];
+    }
+    memcpy(entries, scratch, k * sizeof(EnumEntry));
 }
 
-// Parser functions
-Parser*
-minissd_create_parser(const char* input)
+EnumTable*
+minissd_build_enum_table(AstNode const* node)
 {
-    return create_parser(input);
+    if (!node || node->type != NODE_ENUM)
+    {
+        return NULL;
+    }
+    EnumVariant const* variant = node->node.enum_node.ll_variants;
+    size_t             count   = 0;
+    for (; variant; variant = variant->next)
+    {
+        count++;
+    }
+
+    // The table, both orders and the scratch space of the sort in one block
+    EnumTable* table = (EnumTable*)malloc(sizeof(EnumTable) +
+                                          3 * count * sizeof(EnumEntry));
+    if (!table)
+    {
+        return NULL;
+    }
+    EnumEntry* by_value = (EnumEntry*)(table + 1);
+    EnumEntry* by_name  = by_value + count;
+    size_t     i        = 0;
+    for (variant = node->node.enum_node.ll_variants; variant;
+         variant = variant->next)
+    {
+        by_value[i].name        = variant->name;
+        by_value[i].name_length = variant->name_length;
+        by_value[i].value       = variant->value;
+        by_value[i].variant     = variant;
+        i++;
+    }
+    memcpy(by_name, by_value, count * sizeof(EnumEntry));
+    sort_entries(by_value, by_name + count, count, compare_entry_values);
+    sort_entries(by_name, by_name + count, count, compare_entry_names);
+
+    table->by_value = by_value;
+    table->by_name  = by_name;
+    table->count    = count;
+    table->min      = count ? by_value[0].value : 0;
+    table->max      = count ? by_value[count - 1].value : 0;
+    table->unique   = true;
+    for (i = 1; i < count && table->unique; i++)
+    {
+        table->unique = by_value[i].value != by_value[i - 1].value;
+    }
+    table->dense = table->unique &&
+                   (long long)table->max - table->min + 1 == (long long)count;
+    return table;
 }
 
 void
-minissd_free_parser(Parser* p)
+minissd_free_enum_table(EnumTable* table)
 {
-    free(p);
+    free(table);
 }
 
-// Parsing
-AstNode*
-minissd_parse(Parser* p)
+EnumEntry const*
+minissd_enum_find_value(EnumTable const* table, int value)
 {
-    return parse(p);
+    if (!table->count || value < table->min || value > table->max)
+    {
+        return NULL;
+    }
+    if (table->dense)
+    {
+        return &table->by_value[value - table->min];
+    }
+    size_t low = 0, high = table->count;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (table->by_value[middle].value < value)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low < table->count && table->by_value[low].value == value
+               ? &table->by_value[low]
+               : NULL;
 }
 
-void
-minissd_free_ast(AstNode* ast)
+EnumEntry const*
+minissd_enum_find_name(EnumTable const* table, char const* name, size_t length)
 {
-    free_ast(ast);
+    EnumEntry key;
+    key.name        = name;
+    key.name_length = length;
+    size_t low = 0, high = table->count;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        int    order  = compare_entry_names(&table->by_name[middle], &key);
+        if (order == 0)
+        {
+            return &table->by_name[middle];
+        }
+        if (order < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return NULL;
 }
 
 // AST Node accessors
@@ -1719,18 +7060,40 @@ minissd_get_import_path(AstNode const* node)
                                                : NULL;
 }
 
+size_t
+minissd_get_import_path_length(AstNode const* node)
+{
+    return (node && node->type == NODE_IMPORT)
+               ? node->node.import_node.path_length
+               : 0;
+}
+
 char const*
 minissd_get_data_name(AstNode const* node)
 {
     return (node && node->type == NODE_DATA) ? node->node.data_node.name : NULL;
 }
 
+size_t
+minissd_get_data_name_length(AstNode const* node)
+{
+    return (node && node->type == NODE_DATA) ? node->node.data_node.name_length
+                                             : 0;
+}
+
 char const*
 minissd_get_enum_name(AstNode const* node)
 {
     return (node && node->type == NODE_ENUM) ? node->node.enum_node.name : NULL;
 }
 
+size_t
+minissd_get_enum_name_length(AstNode const* node)
+{
+    return (node && node->type == NODE_ENUM) ? node->node.enum_node.name_length
+                                             : 0;
+}
+
 Attribute const*
 minissd_get_handler_attributes(Handler const* node)
 {
@@ -1743,10 +7106,17 @@ minissd_get_handler_name(Handler const* handler)
     return (handler) ? handler->name : NULL;
 }
 
+size_t
+minissd_get_handler_name_length(Handler const* handler)
+{
+    return (handler) ? handler->name_length : 0;
+}
+
 Type const*
 minissd_get_handler_return_type(Handler const* handler)
 {
-    return (handler) ? handler->opt_return_type : NULL;
+    return handler && handler->has_return_type ? &handler->return_type
+                                               : NULL;
 }
 
 char const*
@@ -1755,6 +7125,12 @@ minissd_get_event_name(Event const* event)
     return (event) ? event->name : NULL;
 }
 
+size_t
+minissd_get_event_name_length(Event const* event)
+{
+    return (event) ? event->name_length : 0;
+}
+
 // Attribute accessors
 Attribute const*
 minissd_get_attributes(AstNode const* node)
@@ -1768,6 +7144,12 @@ minissd_get_attribute_name(Attribute const* attr)
     return attr ? attr->name : NULL;
 }
 
+size_t
+minissd_get_attribute_name_length(Attribute const* attr)
+{
+    return attr ? attr->name_length : 0;
+}
+
 AttributeParameter const*
 minissd_get_attribute_parameters(Attribute const* attr)
 {
@@ -1789,12 +7171,24 @@ minissd_get_property_name(Property const* prop)
     return prop ? prop->name : NULL;
 }
 
+size_t
+minissd_get_property_name_length(Property const* prop)
+{
+    return prop ? prop->name_length : 0;
+}
+
 char const*
 minissd_get_type_name(Type const* type)
 {
     return type ? type->name : NULL;
 }
 
+size_t
+minissd_get_type_name_length(Type const* type)
+{
+    return type ? type->name_length : 0;
+}
+
 bool
 minissd_get_type_is_list(Type const* type)
 {
@@ -1804,7 +7198,25 @@ minissd_get_type_is_list(Type const* type)
 int const*
 minissd_get_type_count(Type const* type)
 {
-    return type ? type->count : NULL;
+    return type && type->has_count ? &type->count : NULL;
+}
+
+TypeKind
+minissd_get_type_kind(Type const* type)
+{
+    return type ? type->kind : MINISSD_TYPE_UNRESOLVED;
+}
+
+BuiltinType
+minissd_get_type_builtin(Type const* type)
+{
+    return type ? type->builtin : MINISSD_BUILTIN_NONE;
+}
+
+AstNode const*
+minissd_get_type_resolved(Type const* type)
+{
+    return type ? type->opt_resolved : NULL;
 }
 
 Attribute const*
@@ -1816,7 +7228,7 @@ minissd_get_property_attributes(Property const* prop)
 Type const*
 minissd_get_property_type(Property const* prop)
 {
-    return prop ? prop->type : NULL;
+    return prop ? &prop->type : NULL;
 }
 
 Dependency const*
@@ -1857,6 +7269,12 @@ minissd_get_enum_variant_name(EnumVariant const* value)
     return value ? value->name : NULL;
 }
 
+size_t
+minissd_get_enum_variant_name_length(EnumVariant const* value)
+{
+    return value ? value->name_length : 0;
+}
+
 Attribute const*
 minissd_get_enum_variant_attributes(EnumVariant const* value)
 {
@@ -1866,7 +7284,7 @@ minissd_get_enum_variant_attributes(EnumVariant const* value)
 int
 minissd_get_enum_variant_value(EnumVariant const* value, bool* has_value)
 {
-    if (!value || !value->opt_value)
+    if (!value || !value->has_value)
     {
         if (has_value)
         {
@@ -1878,7 +7296,13 @@ minissd_get_enum_variant_value(EnumVariant const* value, bool* has_value)
     {
         *has_value = true;
     }
-    return *(value->opt_value);
+    return value->value;
+}
+
+int
+minissd_get_enum_variant_effective_value(EnumVariant const* value)
+{
+    return value ? value->value : 0;
 }
 
 Argument const*
@@ -1898,6 +7322,12 @@ minissd_get_argument_name(Argument const* arg)
 {
     return arg ? arg->name : NULL;
 }
+
+size_t
+minissd_get_argument_name_length(Argument const* arg)
+{
+    return arg ? arg->name_length : 0;
+}
 Attribute const*
 minissd_get_argument_attributes(Argument const* arg)
 {
@@ -1906,7 +7336,7 @@ minissd_get_argument_attributes(Argument const* arg)
 Type const*
 minissd_get_argument_type(Argument const* arg)
 {
-    return arg ? arg->type : NULL;
+    return arg ? &arg->type : NULL;
 }
 
 // Traversal functions
@@ -1916,6 +7346,18 @@ minissd_get_next_node(AstNode const* node)
     return node ? node->next : NULL;
 }
 
+size_t
+minissd_get_node_offset(AstNode const* node)
+{
+    return node ? node->offset : 0;
+}
+
+size_t
+minissd_get_node_length(AstNode const* node)
+{
+    return node ? node->length : 0;
+}
+
 Property const*
 minissd_get_next_property(Property const* prop)
 {
@@ -1946,12 +7388,26 @@ minissd_get_attribute_parameter_name(AttributeParameter const* arg)
     return arg ? arg->key : NULL;
 }
 
+size_t
+minissd_get_attribute_parameter_name_length(
+    AttributeParameter const* arg)
+{
+    return arg ? arg->key_length : 0;
+}
+
 char const*
 minissd_get_attribute_parameter_value(AttributeParameter const* arg)
 {
     return arg ? arg->opt_value : NULL;
 }
 
+size_t
+minissd_get_attribute_parameter_value_length(
+    AttributeParameter const* arg)
+{
+    return arg ? arg->value_length : 0;
+}
+
 Dependency const*
 minissd_get_next_dependency(Dependency const* dep)
 {
@@ -1982,9 +7438,23 @@ minissd_get_dependency_path(Dependency const* dep)
     return dep ? dep->path : NULL;
 }
 
+size_t
+minissd_get_dependency_path_length(Dependency const* dep)
+{
+    return dep ? dep->path_length : 0;
+}
+
 char const*
 minissd_get_service_name(AstNode const* node)
 {
     return (node && node->type == NODE_SERVICE) ? node->node.service_node.name
                                                 : NULL;
 }
+
+size_t
+minissd_get_service_name_length(AstNode const* node)
+{
+    return (node && node->type == NODE_SERVICE)
+               ? node->node.service_node.name_length
+               : 0;
+}
@@ -1,5 +1,18 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "minissd.h"
 
 class ParserTest : public ::testing::Test
@@ -1132,4 +1145,2213 @@ TEST_F(ParserTest, ValidInput_MultipleAttributes2)
     ASSERT_NE(param, nullptr);
     ASSERT_STREQ(param->key, "name");
     ASSERT_STREQ(param->opt_value, "value1");
-}
\ No newline at end of file
+}
+TEST_F(ParserTest, ArenaInput_Service)
+{
+    const char *source_code = "#[a(b=\"c\")] service S { depends on x::y; fn f(a: int) -> list of string; event e(b: 5 of byte); };";
+
+    parser = minissd_create_parser(source_code);
+    minissd_set_parser_flags(parser, MINISSD_PARSE_ARENA);
+    ast = minissd_parse(parser);
+
+    ASSERT_NE(ast, nullptr);
+    ASSERT_STREQ(minissd_get_service_name(ast), "S");
+    ASSERT_STREQ(minissd_get_attribute_parameter_value(minissd_get_attribute_parameters(minissd_get_attributes(ast))), "c");
+    ASSERT_STREQ(minissd_get_dependency_path(minissd_get_dependencies(ast)), "x::y");
+
+    Handler const *handler = minissd_get_handlers(ast);
+    ASSERT_STREQ(minissd_get_handler_name(handler), "f");
+    ASSERT_STREQ(minissd_get_argument_name(minissd_get_handler_arguments(handler)), "a");
+    ASSERT_TRUE(minissd_get_type_is_list(minissd_get_handler_return_type(handler)));
+
+    Argument const *arg = minissd_get_event_arguments(minissd_get_events(ast));
+    ASSERT_EQ(*minissd_get_type_count(minissd_get_argument_type(arg)), 5);
+
+    ASSERT_EQ(parser->allocation_count, 0u);
+    ASSERT_GT(parser->owned_arena.allocation_count, 0u);
+    ASSERT_EQ(parser->owned_arena.block_count, 1u);
+}
+
+TEST_F(ParserTest, ArenaInput_CallerArena)
+{
+    const char *source_code = "data A { x: int }; data B { y: A };";
+
+    Arena arena;
+    minissd_init_arena(&arena, 128);
+
+    parser = minissd_create_parser(source_code);
+    minissd_set_parser_arena(parser, &arena);
+    AstNode *arena_ast = minissd_parse(parser);
+    ast = nullptr;
+
+    ASSERT_NE(arena_ast, nullptr);
+    ASSERT_STREQ(minissd_get_data_name(arena_ast), "A");
+    ASSERT_STREQ(minissd_get_data_name(minissd_get_next_node(arena_ast)), "B");
+    ASSERT_GT(arena.block_count, 1u);
+    ASSERT_EQ(parser->owned_arena.blocks, nullptr);
+
+    // The AST belongs to the arena, freeing it separately is a no-op
+    minissd_free_ast(arena_ast);
+    minissd_free_arena(&arena);
+    ASSERT_EQ(arena.blocks, nullptr);
+    ASSERT_EQ(arena.allocation_count, 0u);
+}
+
+TEST_F(ParserTest, ArenaInput_Invalid)
+{
+    const char *source_code = "data A { #[x(y=\"z\")] a: int, b: list of int, c };";
+
+    parser = minissd_create_parser(source_code);
+    minissd_set_parser_flags(parser, MINISSD_PARSE_ARENA);
+    ast = minissd_parse(parser);
+
+    ASSERT_EQ(ast, nullptr);
+    ASSERT_STREQ(parser->error, "Error: Expected ':' after property name at line 1, column 49");
+}
+
+TEST_F(ParserTest, ZeroCopyInput_Data)
+{
+    const char *source_code = "#[table(name=\"people\")] data Person { #[key] id: a::Id, tags: list of string };";
+
+    parser = minissd_create_parser(source_code);
+    minissd_set_parser_flags(parser, MINISSD_PARSE_ZERO_COPY);
+    ast = minissd_parse(parser);
+
+    ASSERT_NE(ast, nullptr);
+    ASSERT_EQ(minissd_get_data_name(ast), strstr(source_code, "Person"));
+    ASSERT_EQ(minissd_get_data_name_length(ast), 6u);
+
+    Attribute const *attr = minissd_get_attributes(ast);
+    ASSERT_EQ(std::string(minissd_get_attribute_name(attr), minissd_get_attribute_name_length(attr)), "table");
+    AttributeParameter const *param = minissd_get_attribute_parameters(attr);
+    ASSERT_EQ(std::string(minissd_get_attribute_parameter_name(param), minissd_get_attribute_parameter_name_length(param)), "name");
+    ASSERT_EQ(std::string(minissd_get_attribute_parameter_value(param), minissd_get_attribute_parameter_value_length(param)), "people");
+
+    Property const *prop = minissd_get_properties(ast);
+    ASSERT_EQ(std::string(minissd_get_property_name(prop), minissd_get_property_name_length(prop)), "id");
+    Type const *type = minissd_get_property_type(prop);
+    ASSERT_EQ(std::string(minissd_get_type_name(type), minissd_get_type_name_length(type)), "a::Id");
+
+    prop = minissd_get_next_property(prop);
+    type = minissd_get_property_type(prop);
+    ASSERT_TRUE(minissd_get_type_is_list(type));
+    ASSERT_EQ(std::string(minissd_get_type_name(type), minissd_get_type_name_length(type)), "string");
+}
+
+TEST_F(ParserTest, ZeroCopyInput_ArenaService)
+{
+    const char *source_code = "service S { depends on x::y; fn f(a: int) -> out; event e(); };";
+
+    parser = minissd_create_parser(source_code);
+    minissd_set_parser_flags(parser, MINISSD_PARSE_ZERO_COPY | MINISSD_PARSE_ARENA);
+    ast = minissd_parse(parser);
+
+    ASSERT_NE(ast, nullptr);
+    Dependency const *dep = minissd_get_dependencies(ast);
+    ASSERT_EQ(std::string(minissd_get_dependency_path(dep), minissd_get_dependency_path_length(dep)), "x::y");
+    Handler const *handler = minissd_get_handlers(ast);
+    ASSERT_EQ(std::string(minissd_get_handler_name(handler), minissd_get_handler_name_length(handler)), "f");
+    Argument const *arg = minissd_get_handler_arguments(handler);
+    ASSERT_EQ(std::string(minissd_get_argument_name(arg), minissd_get_argument_name_length(arg)), "a");
+    Event const *event = minissd_get_events(ast);
+    ASSERT_EQ(std::string(minissd_get_event_name(event), minissd_get_event_name_length(event)), "e");
+
+    // Only the node objects live in the arena, no string was copied
+    ASSERT_EQ(parser->allocation_count, 0u);
+}
+
+TEST_F(ParserTest, NameLengths_Copied)
+{
+    const char *source_code = "import a::b; enum E { Value = 1 };";
+
+    parser = minissd_create_parser(source_code);
+    ast = minissd_parse(parser);
+
+    ASSERT_NE(ast, nullptr);
+    ASSERT_STREQ(minissd_get_import_path(ast), "a::b");
+    ASSERT_EQ(minissd_get_import_path_length(ast), 4u);
+
+    AstNode const *node = minissd_get_next_node(ast);
+    ASSERT_EQ(minissd_get_enum_name_length(node), 1u);
+    EnumVariant const *variant = minissd_get_enum_variants(node);
+    ASSERT_STREQ(minissd_get_enum_variant_name(variant), "Value");
+    ASSERT_EQ(minissd_get_enum_variant_name_length(variant), 5u);
+}
+
+TEST_F(ParserTest, InternInput_SharedNames)
+{
+    const char *source_code = "#[column(name=\"a\")] data A { #[column(name=\"b\")] name: string, other: string }; data B { name: list of string };";
+
+    parser = minissd_create_parser(source_code);
+    minissd_set_parser_flags(parser, MINISSD_PARSE_INTERN);
+    ast = minissd_parse(parser);
+
+    ASSERT_NE(ast, nullptr);
+    Property const *name_a = minissd_get_properties(ast);
+    Property const *other = minissd_get_next_property(name_a);
+    Property const *name_b = minissd_get_properties(minissd_get_next_node(ast));
+
+    ASSERT_STREQ(minissd_get_property_name(name_a), "name");
+    ASSERT_EQ(minissd_get_property_name(name_a), minissd_get_property_name(name_b));
+    ASSERT_EQ(minissd_get_type_name(minissd_get_property_type(name_a)), minissd_get_type_name(minissd_get_property_type(other)));
+    ASSERT_EQ(minissd_get_type_name(minissd_get_property_type(name_a)), minissd_get_type_name(minissd_get_property_type(name_b)));
+
+    Attribute const *node_attr = minissd_get_attributes(ast);
+    Attribute const *prop_attr = minissd_get_property_attributes(name_a);
+    ASSERT_EQ(minissd_get_attribute_name(node_attr), minissd_get_attribute_name(prop_attr));
+    AttributeParameter const *param = minissd_get_attribute_parameters(prop_attr);
+    ASSERT_EQ(minissd_get_attribute_parameter_name(param), minissd_get_property_name(name_a));
+    ASSERT_STREQ(minissd_get_attribute_parameter_value(param), "b");
+
+    int string_id = minissd_intern_lookup(parser, "string", 6);
+    ASSERT_GE(string_id, 0);
+    ASSERT_EQ(minissd_intern_id(minissd_get_type_name(minissd_get_property_type(other))), string_id);
+    ASSERT_STREQ(minissd_intern_string(parser, string_id), "string");
+    ASSERT_EQ(minissd_intern_lookup(parser, "missing", 7), -1);
+    ASSERT_EQ(minissd_intern_string(parser, (int)minissd_intern_count(parser)), nullptr);
+}
+
+TEST_F(ParserTest, InternInput_StableIds)
+{
+    const char *source_code = "enum E { A, B, A };";
+
+    parser = minissd_create_parser(source_code);
+    minissd_set_parser_flags(parser, MINISSD_PARSE_INTERN | MINISSD_PARSE_ARENA);
+    ast = minissd_parse(parser);
+
+    ASSERT_NE(ast, nullptr);
+    // Keywords are matched by the lexer and never interned
+    ASSERT_EQ(minissd_intern_lookup(parser, "enum", 4), -1);
+    ASSERT_EQ(minissd_intern_id(minissd_get_enum_name(ast)), 0);
+
+    EnumVariant const *a = minissd_get_enum_variants(ast);
+    EnumVariant const *b = minissd_get_next_enum_variant(a);
+    EnumVariant const *again = minissd_get_next_enum_variant(b);
+    ASSERT_EQ(minissd_intern_id(minissd_get_enum_variant_name(a)), 1);
+    ASSERT_EQ(minissd_intern_id(minissd_get_enum_variant_name(b)), 2);
+    ASSERT_EQ(minissd_get_enum_variant_name(a), minissd_get_enum_variant_name(again));
+    ASSERT_EQ(minissd_intern_count(parser), 3u);
+}
+
+TEST_F(ParserTest, InternInput_ManyNames)
+{
+    std::string source_code;
+    for (int i = 0; i < 1000; i++)
+    {
+        source_code += "data D" + std::to_string(i) + " { f" + std::to_string(i % 10) + ": int };";
+    }
+
+    parser = minissd_create_parser(source_code.c_str());
+    minissd_set_parser_flags(parser, MINISSD_PARSE_INTERN);
+    ast = minissd_parse(parser);
+
+    ASSERT_NE(ast, nullptr);
+    // D0..D999, f0..f9 and int
+    ASSERT_EQ(minissd_intern_count(parser), 1011u);
+    for (AstNode const *node = ast; node; node = minissd_get_next_node(node))
+    {
+        char const *name = minissd_get_data_name(node);
+        ASSERT_EQ(minissd_intern_string(parser, minissd_intern_id(name)), name);
+        ASSERT_EQ(minissd_intern_lookup(parser, name, strlen(name)), minissd_intern_id(name));
+    }
+}
+
+TEST_F(ParserTest, StructuredError)
+{
+    const char *source_code = "data Person {\n  name: string,\n  age int\n};";
+
+    parser = minissd_create_parser(source_code);
+    ast = minissd_parse(parser);
+
+    ASSERT_EQ(ast, nullptr);
+    ParseError const *error = minissd_get_error(parser);
+    ASSERT_NE(error, nullptr);
+    ASSERT_EQ(error->code, MINISSD_ERROR_EXPECTED_PROPERTY_COLON);
+    ASSERT_EQ(error->offset, strlen("data Person {\n  name: string,\n  age i"));
+    ASSERT_STREQ(minissd_get_error_message(error->code), "Expected ':' after property name");
+    ASSERT_STREQ(parser->error, "Error: Expected ':' after property name at line 3, column 8");
+
+    char small[16];
+    size_t length = minissd_format_error(parser, small, sizeof(small));
+    ASSERT_EQ(length, strlen(parser->error));
+    ASSERT_STREQ(small, "Error: Expected");
+}
+
+TEST_F(ParserTest, NoErrorAfterTypeLookahead)
+{
+    const char *source_code = "data A { a: string, b: list of int, c: 4 of byte, d: listing, e: a::b };";
+
+    parser = minissd_create_parser(source_code);
+    ast = minissd_parse(parser);
+
+    ASSERT_NE(ast, nullptr);
+    ASSERT_EQ(minissd_get_error(parser), nullptr);
+    ASSERT_STREQ(parser->error, "");
+
+    char buffer[8] = "x";
+    ASSERT_EQ(minissd_format_error(parser, buffer, sizeof(buffer)), 0u);
+    ASSERT_STREQ(buffer, "");
+
+    Property const *prop = minissd_get_properties(ast);
+    prop = minissd_get_next_property(minissd_get_next_property(minissd_get_next_property(prop)));
+    ASSERT_FALSE(minissd_get_type_is_list(minissd_get_property_type(prop)));
+    ASSERT_STREQ(minissd_get_type_name(minissd_get_property_type(prop)), "listing");
+}
+
+TEST_F(ParserTest, InvalidInput_ListWithoutOf)
+{
+    const char *source_code = "data A { a: list int };";
+
+    parser = minissd_create_parser(source_code);
+    ast = minissd_parse(parser);
+
+    ASSERT_EQ(ast, nullptr);
+    ASSERT_EQ(minissd_get_error(parser)->code, MINISSD_ERROR_EXPECTED_OF);
+    ASSERT_STREQ(parser->error, "Error: Expected 'of' after 'list' at line 1, column 22");
+}
+
+TEST(ParserScaling, AllocationsGrowLinearly)
+{
+    std::string small, large;
+    for (int i = 0; i < 16 * 1000; i++)
+    {
+        std::string node = "data D" + std::to_string(i) + " {\n  a: string,\n  b: list of int,\n  c: 8 of byte,\n};\n";
+        if (i < 1000)
+        {
+            small += node;
+        }
+        large += node;
+    }
+
+    // Timing belongs to the scaling bench case, counts are deterministic
+    size_t counts[2];
+    std::string const *sources[2] = { &small, &large };
+    for (int i = 0; i < 2; i++)
+    {
+        Parser *p = minissd_create_parser(sources[i]->c_str());
+        AstNode *result = minissd_parse(p);
+        ASSERT_NE(result, nullptr);
+        counts[i] = p->allocation_count;
+        minissd_free_ast(result);
+        minissd_free_parser(p);
+    }
+    ASSERT_EQ(counts[1], counts[0] * 16);
+}
+
+TEST_F(ParserTest, OffsetToLineCol)
+{
+    const char *source_code = "data A {\n\n  a: int\n};\n";
+
+    parser = minissd_create_parser(source_code);
+    ast = minissd_parse(parser);
+    ASSERT_NE(ast, nullptr);
+
+    int line = 0, column = 0;
+    minissd_offset_to_line_col(parser, 0, &line, &column);
+    ASSERT_EQ(line, 1);
+    ASSERT_EQ(column, 1);
+
+    minissd_offset_to_line_col(parser, 8, &line, &column);
+    ASSERT_EQ(line, 1);
+    ASSERT_EQ(column, 9);
+
+    minissd_offset_to_line_col(parser, 9, &line, &column);
+    ASSERT_EQ(line, 2);
+    ASSERT_EQ(column, 1);
+
+    minissd_offset_to_line_col(parser, 12, &line, &column);
+    ASSERT_EQ(line, 3);
+    ASSERT_EQ(column, 3);
+
+    // Offsets past the end clamp to the end of the input
+    minissd_offset_to_line_col(parser, 1000, &line, &column);
+    ASSERT_EQ(line, 5);
+    ASSERT_EQ(column, 1);
+    ASSERT_EQ(parser->line_count, 5u);
+}
+
+TEST_F(ParserTest, ErrorLineAndColumn)
+{
+    const char *source_code = "enum E { A };\n// comment\ndata D {\n  a: int,\n  b int\n};";
+
+    parser = minissd_create_parser(source_code);
+    ast = minissd_parse(parser);
+
+    ASSERT_EQ(ast, nullptr);
+    ASSERT_EQ(parser->line, 5);
+    ASSERT_EQ(parser->column, 6);
+    ASSERT_STREQ(parser->error, "Error: Expected ':' after property name at line 5, column 6");
+}
+
+TEST_F(ParserTest, LengthDelimited_SliceOfBundle)
+{
+    const char *bundle = "enum A { X };data B { b: int };service C { event e(); };";
+    const char *slice = strstr(bundle, "data");
+
+    parser = minissd_create_parser_n(slice, strlen("data B { b: int };"));
+    minissd_set_parser_flags(parser, MINISSD_PARSE_ZERO_COPY);
+    ast = minissd_parse(parser);
+
+    ASSERT_NE(ast, nullptr);
+    ASSERT_EQ(*minissd_get_node_type(ast), NODE_DATA);
+    ASSERT_EQ(minissd_get_data_name(ast), slice + 5);
+    ASSERT_EQ(minissd_get_next_node(ast), nullptr);
+}
+
+TEST_F(ParserTest, LengthDelimited_Unterminated)
+{
+    const std::string source = "import a::b;\nenum E { One = 1, Two }; // trailing";
+    std::vector<char> buffer(source.begin(), source.end());
+
+    parser = minissd_create_parser_n(buffer.data(), buffer.size());
+    ast = minissd_parse(parser);
+
+    ASSERT_NE(ast, nullptr);
+    ASSERT_EQ(std::string(minissd_get_import_path(ast)), "a::b");
+    AstNode const *node = minissd_get_next_node(ast);
+    ASSERT_NE(node, nullptr);
+    ASSERT_EQ(std::string(minissd_get_enum_name(node)), "E");
+}
+
+TEST_F(ParserTest, LengthDelimited_TruncatedToken)
+{
+    const std::string source = "data D { value: integer };";
+    std::vector<char> buffer(source.begin(), source.begin() + source.find("eger"));
+
+    parser = minissd_create_parser_n(buffer.data(), buffer.size());
+    ast = minissd_parse(parser);
+
+    ASSERT_EQ(ast, nullptr);
+    ASSERT_EQ(minissd_get_error(parser)->offset, buffer.size());
+}
+
+#ifndef _WIN32
+static std::string write_temp_file(const std::string &contents)
+{
+    char path[] = "/tmp/minissd_test_XXXXXX";
+    int fd = mkstemp(path);
+    EXPECT_GE(fd, 0);
+    EXPECT_EQ(write(fd, contents.data(), contents.size()), (ssize_t)contents.size());
+    close(fd);
+    return path;
+}
+
+TEST_F(ParserTest, ParseFile_Mapped)
+{
+    std::string path = write_temp_file("import a::b;\ndata D { value: int };");
+
+    ast = minissd_parse_file(path.c_str(), MINISSD_PARSE_ZERO_COPY, &parser);
+    unlink(path.c_str());
+
+    ASSERT_NE(parser, nullptr);
+    ASSERT_NE(parser->mapping, nullptr);
+    ASSERT_NE(ast, nullptr);
+    ASSERT_EQ(minissd_get_import_path(ast), parser->input + 7);
+    AstNode const *node = minissd_get_next_node(ast);
+    ASSERT_EQ(std::string(minissd_get_data_name(node), minissd_get_data_name_length(node)), "D");
+}
+
+TEST_F(ParserTest, ParseFile_Error)
+{
+    std::string path = write_temp_file("data D {\n  value int\n};");
+
+    ast = minissd_parse_file(path.c_str(), MINISSD_PARSE_DEFAULT, &parser);
+    unlink(path.c_str());
+
+    ASSERT_EQ(ast, nullptr);
+    ASSERT_NE(parser, nullptr);
+    ASSERT_STREQ(parser->error, "Error: Expected ':' after property name at line 2, column 10");
+}
+
+TEST_F(ParserTest, ParseFile_Missing)
+{
+    ast = minissd_parse_file("/nonexistent/schema.ssd", MINISSD_PARSE_DEFAULT, &parser);
+
+    ASSERT_EQ(ast, nullptr);
+    ASSERT_EQ(parser, nullptr);
+}
+
+TEST_F(ParserTest, ParseFile_Pipe)
+{
+    const std::string source = "enum E { A, B };";
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    ASSERT_EQ(write(fds[1], source.data(), source.size()), (ssize_t)source.size());
+    close(fds[1]);
+
+    std::string path = "/dev/fd/" + std::to_string(fds[0]);
+    parser = minissd_create_parser_from_file(path.c_str());
+    close(fds[0]);
+
+    ASSERT_NE(parser, nullptr);
+    ASSERT_EQ(parser->mapping, nullptr);
+    ast = minissd_parse(parser);
+    ASSERT_NE(ast, nullptr);
+    ASSERT_STREQ(minissd_get_enum_name(ast), "E");
+}
+#endif
+
+TEST(Lexer, TokenKindsAndOffsets)
+{
+    const char *source_code = "#[a(k=\"v\")] data D { x: list of a::B, } // done\nfn f() -> 32 of int; @";
+    size_t count = 0;
+    Token *tokens = minissd_tokenize(source_code, strlen(source_code), &count);
+
+    const TokenKind kinds[] = {
+        MINISSD_TOKEN_HASH, MINISSD_TOKEN_LBRACKET, MINISSD_TOKEN_IDENTIFIER, MINISSD_TOKEN_LPAREN,
+        MINISSD_TOKEN_IDENTIFIER, MINISSD_TOKEN_EQUALS, MINISSD_TOKEN_STRING, MINISSD_TOKEN_RPAREN,
+        MINISSD_TOKEN_RBRACKET, MINISSD_TOKEN_IDENTIFIER, MINISSD_TOKEN_IDENTIFIER, MINISSD_TOKEN_LBRACE,
+        MINISSD_TOKEN_IDENTIFIER, MINISSD_TOKEN_COLON, MINISSD_TOKEN_IDENTIFIER, MINISSD_TOKEN_IDENTIFIER,
+        MINISSD_TOKEN_IDENTIFIER, MINISSD_TOKEN_COLON, MINISSD_TOKEN_COLON, MINISSD_TOKEN_IDENTIFIER,
+        MINISSD_TOKEN_COMMA, MINISSD_TOKEN_RBRACE, MINISSD_TOKEN_IDENTIFIER, MINISSD_TOKEN_IDENTIFIER,
+        MINISSD_TOKEN_LPAREN, MINISSD_TOKEN_RPAREN, MINISSD_TOKEN_ARROW, MINISSD_TOKEN_INTEGER,
+        MINISSD_TOKEN_IDENTIFIER, MINISSD_TOKEN_IDENTIFIER, MINISSD_TOKEN_SEMICOLON, MINISSD_TOKEN_UNKNOWN,
+        MINISSD_TOKEN_EOF,
+    };
+    ASSERT_EQ(count, sizeof(kinds) / sizeof(kinds[0]));
+    for (size_t i = 0; i < count; i++)
+    {
+        ASSERT_EQ(tokens[i].kind, kinds[i]) << "token " << i;
+    }
+
+    ASSERT_EQ(tokens[6].offset, 6u);
+    ASSERT_EQ(tokens[6].length, 3u);
+    ASSERT_EQ(tokens[9].keyword, MINISSD_KEYWORD_DATA);
+    ASSERT_EQ(tokens[10].keyword, MINISSD_KEYWORD_NONE);
+    ASSERT_EQ(tokens[14].keyword, MINISSD_KEYWORD_LIST);
+    ASSERT_EQ(tokens[15].keyword, MINISSD_KEYWORD_OF);
+    ASSERT_EQ(tokens[22].keyword, MINISSD_KEYWORD_FN);
+    ASSERT_EQ(std::string(source_code + tokens[27].offset, tokens[27].length), "32");
+    ASSERT_EQ(tokens[count - 1].offset, strlen(source_code));
+
+    minissd_free_tokens(tokens);
+}
+
+TEST(Lexer, KeywordsNeedWholeIdentifiers)
+{
+    const char *source_code = "listing of_ _data event2 depends";
+    Lexer lexer;
+    minissd_init_lexer(&lexer, source_code, strlen(source_code));
+
+    const Keyword keywords[] = {
+        MINISSD_KEYWORD_NONE, MINISSD_KEYWORD_NONE, MINISSD_KEYWORD_NONE,
+        MINISSD_KEYWORD_NONE, MINISSD_KEYWORD_DEPENDS,
+    };
+    for (Keyword keyword : keywords)
+    {
+        Token token = minissd_next_token(&lexer);
+        ASSERT_EQ(token.kind, MINISSD_TOKEN_IDENTIFIER);
+        ASSERT_EQ(token.keyword, keyword);
+    }
+    ASSERT_EQ(minissd_next_token(&lexer).kind, MINISSD_TOKEN_EOF);
+    ASSERT_EQ(minissd_next_token(&lexer).kind, MINISSD_TOKEN_EOF);
+}
+
+TEST(Lexer, UnterminatedStringAndNul)
+{
+    const char source_code[] = "a \"open\0 b";
+    size_t count = 0;
+    Token *tokens = minissd_tokenize(source_code, sizeof(source_code) - 1, &count);
+
+    ASSERT_EQ(count, 3u);
+    ASSERT_EQ(tokens[1].kind, MINISSD_TOKEN_UNTERMINATED_STRING);
+    ASSERT_EQ(tokens[1].length, 5u);
+    ASSERT_EQ(tokens[2].kind, MINISSD_TOKEN_EOF);
+    ASSERT_EQ(tokens[2].offset, 7u);
+
+    minissd_free_tokens(tokens);
+}
+
+TEST_F(ParserTest, OnlyCommentsInput)
+{
+    const char *source_code = "  // nothing here\n";
+
+    parser = minissd_create_parser(source_code);
+    ast = minissd_parse(parser);
+
+    ASSERT_EQ(ast, nullptr);
+    ASSERT_EQ(minissd_get_error(parser)->code, MINISSD_ERROR_EMPTY_INPUT);
+}
+
+static std::vector<Token> lex_with(const std::string &source, ScanKernels kernels)
+{
+    Lexer lexer;
+    minissd_init_lexer(&lexer, source.data(), source.size());
+    lexer.kernels = kernels;
+    std::vector<Token> tokens;
+    do
+    {
+        tokens.push_back(minissd_next_token(&lexer));
+    } while (tokens.back().kind != MINISSD_TOKEN_EOF);
+    return tokens;
+}
+
+TEST(Lexer, ScanKernelsAgree)
+{
+    std::string source;
+    for (int run = 1; run < 80; run += 7)
+    {
+        source += std::string(run, ' ') + "\t\r\n\v\f";
+        source += std::string(run, 'a') + "Z_9" + std::string(run % 5, '1') + "\xC3\xA9:";
+        source += "// " + std::string(run, 'c') + "\"\xFF\n";
+        source += "\"" + std::string(run, 's') + "// [x]\",";
+        source += std::string(run, '7') + "@{";
+    }
+    source += "\"unterminated " + std::string(40, 'u');
+
+    std::vector<Token> expected = lex_with(source, MINISSD_SCAN_SCALAR);
+    // Every kernel has to handle tails that straddle its block size
+    for (int kernels = MINISSD_SCAN_SCALAR; kernels <= minissd_detect_scan_kernels(); kernels++)
+    {
+        for (size_t cut = source.size() - 70; cut <= source.size(); cut++)
+        {
+            std::string prefix = source.substr(0, cut);
+            std::vector<Token> scalar = lex_with(prefix, MINISSD_SCAN_SCALAR);
+            std::vector<Token> vector = lex_with(prefix, (ScanKernels)kernels);
+            ASSERT_EQ(scalar.size(), vector.size()) << "kernels " << kernels << ", cut " << cut;
+            for (size_t i = 0; i < scalar.size(); i++)
+            {
+                ASSERT_EQ(scalar[i].offset, vector[i].offset) << "kernels " << kernels << ", cut " << cut;
+                ASSERT_EQ(scalar[i].length, vector[i].length);
+                ASSERT_EQ(scalar[i].kind, vector[i].kind);
+            }
+        }
+        std::vector<Token> tokens = lex_with(source, (ScanKernels)kernels);
+        ASSERT_EQ(tokens.size(), expected.size());
+        for (size_t i = 0; i < tokens.size(); i++)
+        {
+            ASSERT_EQ(tokens[i].offset, expected[i].offset) << "kernels " << kernels;
+            ASSERT_EQ(tokens[i].length, expected[i].length);
+            ASSERT_EQ(tokens[i].kind, expected[i].kind);
+            ASSERT_EQ(tokens[i].keyword, expected[i].keyword);
+        }
+    }
+    ASSERT_EQ(expected[0].kind, MINISSD_TOKEN_IDENTIFIER);
+    ASSERT_EQ(expected[0].length, 5u);
+    ASSERT_EQ(expected[1].kind, MINISSD_TOKEN_UNKNOWN);
+    ASSERT_EQ(expected.back().offset, source.size());
+}
+
+TEST_F(ParserTest, LongTokens)
+{
+    std::string sql = "SELECT " + std::string(5000, 'x') + " FROM t";
+    std::string name = "Record" + std::string(3000, 'r');
+    std::string path = "a";
+    for (int i = 0; i < 500; i++)
+    {
+        path += "::segment" + std::to_string(i);
+    }
+    std::string source_code = "#[query(sql=\"" + sql + "\")] data " + name + " { f: " + path + " };";
+
+    parser = minissd_create_parser(source_code.c_str());
+    ast = minissd_parse(parser);
+
+    ASSERT_NE(ast, nullptr);
+    AttributeParameter const *param = minissd_get_attribute_parameters(minissd_get_attributes(ast));
+    ASSERT_EQ(std::string(minissd_get_attribute_parameter_value(param)), sql);
+    ASSERT_EQ(minissd_get_attribute_parameter_value_length(param), sql.size());
+    ASSERT_EQ(std::string(minissd_get_data_name(ast)), name);
+    Type const *type = minissd_get_property_type(minissd_get_properties(ast));
+    ASSERT_EQ(std::string(minissd_get_type_name(type)), path);
+}
+
+TEST_F(ParserTest, InvalidInput_IntegerOverflow)
+{
+    const char *source_code = "enum E { A = 2147483647, B = 2147483648 };";
+
+    parser = minissd_create_parser(source_code);
+    ast = minissd_parse(parser);
+
+    ASSERT_EQ(ast, nullptr);
+    ASSERT_EQ(minissd_get_error(parser)->code, MINISSD_ERROR_INTEGER_TOO_LONG);
+    ASSERT_STREQ(parser->error, "Error: Integer does not fit into an int at line 1, column 31");
+}
+
+TEST_F(ParserTest, FlatAst_Service)
+{
+    const char *source_code = "import a::b; #[a(b=\"c\", d)] service S { depends on x::y; fn f(#[k] a: int, b: 3 of byte) -> list of string; fn g(); event e(c: T); };";
+
+    parser = minissd_create_parser(source_code);
+    ast = minissd_parse(parser);
+    ASSERT_NE(ast, nullptr);
+
+    FlatAst *flat = minissd_flatten_ast(ast);
+    ASSERT_NE(flat, nullptr);
+    ASSERT_EQ(flat->node_count, 2u);
+    ASSERT_EQ(flat->nodes[0].type, (uint32_t)NODE_IMPORT);
+    ASSERT_STREQ(minissd_flat_string(flat, flat->nodes[0].name), "a::b");
+
+    FlatNode const *service = &flat->nodes[1];
+    ASSERT_EQ(service->type, (uint32_t)NODE_SERVICE);
+    ASSERT_STREQ(minissd_flat_string(flat, service->name), "S");
+
+    uint32_t count;
+    FlatAttribute const *attr = minissd_flat_get_attributes(flat, service->attributes, &count);
+    ASSERT_EQ(count, 1u);
+    ASSERT_STREQ(minissd_flat_string(flat, attr->name), "a");
+    FlatAttributeParameter const *params = minissd_flat_get_parameters(flat, attr, &count);
+    ASSERT_EQ(count, 2u);
+    ASSERT_STREQ(minissd_flat_string(flat, params[0].key), "b");
+    ASSERT_STREQ(minissd_flat_string(flat, params[0].value), "c");
+    ASSERT_STREQ(minissd_flat_string(flat, params[1].key), "d");
+    ASSERT_EQ(minissd_flat_string(flat, params[1].value), nullptr);
+
+    FlatDependency const *dep = minissd_flat_get_dependencies(flat, service, &count);
+    ASSERT_EQ(count, 1u);
+    ASSERT_STREQ(minissd_flat_string(flat, dep->path), "x::y");
+
+    FlatHandler const *handlers = minissd_flat_get_handlers(flat, service, &count);
+    ASSERT_EQ(count, 2u);
+    ASSERT_STREQ(minissd_flat_string(flat, handlers[0].name), "f");
+    ASSERT_TRUE(handlers[0].has_return_type);
+    ASSERT_TRUE(handlers[0].return_type.is_list);
+    ASSERT_STREQ(minissd_flat_string(flat, handlers[0].return_type.name), "string");
+    ASSERT_STREQ(minissd_flat_string(flat, handlers[1].name), "g");
+    ASSERT_FALSE(handlers[1].has_return_type);
+
+    FlatArgument const *args = minissd_flat_get_arguments(flat, handlers[0].arguments, &count);
+    ASSERT_EQ(count, 2u);
+    ASSERT_STREQ(minissd_flat_string(flat, args[0].name), "a");
+    minissd_flat_get_attributes(flat, args[0].attributes, &count);
+    ASSERT_EQ(count, 1u);
+    ASSERT_TRUE(args[1].type.has_count);
+    ASSERT_EQ(args[1].type.count, 3);
+    minissd_flat_get_arguments(flat, handlers[1].arguments, &count);
+    ASSERT_EQ(count, 0u);
+
+    FlatEvent const *event = minissd_flat_get_events(flat, service, &count);
+    ASSERT_EQ(count, 1u);
+    args = minissd_flat_get_arguments(flat, event->arguments, &count);
+    ASSERT_EQ(count, 1u);
+    ASSERT_STREQ(minissd_flat_string(flat, args[0].type.name), "T");
+    ASSERT_EQ(flat->argument_count, 3u);
+
+    minissd_flat_get_properties(flat, service, &count);
+    ASSERT_EQ(count, 0u);
+
+    minissd_free_flat_ast(flat);
+}
+
+TEST_F(ParserTest, FlatAst_OutlivesZeroCopyParse)
+{
+    std::string source_code = "data A { x: int, y: list of A }; enum E { P = 4, Q }; data B { z: E };";
+
+    parser = minissd_create_parser(source_code.c_str());
+    minissd_set_parser_flags(parser, MINISSD_PARSE_ZERO_COPY | MINISSD_PARSE_ARENA);
+    ast = minissd_parse(parser);
+    ASSERT_NE(ast, nullptr);
+    FlatAst *flat = minissd_flatten_ast(ast);
+    ASSERT_NE(flat, nullptr);
+    minissd_free_ast(ast);
+    minissd_free_parser(parser);
+    ast = nullptr;
+    parser = nullptr;
+    source_code.assign(source_code.size(), '?');
+
+    // Properties of all data nodes form one array in document order
+    ASSERT_EQ(flat->property_count, 3u);
+    ASSERT_STREQ(minissd_flat_string(flat, flat->properties[0].name), "x");
+    ASSERT_STREQ(minissd_flat_string(flat, flat->properties[1].name), "y");
+    ASSERT_STREQ(minissd_flat_string(flat, flat->properties[2].name), "z");
+    ASSERT_EQ(flat->properties[1].name.length, 1u);
+    // Equal strings share one entry of the pool
+    ASSERT_EQ(flat->properties[1].type.name.offset, flat->nodes[0].name.offset);
+
+    uint32_t count;
+    FlatProperty const *props = minissd_flat_get_properties(flat, &flat->nodes[2], &count);
+    ASSERT_EQ(count, 1u);
+    ASSERT_EQ(props, &flat->properties[2]);
+
+    FlatEnumVariant const *variants = minissd_flat_get_variants(flat, &flat->nodes[1], &count);
+    ASSERT_EQ(count, 2u);
+    ASSERT_TRUE(variants[0].has_value);
+    ASSERT_EQ(variants[0].value, 4);
+    ASSERT_FALSE(variants[1].has_value);
+
+    minissd_free_flat_ast(flat);
+}
+
+TEST(FlatAst, Empty)
+{
+    FlatAst *flat = minissd_flatten_ast(nullptr);
+    ASSERT_NE(flat, nullptr);
+    ASSERT_EQ(flat->node_count, 0u);
+    ASSERT_EQ(flat->string_size, 0u);
+    minissd_free_flat_ast(flat);
+}
+
+TEST_F(ParserTest, SerializedAst_RoundTrip)
+{
+    const char *source_code = "#[a(b=\"c\")] data A { x: int, y: 4 of A }; enum E { P = 4, Q }; service S { fn f(a: A) -> E; };";
+
+    parser = minissd_create_parser(source_code);
+    ast = minissd_parse(parser);
+    ASSERT_NE(ast, nullptr);
+
+    size_t length = 0;
+    void *data = minissd_serialize_ast(ast, &length);
+    ASSERT_NE(data, nullptr);
+    ASSERT_EQ(memcmp(data, "MSSD", 4), 0);
+
+    FlatAst *flat = minissd_load_ast(data, length, MINISSD_LOAD_VERIFY);
+    ASSERT_NE(flat, nullptr);
+    ASSERT_EQ(flat->node_count, 3u);
+    ASSERT_EQ(flat->property_count, 2u);
+    // Loading points into the data instead of copying it
+    ASSERT_GT((char *)flat->nodes, (char *)data);
+    ASSERT_LT((char *)flat->strings, (char *)data + length);
+    ASSERT_STREQ(minissd_flat_string(flat, flat->nodes[0].name), "A");
+    ASSERT_EQ(flat->properties[1].type.count, 4);
+    ASSERT_EQ(flat->variants[0].value, 4);
+    ASSERT_STREQ(minissd_flat_string(flat, flat->handlers[0].return_type.name), "E");
+
+    uint32_t count;
+    FlatAttribute const *attr = minissd_flat_get_attributes(flat, flat->nodes[0].attributes, &count);
+    ASSERT_EQ(count, 1u);
+    ASSERT_STREQ(minissd_flat_string(flat, minissd_flat_get_parameters(flat, attr, &count)->value), "c");
+
+    // Serializing the loaded AST reproduces the same bytes
+    size_t again_length = 0;
+    void *again = minissd_serialize_flat_ast(flat, &again_length);
+    ASSERT_EQ(again_length, length);
+    ASSERT_EQ(memcmp(again, data, length), 0);
+
+    minissd_free_serialized_ast(again);
+    minissd_free_flat_ast(flat);
+    minissd_free_serialized_ast(data);
+}
+
+TEST(FlatAst, ImpliedEnumValues)
+{
+    Parser *parser = minissd_create_parser("enum E { A, B = 5, C };");
+    AstNode *ast = minissd_parse(parser);
+    ASSERT_NE(ast, nullptr);
+    FlatAst *flat = minissd_flatten_ast(ast);
+    size_t length = 0;
+    void *data = minissd_serialize_ast(ast, &length);
+    FlatAst *loaded = minissd_load_ast(data, length, MINISSD_LOAD_VERIFY);
+    ASSERT_NE(loaded, nullptr);
+    for (FlatAst const *f : { (FlatAst const *)flat, (FlatAst const *)loaded })
+    {
+        ASSERT_EQ(f->variant_count, 3u);
+        ASSERT_EQ(f->variants[0].value, 0);
+        ASSERT_EQ(f->variants[1].value, 5);
+        ASSERT_EQ(f->variants[2].value, 6);
+        ASSERT_FALSE(f->variants[0].has_value);
+        ASSERT_TRUE(f->variants[1].has_value);
+        ASSERT_FALSE(f->variants[2].has_value);
+    }
+    minissd_free_flat_ast(loaded);
+    minissd_free_serialized_ast(data);
+    minissd_free_flat_ast(flat);
+    minissd_free_ast(ast);
+    minissd_free_parser(parser);
+}
+
+TEST_F(ParserTest, SerializedAst_Corruption)
+{
+    parser = minissd_create_parser("data A { x: int }; data B { y: A };");
+    ast = minissd_parse(parser);
+    ASSERT_NE(ast, nullptr);
+
+    size_t length = 0;
+    unsigned char *data = (unsigned char *)minissd_serialize_ast(ast, &length);
+    ASSERT_NE(data, nullptr);
+
+    ASSERT_EQ(minissd_load_ast(data, length - 1, MINISSD_LOAD_DEFAULT), nullptr);
+
+    // Header damage is always caught by the header checksum
+    data[16] ^= 1;
+    ASSERT_EQ(minissd_load_ast(data, length, MINISSD_LOAD_DEFAULT), nullptr);
+    data[16] ^= 1;
+    data[4] = MINISSD_AST_FORMAT_VERSION + 1;
+    ASSERT_EQ(minissd_load_ast(data, length, MINISSD_LOAD_DEFAULT), nullptr);
+    data[4] = MINISSD_AST_FORMAT_VERSION;
+
+    // Payload damage needs verification
+    data[length - 2] ^= 0x20;
+    FlatAst *flat = minissd_load_ast(data, length, MINISSD_LOAD_DEFAULT);
+    ASSERT_NE(flat, nullptr);
+    minissd_free_flat_ast(flat);
+    ASSERT_EQ(minissd_load_ast(data, length, MINISSD_LOAD_VERIFY), nullptr);
+    data[length - 2] ^= 0x20;
+
+    flat = minissd_load_ast(data, length, MINISSD_LOAD_VERIFY);
+    ASSERT_NE(flat, nullptr);
+    minissd_free_flat_ast(flat);
+
+    std::vector<uint64_t> shifted((length + 16) / 8);
+    memcpy((char *)shifted.data() + 1, data, length);
+    ASSERT_EQ(minissd_load_ast((char *)shifted.data() + 1, length, MINISSD_LOAD_DEFAULT), nullptr);
+
+    minissd_free_serialized_ast(data);
+}
+
+#ifndef _WIN32
+TEST_F(ParserTest, SerializedAst_File)
+{
+    parser = minissd_create_parser("import a::b; enum E { A, B };");
+    ast = minissd_parse(parser);
+    ASSERT_NE(ast, nullptr);
+
+    size_t length = 0;
+    void *data = minissd_serialize_ast(ast, &length);
+    std::string path = write_temp_file(std::string((char *)data, length));
+    minissd_free_serialized_ast(data);
+
+    FlatAst *flat = minissd_load_ast_file(path.c_str(), MINISSD_LOAD_VERIFY);
+    unlink(path.c_str());
+    ASSERT_NE(flat, nullptr);
+    ASSERT_NE(flat->mapping, nullptr);
+    ASSERT_STREQ(minissd_flat_string(flat, flat->nodes[0].name), "a::b");
+    ASSERT_EQ(flat->variant_count, 2u);
+    minissd_free_flat_ast(flat);
+
+    ASSERT_EQ(minissd_load_ast_file("/nonexistent/schema.ssdb", MINISSD_LOAD_DEFAULT), nullptr);
+}
+#endif
+
+#ifndef _WIN32
+static std::vector<std::string> list_directory(const std::string &directory)
+{
+    std::vector<std::string> names;
+    DIR *dir = opendir(directory.c_str());
+    while (struct dirent *d = dir ? readdir(dir) : nullptr)
+    {
+        if (d->d_name[0] != '.')
+        {
+            names.push_back(directory + "/" + d->d_name);
+        }
+    }
+    if (dir)
+    {
+        closedir(dir);
+    }
+    return names;
+}
+
+static void remove_directory(const std::string &directory)
+{
+    for (const std::string &path : list_directory(directory))
+    {
+        unlink(path.c_str());
+    }
+    rmdir(directory.c_str());
+}
+
+static FlatAst *cache_parse(ParseCache *cache, const char *source)
+{
+    Parser *parser = minissd_create_parser(source);
+    FlatAst *flat = minissd_cache_parse(cache, parser);
+    minissd_free_parser(parser);
+    return flat;
+}
+
+TEST(ParseCache, HitAfterMiss)
+{
+    char directory[] = "/tmp/minissd_cache_XXXXXX";
+    ASSERT_NE(mkdtemp(directory), nullptr);
+    std::string root = std::string(directory) + "/cache";
+    ParseCache *cache = minissd_open_parse_cache(root.c_str(), 1 << 20, MINISSD_LOAD_VERIFY);
+    ASSERT_NE(cache, nullptr);
+
+    const char *source_code = "data A { x: int, y: list of string };";
+    FlatAst *flat = cache_parse(cache, source_code);
+    ASSERT_NE(flat, nullptr);
+    ASSERT_EQ(flat->mapping, nullptr);
+    minissd_free_flat_ast(flat);
+    ASSERT_EQ(list_directory(root).size(), 1u);
+
+    flat = cache_parse(cache, source_code);
+    ASSERT_NE(flat, nullptr);
+    ASSERT_NE(flat->mapping, nullptr);
+    ASSERT_STREQ(minissd_flat_string(flat, flat->properties[1].type.name), "string");
+    minissd_free_flat_ast(flat);
+
+    ParseCacheStats stats = minissd_parse_cache_stats(cache);
+    ASSERT_EQ(stats.hits, 1u);
+    ASSERT_EQ(stats.misses, 1u);
+    ASSERT_EQ(stats.stores, 1u);
+    ASSERT_DOUBLE_EQ(stats.hit_rate, 0.5);
+    ASSERT_GT(stats.bytes, 0u);
+    minissd_close_parse_cache(cache);
+
+    // A reopened cache sees the entry, a damaged one is parsed and replaced
+    cache = minissd_open_parse_cache(root.c_str(), 1 << 20, MINISSD_LOAD_VERIFY);
+    ASSERT_EQ(minissd_parse_cache_stats(cache).bytes, stats.bytes);
+    std::string entry = list_directory(root)[0];
+    FILE *f = fopen(entry.c_str(), "r+b");
+    fseek(f, -1, SEEK_END);
+    fputc('!', f);
+    fclose(f);
+    flat = cache_parse(cache, source_code);
+    ASSERT_NE(flat, nullptr);
+    ASSERT_EQ(flat->mapping, nullptr);
+    minissd_free_flat_ast(flat);
+    flat = cache_parse(cache, source_code);
+    ASSERT_NE(flat, nullptr);
+    ASSERT_NE(flat->mapping, nullptr);
+    minissd_free_flat_ast(flat);
+
+    minissd_close_parse_cache(cache);
+    remove_directory(root);
+    rmdir(directory);
+}
+
+TEST(ParseCache, ErrorsAreNotCached)
+{
+    char directory[] = "/tmp/minissd_cache_XXXXXX";
+    ASSERT_NE(mkdtemp(directory), nullptr);
+    ParseCache *cache = minissd_open_parse_cache(directory, 1 << 20, MINISSD_LOAD_DEFAULT);
+    ASSERT_NE(cache, nullptr);
+
+    for (int i = 0; i < 2; i++)
+    {
+        Parser *parser = minissd_create_parser("data A { x int };");
+        ASSERT_EQ(minissd_cache_parse(cache, parser), nullptr);
+        ASSERT_STREQ(parser->error, "Error: Expected ':' after property name at line 1, column 13");
+        minissd_free_parser(parser);
+    }
+    ASSERT_EQ(minissd_parse_cache_stats(cache).misses, 2u);
+    ASSERT_TRUE(list_directory(directory).empty());
+
+    minissd_close_parse_cache(cache);
+    remove_directory(directory);
+}
+
+TEST(ParseCache, EvictsLeastRecentlyUsed)
+{
+    char directory[] = "/tmp/minissd_cache_XXXXXX";
+    ASSERT_NE(mkdtemp(directory), nullptr);
+    ParseCache *cache = minissd_open_parse_cache(directory, 1 << 20, MINISSD_LOAD_DEFAULT);
+    minissd_free_flat_ast(cache_parse(cache, "data A1 { x: int };"));
+    size_t entry_size = minissd_parse_cache_stats(cache).bytes;
+    minissd_free_flat_ast(cache_parse(cache, "data B1 { x: int };"));
+    minissd_close_parse_cache(cache);
+
+    // Age both entries, then use A1 again so B1 becomes the oldest
+    for (const std::string &path : list_directory(directory))
+    {
+        struct timespec times[2] = { { 1000, 0 }, { 1000, 0 } };
+        ASSERT_EQ(utimensat(AT_FDCWD, path.c_str(), times, 0), 0);
+    }
+    cache = minissd_open_parse_cache(directory, entry_size * 2 + entry_size / 2, MINISSD_LOAD_DEFAULT);
+    minissd_free_flat_ast(cache_parse(cache, "data A1 { x: int };"));
+    minissd_free_flat_ast(cache_parse(cache, "data C1 { x: int };"));
+
+    ParseCacheStats stats = minissd_parse_cache_stats(cache);
+    ASSERT_EQ(stats.evictions, 1u);
+    ASSERT_EQ(stats.bytes, entry_size * 2);
+    ASSERT_EQ(list_directory(directory).size(), 2u);
+
+    minissd_free_flat_ast(cache_parse(cache, "data A1 { x: int };"));
+    minissd_free_flat_ast(cache_parse(cache, "data C1 { x: int };"));
+    ASSERT_EQ(minissd_parse_cache_stats(cache).hits, stats.hits + 2);
+    minissd_free_flat_ast(cache_parse(cache, "data B1 { x: int };"));
+    ASSERT_EQ(minissd_parse_cache_stats(cache).misses, stats.misses + 1);
+
+    minissd_close_parse_cache(cache);
+    remove_directory(directory);
+}
+#endif
+
+#ifndef _WIN32
+TEST(ParseFiles, ResultsInInputOrder)
+{
+    std::vector<std::string> paths;
+    for (int i = 0; i < 40; i++)
+    {
+        std::string source;
+        for (int j = 0; j <= i % 7 * 50; j++)
+        {
+            source += "data D" + std::to_string(i) + "_" + std::to_string(j) + " { x: int };\n";
+        }
+        paths.push_back(write_temp_file(source));
+    }
+    unlink(paths[5].c_str());
+    unlink(paths[9].c_str());
+    paths[5] = write_temp_file("data Broken {\n  x int\n};");
+    paths[9] = "/nonexistent/schema.ssd";
+
+    std::vector<const char *> c_paths;
+    for (const std::string &path : paths)
+    {
+        c_paths.push_back(path.c_str());
+    }
+
+    for (unsigned threads : { 1u, 3u, 0u })
+    {
+        std::vector<ParseResult> results(paths.size());
+        ASSERT_EQ(minissd_parse_files(c_paths.data(), c_paths.size(), threads, MINISSD_PARSE_ARENA, results.data()), 2u);
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            if (i == 5)
+            {
+                ASSERT_EQ(results[i].ast, nullptr);
+                ASSERT_STREQ(results[i].parser->error, "Error: Expected ':' after property name at line 2, column 6");
+            }
+            else if (i == 9)
+            {
+                ASSERT_EQ(results[i].parser, nullptr);
+                ASSERT_EQ(results[i].ast, nullptr);
+            }
+            else
+            {
+                ASSERT_NE(results[i].ast, nullptr);
+                std::string name = "D" + std::to_string(i) + "_0";
+                ASSERT_STREQ(minissd_get_data_name(results[i].ast), name.c_str());
+            }
+        }
+        minissd_free_parse_results(results.data(), results.size());
+        ASSERT_EQ(results[0].parser, nullptr);
+    }
+
+    for (const std::string &path : paths)
+    {
+        unlink(path.c_str());
+    }
+}
+
+// Module files under a temporary directory, removed again on destruction
+struct ModuleTree
+{
+    std::string root;
+    std::vector<std::string> created;
+
+    ModuleTree()
+    {
+        char directory[] = "/tmp/minissd_modules_XXXXXX";
+        EXPECT_NE(mkdtemp(directory), nullptr);
+        root = directory;
+    }
+
+    ~ModuleTree()
+    {
+        for (auto it = created.rbegin(); it != created.rend(); ++it)
+        {
+            remove(it->c_str());
+        }
+        rmdir(root.c_str());
+    }
+
+    std::string add(const std::string &relative, const std::string &contents)
+    {
+        for (size_t slash = relative.find('/'); slash != std::string::npos; slash = relative.find('/', slash + 1))
+        {
+            std::string directory = root + "/" + relative.substr(0, slash);
+            if (mkdir(directory.c_str(), 0700) == 0)
+            {
+                created.push_back(directory);
+            }
+        }
+        std::string path = root + "/" + relative;
+        FILE *f = fopen(path.c_str(), "wb");
+        EXPECT_NE(f, nullptr);
+        fwrite(contents.data(), 1, contents.size(), f);
+        fclose(f);
+        created.push_back(path);
+        return path;
+    }
+};
+
+static std::vector<std::string> module_names(const ModuleGraph *graph)
+{
+    std::vector<std::string> names;
+    for (size_t i = 0; i < graph->module_count; i++)
+    {
+        names.push_back(graph->modules[i].name);
+    }
+    return names;
+}
+
+TEST(Modules, ResolvesEachFileOnce)
+{
+    ModuleTree tree;
+    std::string main = tree.add("main.ssd", "import shapes::Circle;\nimport util;\ndata Scene { c: shapes::Circle };");
+    tree.add("shapes.ssd", "import util::Color;\ndata Circle { color: util::Color };");
+    tree.add("util.ssd", "enum Color { Red, Green };\ndata Unused { x: int };");
+    tree.add("util/Color.ssd", "data Wrong { x: int };");
+
+    for (unsigned threads : { 1u, 4u, 0u })
+    {
+        ModuleGraph *graph = minissd_load_modules(main.c_str(), nullptr, 0, threads, MINISSD_PARSE_ARENA);
+        ASSERT_NE(graph, nullptr);
+        ASSERT_EQ(graph->status, MINISSD_MODULES_OK) << graph->error;
+
+        // util::Color is the module util/Color.ssd, preferred over util.ssd
+        ASSERT_EQ(module_names(graph), (std::vector<std::string>{ "", "shapes", "util", "util::Color" }));
+        ASSERT_EQ(graph->modules[0].path, main);
+        ASSERT_EQ(graph->modules[0].import_count, 2u);
+        ASSERT_EQ(graph->modules[0].imports[0], 1u);
+        ASSERT_EQ(graph->modules[0].imports[1], 2u);
+        ASSERT_EQ(graph->modules[1].import_count, 1u);
+        ASSERT_EQ(graph->modules[1].imports[0], 3u);
+
+        ASSERT_EQ(std::vector<size_t>(graph->order, graph->order + graph->module_count),
+                  (std::vector<size_t>{ 3, 1, 2, 0 }));
+        std::vector<std::string> nodes;
+        for (size_t i = 0; i < graph->node_count; i++)
+        {
+            AstNode const *node = graph->nodes[i];
+            nodes.push_back(node->type == NODE_DATA ? minissd_get_data_name(node) : minissd_get_enum_name(node));
+        }
+        ASSERT_EQ(nodes, (std::vector<std::string>{ "Wrong", "Circle", "Color", "Unused", "Scene" }));
+        minissd_free_module_graph(graph);
+    }
+}
+
+TEST(Modules, SearchRootsAndParents)
+{
+    ModuleTree tree;
+    std::string main = tree.add("app/main.ssd", "import a::b::Thing;\nimport a::b;\nimport c;");
+    tree.add("lib1/a/b.ssd", "data Thing { x: int };");
+    tree.add("lib2/a/b.ssd", "data Shadowed { x: int };");
+    tree.add("lib2/c.ssd", "data C { x: int };");
+
+    std::string lib1 = tree.root + "/lib1", lib2 = tree.root + "/../" + tree.root.substr(5) + "/lib2";
+    const char *roots[] = { lib1.c_str(), lib2.c_str() };
+    ModuleGraph *graph = minissd_load_modules(main.c_str(), roots, 2, 2, MINISSD_PARSE_DEFAULT);
+    ASSERT_NE(graph, nullptr);
+    ASSERT_EQ(graph->status, MINISSD_MODULES_OK) << graph->error;
+    // a::b::Thing and a::b both name lib1/a/b.ssd, which is loaded once
+    ASSERT_EQ(module_names(graph), (std::vector<std::string>{ "", "a::b", "c" }));
+    ASSERT_EQ(graph->modules[1].path, lib1 + "/a/b.ssd");
+    ASSERT_EQ(graph->modules[0].import_count, 2u);
+    ASSERT_EQ(graph->node_count, 2u);
+    minissd_free_module_graph(graph);
+
+    // The directory of the root file is the default search root
+    graph = minissd_load_modules(main.c_str(), nullptr, 0, 1, MINISSD_PARSE_DEFAULT);
+    ASSERT_NE(graph, nullptr);
+    ASSERT_EQ(graph->status, MINISSD_MODULES_UNRESOLVED);
+    ASSERT_EQ(std::string(graph->error), "Error: Cannot resolve import a::b::Thing in " + main);
+    minissd_free_module_graph(graph);
+}
+
+TEST(Modules, Errors)
+{
+    ModuleTree tree;
+    std::string main = tree.add("main.ssd", "import a;\ndata M { x: int };");
+    tree.add("a.ssd", "import b;\ndata A { x: int };");
+    std::string b = tree.add("b.ssd", "import main;\ndata B { x: int };");
+
+    for (unsigned threads : { 1u, 3u })
+    {
+        ModuleGraph *graph = minissd_load_modules(main.c_str(), nullptr, 0, threads, MINISSD_PARSE_DEFAULT);
+        ASSERT_NE(graph, nullptr);
+        ASSERT_EQ(graph->status, MINISSD_MODULES_CYCLE);
+        ASSERT_EQ(std::string(graph->error), "Error: Import cycle " + main + " -> a -> b -> " + main);
+        // The cycle leads back to the root file itself, not to a second copy
+        ASSERT_EQ(graph->module_count, 3u);
+        ASSERT_EQ(graph->node_count, 0u);
+        minissd_free_module_graph(graph);
+    }
+
+    tree.add("b.ssd", "data B {\n  x int\n};");
+    ModuleGraph *graph = minissd_load_modules(main.c_str(), nullptr, 0, 2, MINISSD_PARSE_DEFAULT);
+    ASSERT_NE(graph, nullptr);
+    ASSERT_EQ(graph->status, MINISSD_MODULES_PARSE_ERROR);
+    ASSERT_EQ(std::string(graph->error), b + ": Error: Expected ':' after property name at line 2, column 6");
+    minissd_free_module_graph(graph);
+
+    graph = minissd_load_modules((tree.root + "/missing.ssd").c_str(), nullptr, 0, 1, MINISSD_PARSE_DEFAULT);
+    ASSERT_NE(graph, nullptr);
+    ASSERT_EQ(graph->status, MINISSD_MODULES_UNREADABLE);
+    ASSERT_EQ(graph->module_count, 1u);
+    minissd_free_module_graph(graph);
+}
+#endif
+
+static std::string tricky_schema(int blocks)
+{
+    std::string source;
+    for (int i = 0; i < blocks; i++)
+    {
+        std::string n = std::to_string(i);
+        source += "// data Commented" + n + " { x: int }; {\n";
+        source += "#[doc(text=\"a ; b { c\")]\ndata D" + n + " {\n    #[k(v=\"}\")] x: list of int, // ; }\n    y: 4 of byte,\n};\n";
+        source += "enum E" + n + " { A = 1, B };\nservice S" + n + " { depends on a::b; fn f(x: int) -> D" + n + "; };\n";
+    }
+    return source;
+}
+
+static std::string serialize(AstNode const *ast)
+{
+    size_t length = 0;
+    void *data = minissd_serialize_ast(ast, &length);
+    std::string bytes((char *)data, length);
+    minissd_free_serialized_ast(data);
+    return bytes;
+}
+
+TEST(ParallelParse, MatchesSequential)
+{
+    std::string source_code = tricky_schema(3000);
+    ASSERT_GT(source_code.size(), 512u * 1024u);
+
+    for (unsigned flags : { 0u, (unsigned)(MINISSD_PARSE_ARENA | MINISSD_PARSE_ZERO_COPY) })
+    {
+        Parser *sequential = minissd_create_parser(source_code.c_str());
+        minissd_set_parser_flags(sequential, flags);
+        AstNode *expected = minissd_parse(sequential);
+        ASSERT_NE(expected, nullptr);
+
+        Parser *parallel = minissd_create_parser(source_code.c_str());
+        minissd_set_parser_flags(parallel, flags);
+        AstNode *ast = minissd_parse_parallel(parallel, 4);
+        ASSERT_NE(ast, nullptr);
+
+        ASSERT_EQ(serialize(ast), serialize(expected));
+        ASSERT_EQ(parallel->allocation_count, sequential->allocation_count);
+        ASSERT_EQ(parallel->owned_arena.allocation_count, sequential->owned_arena.allocation_count);
+
+        minissd_free_ast(ast);
+        minissd_free_parser(parallel);
+        minissd_free_ast(expected);
+        minissd_free_parser(sequential);
+    }
+}
+
+TEST(ParallelParse, ErrorsAreAbsolute)
+{
+    std::string source_code = tricky_schema(3000);
+    size_t at = source_code.rfind("y: 4 of byte");
+    source_code.replace(at, 2, "y 4");
+
+    Parser *sequential = minissd_create_parser(source_code.c_str());
+    ASSERT_EQ(minissd_parse(sequential), nullptr);
+    Parser *parallel = minissd_create_parser(source_code.c_str());
+    ASSERT_EQ(minissd_parse_parallel(parallel, 4), nullptr);
+
+    ASSERT_STREQ(parallel->error, sequential->error);
+    ASSERT_EQ(parallel->last_error.offset, sequential->last_error.offset);
+    ASSERT_EQ(parallel->line, 8 * 2999 + 5);
+
+    minissd_free_parser(parallel);
+    minissd_free_parser(sequential);
+}
+
+TEST(ParallelParse, InternAndSmallInputs)
+{
+    std::string source_code = tricky_schema(3000);
+    Parser *parser = minissd_create_parser(source_code.c_str());
+    minissd_set_parser_flags(parser, MINISSD_PARSE_INTERN);
+    AstNode *ast = minissd_parse_parallel(parser, 4);
+    ASSERT_NE(ast, nullptr);
+    ASSERT_GE(minissd_intern_lookup(parser, "D2999", 5), 0);
+    minissd_free_ast(ast);
+    minissd_free_parser(parser);
+
+    parser = minissd_create_parser("");
+    ASSERT_EQ(minissd_parse_parallel(parser, 4), nullptr);
+    ASSERT_EQ(minissd_get_error(parser)->code, MINISSD_ERROR_EMPTY_INPUT);
+    minissd_free_parser(parser);
+}
+
+TEST_F(ParserTest, NodeSpans)
+{
+    const std::string source_code = "import a::b;\n#[x(k=\"v\")]\ndata A { y: int }; // c\n  enum E { X };\n";
+
+    parser = minissd_create_parser(source_code.c_str());
+    ast = minissd_parse(parser);
+
+    ASSERT_NE(ast, nullptr);
+    std::vector<std::string> spans;
+    for (AstNode const *node = ast; node; node = minissd_get_next_node(node))
+    {
+        spans.push_back(source_code.substr(minissd_get_node_offset(node), minissd_get_node_length(node)));
+    }
+    ASSERT_EQ(spans, (std::vector<std::string>{ "import a::b;", "#[x(k=\"v\")]\ndata A { y: int };", "enum E { X };" }));
+}
+
+// Edits *text like an editor would and describes the edit
+static EditRange edit_text(std::string *text, size_t start, size_t removed, const std::string &inserted)
+{
+    text->replace(start, removed, inserted);
+    return EditRange{ start, start + removed, start + inserted.size() };
+}
+
+static std::vector<AstNode *> node_list(AstNode *ast)
+{
+    std::vector<AstNode *> nodes;
+    for (; ast; ast = ast->next)
+    {
+        nodes.push_back(ast);
+    }
+    return nodes;
+}
+
+// The reparsed AST has to be exactly what parsing text from scratch gives
+static void expect_full_parse(AstNode const *ast, const std::string &text, unsigned flags)
+{
+    Parser *full = minissd_create_parser(text.c_str());
+    minissd_set_parser_flags(full, flags);
+    AstNode *expected = minissd_parse(full);
+    ASSERT_NE(expected, nullptr);
+    ASSERT_EQ(serialize(ast), serialize(expected));
+    AstNode const *node = ast, *other = expected;
+    for (; node && other; node = node->next, other = other->next)
+    {
+        ASSERT_EQ(node->offset, other->offset);
+        ASSERT_EQ(node->length, other->length);
+    }
+    ASSERT_EQ(node, other);
+    minissd_free_ast(expected);
+    minissd_free_parser(full);
+}
+
+TEST(Reparse, ReusesNodesOutsideTheEdit)
+{
+    for (unsigned flags : { 0u, (unsigned)MINISSD_PARSE_ARENA, (unsigned)MINISSD_PARSE_INTERN })
+    {
+        // Every version of the input stays alive as long as the parser
+        std::deque<std::string> texts{ "import a::b;\ndata A { x: int };\nenum E { X, Y };\n"
+                                       "service S { fn f() -> A; };\ndata B { y: int };\n" };
+        Parser *parser = minissd_create_parser(texts.back().c_str());
+        minissd_set_parser_flags(parser, flags);
+        AstNode *ast = minissd_parse(parser);
+        ASSERT_NE(ast, nullptr);
+        std::vector<AstNode *> old_nodes = node_list(ast);
+
+        // Renaming a variant only parses the enum again
+        texts.push_back(texts.back());
+        EditRange edit = edit_text(&texts.back(), texts.back().find("X,"), 1, "Xyz");
+        ast = minissd_reparse(parser, ast, texts.back().c_str(), texts.back().size(), edit);
+        ASSERT_NE(ast, nullptr);
+        expect_full_parse(ast, texts.back(), flags);
+        std::vector<AstNode *> nodes = node_list(ast);
+        ASSERT_EQ(nodes.size(), 5u);
+        ASSERT_EQ(nodes[0], old_nodes[0]);
+        ASSERT_EQ(nodes[1], old_nodes[1]);
+        ASSERT_NE(nodes[2], old_nodes[2]);
+        ASSERT_EQ(nodes[3], old_nodes[3]);
+        ASSERT_EQ(nodes[4], old_nodes[4]);
+        ASSERT_STREQ(minissd_get_enum_variants(nodes[2])->name, "Xyz");
+
+        // Whitespace between declarations parses no node at all
+        old_nodes = nodes;
+        texts.push_back(texts.back());
+        edit = edit_text(&texts.back(), texts.back().find("service"), 0, "\n\n  ");
+        ast = minissd_reparse(parser, ast, texts.back().c_str(), texts.back().size(), edit);
+        ASSERT_NE(ast, nullptr);
+        expect_full_parse(ast, texts.back(), flags);
+        ASSERT_EQ(node_list(ast), old_nodes);
+
+        // Commenting out a declaration drops it
+        texts.push_back(texts.back());
+        edit = edit_text(&texts.back(), texts.back().find("service"), 0, "// ");
+        ast = minissd_reparse(parser, ast, texts.back().c_str(), texts.back().size(), edit);
+        ASSERT_NE(ast, nullptr);
+        expect_full_parse(ast, texts.back(), flags);
+        nodes = node_list(ast);
+        ASSERT_EQ(nodes, (std::vector<AstNode *>{ old_nodes[0], old_nodes[1], old_nodes[2], old_nodes[4] }));
+
+        // Errors leave the AST as it was, and the next edit is made against
+        // the last input that parsed
+        std::string before = serialize(ast);
+        std::string broken = texts.back();
+        edit = edit_text(&broken, broken.find("int }"), 3, "");
+        ASSERT_EQ(minissd_reparse(parser, ast, broken.c_str(), broken.size(), edit), nullptr);
+        ASSERT_STREQ(parser->error, "Error: Expected path at line 2, column 15");
+        ASSERT_EQ(serialize(ast), before);
+
+        texts.push_back(texts.back());
+        edit = edit_text(&texts.back(), 0, texts.back().find("data A"), "data Z { z: int };");
+        ast = minissd_reparse(parser, ast, texts.back().c_str(), texts.back().size(), edit);
+        ASSERT_NE(ast, nullptr);
+        expect_full_parse(ast, texts.back(), flags);
+        nodes = node_list(ast);
+        ASSERT_EQ(nodes.size(), 4u);
+        ASSERT_EQ(nodes[1], old_nodes[1]);
+        ASSERT_EQ(nodes[3], old_nodes[4]);
+
+        // Deleting everything is an error like for minissd_parse
+        std::string empty = "  ";
+        edit = EditRange{ 0, texts.back().size(), 2 };
+        ASSERT_EQ(minissd_reparse(parser, ast, empty.c_str(), empty.size(), edit), nullptr);
+        ASSERT_EQ(minissd_get_error(parser)->code, MINISSD_ERROR_EMPTY_INPUT);
+
+        minissd_free_ast(ast);
+        minissd_free_parser(parser);
+    }
+}
+
+TEST(Reparse, ZeroCopyParsesEverything)
+{
+    std::string first = "data A { x: int };\nenum E { X };\n";
+    std::string second = first;
+    EditRange edit = edit_text(&second, second.find("X }"), 1, "Y");
+
+    Parser *parser = minissd_create_parser(first.c_str());
+    minissd_set_parser_flags(parser, MINISSD_PARSE_ZERO_COPY);
+    AstNode *ast = minissd_parse(parser);
+    ASSERT_NE(ast, nullptr);
+    ast = minissd_reparse(parser, ast, second.c_str(), second.size(), edit);
+    ASSERT_NE(ast, nullptr);
+    ASSERT_EQ(minissd_get_data_name(ast), second.c_str() + 5);
+    expect_full_parse(ast, second, MINISSD_PARSE_ZERO_COPY);
+    minissd_free_ast(ast);
+    minissd_free_parser(parser);
+}
+
+TEST(Reparse, ArenaStaysBounded)
+{
+    std::deque<std::string> texts{ "data A { x: int };\nenum E { X };\ndata B { y: int };\n" };
+    Parser *parser = minissd_create_parser(texts.back().c_str());
+    minissd_set_parser_flags(parser, MINISSD_PARSE_ARENA);
+    AstNode *ast = minissd_parse(parser);
+    ASSERT_NE(ast, nullptr);
+
+    // Every edit replaces the enum, whose old node stays in the arena until
+    // the parser compacts it
+    size_t max_blocks = 0;
+    for (int i = 0; i < 20000; i++)
+    {
+        texts.push_back(texts.back());
+        size_t start = texts.back().find(" }", texts.back().find("enum")) - 1;
+        EditRange edit = edit_text(&texts.back(), start, 1, i % 2 ? "X" : "Y");
+        ast = minissd_reparse(parser, ast, texts.back().c_str(), texts.back().size(), edit);
+        ASSERT_NE(ast, nullptr);
+        max_blocks = std::max(max_blocks, parser->owned_arena.block_count);
+        texts.pop_front();
+    }
+    ASSERT_LE(max_blocks, 3u);
+    expect_full_parse(ast, texts.back(), MINISSD_PARSE_ARENA);
+    minissd_free_ast(ast);
+    minissd_free_parser(parser);
+}
+
+TEST(Reparse, RandomEditsMatchFullParse)
+{
+    static const char *const snippets[] = { "", "x", " ", ";", "}", "{", "//", "\n", ":", "\"", "#[a]", "data Q { z: int };" };
+    uint32_t seed = 12345;
+    auto next = [&seed](uint32_t bound) {
+        seed = seed * 1103515245u + 12345u;
+        return (seed >> 16) % bound;
+    };
+
+    for (unsigned flags : { 0u, (unsigned)MINISSD_PARSE_ARENA, (unsigned)MINISSD_PARSE_INTERN })
+    {
+        std::deque<std::string> texts{ tricky_schema(20) };
+        Parser *parser = minissd_create_parser(texts.back().c_str());
+        minissd_set_parser_flags(parser, flags);
+        AstNode *ast = minissd_parse(parser);
+        ASSERT_NE(ast, nullptr);
+
+        size_t failures = 0;
+        for (int i = 0; i < 400; i++)
+        {
+            std::string text = texts.back();
+            size_t start = next((uint32_t)text.size());
+            size_t removed = std::min<size_t>(next(4), text.size() - start);
+            EditRange edit = edit_text(&text, start, removed, snippets[next(sizeof(snippets) / sizeof(snippets[0]))]);
+
+            Parser *full = minissd_create_parser(text.c_str());
+            minissd_set_parser_flags(full, flags);
+            AstNode *expected = minissd_parse(full);
+
+            AstNode *reparsed = minissd_reparse(parser, ast, text.c_str(), text.size(), edit);
+            ASSERT_EQ(reparsed == nullptr, expected == nullptr) << text;
+            if (reparsed)
+            {
+                // Keeps the edit
+                texts.push_back(text);
+                ast = reparsed;
+                expect_full_parse(ast, texts.back(), flags);
+            }
+            else
+            {
+                ASSERT_STREQ(parser->error, full->error);
+                failures++;
+            }
+            minissd_free_ast(expected);
+            minissd_free_parser(full);
+        }
+        ASSERT_GT(failures, 0u);
+        ASSERT_GT(texts.size(), 100u);
+        minissd_free_ast(ast);
+        minissd_free_parser(parser);
+    }
+}
+
+static std::string view_string(StringView view)
+{
+    return view.data ? std::string(view.data, view.length) : "(none)";
+}
+
+static std::string type_string(Type const *type)
+{
+    if (!type)
+    {
+        return "(none)";
+    }
+    std::string name(type->name, type->name_length);
+    return type->has_count ? std::to_string(type->count) + " of " + name : type->is_list ? "list of " + name : name;
+}
+
+// Logs every event, stopping after stop_after of them if that is not 0
+struct EventLog
+{
+    std::vector<std::string> events;
+    size_t stop_after = 0;
+
+    bool add(const std::string &event)
+    {
+        events.push_back(event);
+        return events.size() != stop_after;
+    }
+
+    static ParseCallbacks callbacks()
+    {
+        ParseCallbacks c = {};
+        c.begin_node = [](void *log, NodeType type, StringView name) {
+            return ((EventLog *)log)->add("begin " + std::to_string(type) + " " + view_string(name));
+        };
+        c.end_node = [](void *log, NodeType type) { return ((EventLog *)log)->add("end " + std::to_string(type)); };
+        c.on_attribute = [](void *log, StringView name) { return ((EventLog *)log)->add("attribute " + view_string(name)); };
+        c.on_attribute_param = [](void *log, StringView key, StringView value) {
+            return ((EventLog *)log)->add("param " + view_string(key) + "=" + view_string(value));
+        };
+        c.on_property = [](void *log, StringView name, Type const *type) {
+            return ((EventLog *)log)->add("property " + view_string(name) + ": " + type_string(type));
+        };
+        c.on_enum_variant = [](void *log, StringView name, int const *value) {
+            return ((EventLog *)log)->add("variant " + view_string(name) + (value ? " = " + std::to_string(*value) : ""));
+        };
+        c.on_dependency = [](void *log, StringView path) { return ((EventLog *)log)->add("dependency " + view_string(path)); };
+        c.on_handler = [](void *log, StringView name, Type const *type) {
+            return ((EventLog *)log)->add("handler " + view_string(name) + " -> " + type_string(type));
+        };
+        c.on_argument = [](void *log, StringView name, Type const *type) {
+            return ((EventLog *)log)->add("argument " + view_string(name) + ": " + type_string(type));
+        };
+        c.on_event = [](void *log, StringView name) { return ((EventLog *)log)->add("event " + view_string(name)); };
+        return c;
+    }
+};
+
+TEST_F(ParserTest, ParseEvents)
+{
+    const char *source_code = "import a::b;\n"
+                              "#[table(name=\"t\", cached)]\n"
+                              "data D { #[column] id: int, tags: list of string, hash: 32 of byte };\n"
+                              "enum E { A = 1, #[deprecated] B };\n"
+                              "service S { fn get(#[v] id: int) -> D; #[lazy] depends on x::y; event changed(id: int); fn ping(); };";
+
+    ast = nullptr;
+    parser = minissd_create_parser(source_code);
+    minissd_set_parser_flags(parser, MINISSD_PARSE_INTERN);
+    EventLog log;
+    ParseCallbacks callbacks = EventLog::callbacks();
+    ASSERT_TRUE(minissd_parse_events(parser, &callbacks, &log));
+    ASSERT_EQ(log.events, (std::vector<std::string>{
+                              "begin 0 a::b",
+                              "end 0",
+                              "begin 1 D",
+                              "attribute table",
+                              "param name=t",
+                              "param cached=(none)",
+                              "property id: int",
+                              "attribute column",
+                              "property tags: list of string",
+                              "property hash: 32 of byte",
+                              "end 1",
+                              "begin 2 E",
+                              "variant A = 1",
+                              "variant B",
+                              "attribute deprecated",
+                              "end 2",
+                              "begin 3 S",
+                              "dependency x::y",
+                              "attribute lazy",
+                              "handler get -> D",
+                              "argument id: int",
+                              "attribute v",
+                              "handler ping -> (none)",
+                              "event changed",
+                              "argument id: int",
+                              "end 3",
+                          }));
+    // No AST was built on the heap, and the parser's flags are restored
+    ASSERT_EQ(parser->allocation_count, 0u);
+    ASSERT_EQ(parser->flags, (unsigned)MINISSD_PARSE_INTERN);
+    ASSERT_EQ(minissd_intern_count(parser), 0u);
+}
+
+TEST_F(ParserTest, ParseEvents_StopAndErrors)
+{
+    ast = nullptr;
+    std::string source_code = tricky_schema(100);
+    parser = minissd_create_parser(source_code.c_str());
+    EventLog log;
+    log.stop_after = 7;
+    ParseCallbacks callbacks = EventLog::callbacks();
+    ASSERT_TRUE(minissd_parse_events(parser, &callbacks, &log));
+    ASSERT_EQ(log.events.size(), 7u);
+    minissd_free_parser(parser);
+
+    // Only complete declarations are reported before the error
+    ParseCallbacks only_begin = {};
+    only_begin.begin_node = callbacks.begin_node;
+    log = EventLog();
+    parser = minissd_create_parser("enum E { A };\ndata D {\n  value int\n};");
+    ASSERT_FALSE(minissd_parse_events(parser, &only_begin, &log));
+    ASSERT_EQ(log.events, (std::vector<std::string>{ "begin 2 E" }));
+    ASSERT_STREQ(parser->error, "Error: Expected ':' after property name at line 3, column 10");
+    minissd_free_parser(parser);
+
+    parser = minissd_create_parser(" // nothing\n");
+    ASSERT_FALSE(minissd_parse_events(parser, &only_begin, &log));
+    ASSERT_EQ(minissd_get_error(parser)->code, MINISSD_ERROR_EMPTY_INPUT);
+}
+
+TEST(PushParser, NodesArriveWithTheirSemicolon)
+{
+    Parser *parser = minissd_create_push_parser();
+    const std::string first = "import a::b;\n#[x(k=\"; }\")] data A { x: int }";
+    ASSERT_TRUE(minissd_parser_feed(parser, first.data(), first.size()));
+    AstNode *import = minissd_parser_next_node(parser);
+    ASSERT_NE(import, nullptr);
+    ASSERT_EQ(minissd_parser_next_node(parser), nullptr);
+
+    // Suspends in the middle of the identifier
+    const std::string second = ";\n// data Commented { x: int };\nenum Col";
+    ASSERT_TRUE(minissd_parser_feed(parser, second.data(), second.size()));
+    AstNode *data = minissd_parser_next_node(parser);
+    ASSERT_NE(data, nullptr);
+    ASSERT_STREQ(minissd_get_data_name(data), "A");
+    ASSERT_EQ(data->next, nullptr);
+    ASSERT_EQ(minissd_get_node_offset(data), 13u);
+    ASSERT_EQ(minissd_parser_next_node(parser), nullptr);
+
+    const std::string third = "or { Red };";
+    ASSERT_TRUE(minissd_parser_feed(parser, third.data(), third.size()));
+    AstNode *color = minissd_parser_next_node(parser);
+    ASSERT_NE(color, nullptr);
+    ASSERT_STREQ(minissd_get_enum_name(color), "Color");
+    ASSERT_EQ(minissd_get_node_offset(color), first.size() + second.size() - 8);
+    ASSERT_TRUE(minissd_parser_finish(parser));
+    ASSERT_EQ(minissd_parser_next_node(parser), nullptr);
+
+    minissd_free_ast(import);
+    minissd_free_ast(data);
+    minissd_free_ast(color);
+    minissd_free_parser(parser);
+}
+
+TEST(PushParser, MatchesFullParse)
+{
+    std::vector<std::string> inputs{ tricky_schema(30),
+                                     "",
+                                     " // nothing\n",
+                                     "enum E { A };\ndata D {\n  value int\n};\nenum F { B };",
+                                     "enum E { A };\nservice S { fn f(); ",
+                                     "enum E { A }; } ; enum F { B };",
+                                     "enum E { A };\n#[doc(text=\"unterminated;\n",
+                                     std::string("enum E { A };\0garbage", 22) };
+    // Breaks the schema in a few places, after many complete declarations
+    std::string broken = inputs[0];
+    inputs.push_back(broken.replace(broken.size() / 2, 1, "}"));
+    broken = inputs[0];
+    inputs.push_back(broken.insert(broken.size() * 3 / 4, "\n  data"));
+
+    for (unsigned flags : { 0u, (unsigned)MINISSD_PARSE_ARENA, (unsigned)MINISSD_PARSE_INTERN })
+    {
+        for (const std::string &input : inputs)
+        {
+            Parser *full = minissd_create_parser_n(input.data(), input.size());
+            minissd_set_parser_flags(full, flags);
+            AstNode *expected = minissd_parse(full);
+
+            for (size_t chunk : { (size_t)1, (size_t)7, (size_t)100, input.size() + 1 })
+            {
+                Parser *parser = minissd_create_push_parser();
+                minissd_set_parser_flags(parser, flags);
+                AstNode *ast = nullptr, *last = nullptr;
+                bool ok = true;
+                for (size_t i = 0; ok && i <= input.size(); i += chunk)
+                {
+                    ok = minissd_parser_feed(parser, input.data() + i, std::min(chunk, input.size() - i));
+                    if (ok && i + chunk > input.size())
+                    {
+                        ok = minissd_parser_finish(parser);
+                    }
+                    for (AstNode *node; (node = minissd_parser_next_node(parser));)
+                    {
+                        (last ? last->next : ast) = node;
+                        last = node;
+                    }
+                }
+                ASSERT_EQ(ok, expected != nullptr) << input.substr(0, 80) << " in chunks of " << chunk;
+                if (ok)
+                {
+                    expect_full_parse(ast, input, flags);
+                }
+                else
+                {
+                    ASSERT_STREQ(parser->error, full->error) << input.substr(0, 80) << " in chunks of " << chunk;
+                }
+                minissd_free_ast(ast);
+                minissd_free_parser(parser);
+            }
+            minissd_free_ast(expected);
+            minissd_free_parser(full);
+        }
+    }
+}
+
+TEST(Index, FindsDeclarationsAndImports)
+{
+    const std::string source_code = "import a::b::Thing;\n"
+                                    "import a::b::Color;\n"
+                                    "import util;\n"
+                                    "data Color { x: int };\n"
+                                    "enum Color { Red };\n"
+                                    "enum Kind { A };\n"
+                                    "data Kind { y: int };\n"
+                                    "service Api { fn f(); };\n"
+                                    "data Api { z: int };\n";
+    for (unsigned flags : { 0u, (unsigned)MINISSD_PARSE_ZERO_COPY, (unsigned)MINISSD_PARSE_INTERN })
+    {
+        Parser *parser = minissd_create_parser(source_code.c_str());
+        minissd_set_parser_flags(parser, flags);
+        AstNode *ast = minissd_parse(parser);
+        ASSERT_NE(ast, nullptr);
+        std::vector<AstNode *> nodes = node_list(ast);
+        AstIndex *index = minissd_build_index(ast);
+        ASSERT_NE(index, nullptr);
+
+        ASSERT_EQ(minissd_find_data(index, "Color", 5), nodes[3]);
+        ASSERT_EQ(minissd_find_enum(index, "Color", 5), nodes[4]);
+        ASSERT_EQ(minissd_find_enum(index, "Kind", 4), nodes[5]);
+        ASSERT_EQ(minissd_find_data(index, "Kind", 4), nodes[6]);
+        ASSERT_EQ(minissd_find_service(index, "Api", 3), nodes[7]);
+        ASSERT_EQ(minissd_find_data(index, "Api", 3), nodes[8]);
+        ASSERT_EQ(minissd_find_service(index, "Kind", 4), nullptr);
+        ASSERT_EQ(minissd_find_data(index, "Colo", 4), nullptr);
+
+        // The first declaration of a name wins, declarations over imports
+        ASSERT_EQ(minissd_find_any(index, "Color", 5), nodes[3]);
+        ASSERT_EQ(minissd_find_any(index, "Kind", 4), nodes[5]);
+        ASSERT_EQ(minissd_find_any(index, "Thing", 5), nodes[0]);
+        ASSERT_EQ(minissd_find_any(index, "a::b::Color", 11), nodes[1]);
+        ASSERT_EQ(minissd_find_import(index, "a::b::Thing", 11), nodes[0]);
+        ASSERT_EQ(minissd_find_import(index, "Color", 5), nullptr);
+        ASSERT_EQ(minissd_find_import(index, "util", 4), nodes[2]);
+        ASSERT_EQ(minissd_find_any(index, "b::Thing", 8), nullptr);
+        // Names are compared by length, not up to a terminator
+        ASSERT_EQ(minissd_find_any(index, "Thingamajig", 5), nodes[0]);
+
+        minissd_free_index(index);
+        minissd_free_ast(ast);
+        minissd_free_parser(parser);
+    }
+}
+
+TEST(Index, ManyNames)
+{
+    std::string source_code = tricky_schema(2000);
+    Parser *parser = minissd_create_parser(source_code.c_str());
+    minissd_set_parser_flags(parser, MINISSD_PARSE_ARENA);
+    AstNode *ast = minissd_parse(parser);
+    ASSERT_NE(ast, nullptr);
+    AstIndex *index = minissd_build_index(ast);
+    ASSERT_NE(index, nullptr);
+    for (int i = 0; i < 2000; i += 7)
+    {
+        std::string n = std::to_string(i);
+        AstNode const *data = minissd_find_data(index, ("D" + n).c_str(), n.size() + 1);
+        ASSERT_NE(data, nullptr);
+        ASSERT_EQ(std::string(minissd_get_data_name(data)), "D" + n);
+        ASSERT_EQ(minissd_find_any(index, ("S" + n).c_str(), n.size() + 1)->type, NODE_SERVICE);
+        ASSERT_EQ(minissd_find_enum(index, ("D" + n).c_str(), n.size() + 1), nullptr);
+    }
+    ASSERT_EQ(minissd_find_any(index, "D2000", 5), nullptr);
+    minissd_free_index(index);
+    minissd_free_parser(parser);
+}
+
+TEST(AttributeIndex, FindsEveryKindOfElement)
+{
+    const char *source_code = "#[api, doc] import a::b;\n"
+                              "#[api] data D { #[key] #[key] id: int, #[api(x)] name: string };\n"
+                              "enum E { #[doc] A, B };\n"
+                              "service S {\n"
+                              "    #[api] depends on x::y;\n"
+                              "    #[doc] fn f(#[key] a: int, b: int);\n"
+                              "    event e(#[api] c: int);\n"
+                              "};\n";
+    Parser *parser = minissd_create_parser(source_code);
+    AstNode *ast = minissd_parse(parser);
+    ASSERT_NE(ast, nullptr);
+    std::vector<AstNode *> nodes = node_list(ast);
+    AttributeIndex *index = minissd_build_attribute_index(ast);
+    ASSERT_NE(index, nullptr);
+
+    size_t count = 0;
+    AttributedElement const *all = minissd_attributed_elements(index, &count);
+    ASSERT_EQ(count, 9u);
+    for (size_t i = 0; i < count; i++)
+    {
+        ASSERT_NE(all[i].attributes, nullptr);
+        for (Attribute const *a = all[i].attributes; a; a = a->next)
+        {
+            uint64_t mask = minissd_attribute_mask(a->name, strlen(a->name));
+            ASSERT_EQ(all[i].mask & mask, mask);
+        }
+    }
+
+    AttributedElement const *api = minissd_find_attribute(index, "api", 3, &count);
+    ASSERT_EQ(count, 5u);
+    ASSERT_EQ(api[0].kind, MINISSD_ELEMENT_NODE);
+    ASSERT_EQ(api[0].element, nodes[0]);
+    ASSERT_EQ(api[1].element, nodes[1]);
+    ASSERT_EQ(api[2].kind, MINISSD_ELEMENT_PROPERTY);
+    ASSERT_STREQ(static_cast<Property const *>(api[2].element)->name, "name");
+    ASSERT_EQ(api[2].node, nodes[1]);
+    ASSERT_EQ(api[3].kind, MINISSD_ELEMENT_DEPENDENCY);
+    ASSERT_EQ(api[3].node, nodes[3]);
+    ASSERT_EQ(api[4].kind, MINISSD_ELEMENT_ARGUMENT);
+    ASSERT_STREQ(static_cast<Argument const *>(api[4].element)->name, "c");
+
+    // Repeating an attribute on one element lists the element once
+    AttributedElement const *key = minissd_find_attribute(index, "key", 3, &count);
+    ASSERT_EQ(count, 2u);
+    ASSERT_EQ(key[0].kind, MINISSD_ELEMENT_PROPERTY);
+    ASSERT_EQ(key[1].kind, MINISSD_ELEMENT_ARGUMENT);
+    ASSERT_STREQ(static_cast<Argument const *>(key[1].element)->name, "a");
+
+    AttributedElement const *doc = minissd_find_attribute(index, "doc", 3, &count);
+    ASSERT_EQ(count, 3u);
+    ASSERT_EQ(doc[0].element, nodes[0]);
+    ASSERT_EQ(doc[1].kind, MINISSD_ELEMENT_VARIANT);
+    ASSERT_EQ(doc[2].kind, MINISSD_ELEMENT_HANDLER);
+
+    ASSERT_EQ(minissd_find_attribute(index, "ap", 2, &count), nullptr);
+    ASSERT_EQ(count, 0u);
+    ASSERT_NE(minissd_get_attribute(api[2].attributes, "api", 3), nullptr);
+    ASSERT_EQ(minissd_get_attribute(api[2].attributes, "key", 3), nullptr);
+
+    minissd_free_attribute_index(index);
+    minissd_free_ast(ast);
+    minissd_free_parser(parser);
+}
+
+TEST(AttributeIndex, MaskRulesOutElements)
+{
+    std::string source_code = tricky_schema(500);
+    Parser *parser = minissd_create_parser(source_code.c_str());
+    minissd_set_parser_flags(parser, MINISSD_PARSE_ARENA | MINISSD_PARSE_INTERN);
+    AstNode *ast = minissd_parse(parser);
+    ASSERT_NE(ast, nullptr);
+    AttributeIndex *index = minissd_build_attribute_index(ast);
+    ASSERT_NE(index, nullptr);
+    size_t count = 0;
+    AttributedElement const *all = minissd_attributed_elements(index, &count);
+    ASSERT_GT(count, 0u);
+    const char *names[] = { "doc", "k", "missing" };
+    for (const char *name : names)
+    {
+        size_t length = strlen(name);
+        uint64_t mask = minissd_attribute_mask(name, length);
+        size_t expected = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            bool has = minissd_get_attribute(all[i].attributes, name, length) != nullptr;
+            if (has)
+            {
+                ASSERT_NE(all[i].mask & mask, 0u);
+                expected++;
+            }
+        }
+        size_t found = 0;
+        minissd_find_attribute(index, name, length, &found);
+        ASSERT_EQ(found, expected);
+    }
+    minissd_free_attribute_index(index);
+    minissd_free_parser(parser);
+}
+
+TEST(ResolveTypes, LinksTypesToTheirDeclarations)
+{
+    const char *source_code = "import other::Remote;\n"
+                              "import lib::types;\n"
+                              "data D { a: E, b: list of D, c: 4 of u8, d: Remote, e: lib::types::T };\n"
+                              "enum E { X };\n"
+                              "service S { fn f(x: other::Remote) -> string; event g(y: D); };\n";
+    for (unsigned flags : { 0u, (unsigned)MINISSD_PARSE_ZERO_COPY, (unsigned)MINISSD_PARSE_ARENA })
+    {
+        Parser *parser = minissd_create_parser(source_code);
+        minissd_set_parser_flags(parser, flags);
+        AstNode *ast = minissd_parse(parser);
+        ASSERT_NE(ast, nullptr);
+        std::vector<AstNode *> nodes = node_list(ast);
+        Diagnostics diagnostics = {};
+        ASSERT_TRUE(minissd_resolve_types(ast, &diagnostics));
+        ASSERT_EQ(diagnostics.count, 0u);
+
+        Property const *p = minissd_get_properties(nodes[2]);
+        ASSERT_EQ(minissd_get_type_kind(&p->type), MINISSD_TYPE_ENUM);
+        ASSERT_EQ(minissd_get_type_resolved(&p->type), nodes[3]);
+        p = p->next;
+        ASSERT_EQ(p->type.kind, MINISSD_TYPE_DATA);
+        ASSERT_EQ(p->type.opt_resolved, nodes[2]);
+        p = p->next;
+        ASSERT_EQ(p->type.kind, MINISSD_TYPE_BUILTIN);
+        ASSERT_EQ(minissd_get_type_builtin(&p->type), MINISSD_BUILTIN_U8);
+        ASSERT_EQ(p->type.opt_resolved, nullptr);
+        p = p->next;
+        ASSERT_EQ(p->type.kind, MINISSD_TYPE_IMPORT);
+        ASSERT_EQ(p->type.opt_resolved, nodes[0]);
+        p = p->next;
+        ASSERT_EQ(p->type.kind, MINISSD_TYPE_IMPORT);
+        ASSERT_EQ(p->type.opt_resolved, nodes[1]);
+
+        Handler const *h = minissd_get_handlers(nodes[4]);
+        ASSERT_EQ(h->opt_ll_arguments->type.opt_resolved, nodes[0]);
+        ASSERT_EQ(h->return_type.builtin, MINISSD_BUILTIN_STRING);
+        Event const *e = minissd_get_events(nodes[4]);
+        ASSERT_EQ(e->opt_ll_arguments->type.opt_resolved, nodes[2]);
+
+        minissd_free_diagnostics(&diagnostics);
+        minissd_free_ast(ast);
+        minissd_free_parser(parser);
+    }
+}
+
+TEST(ResolveTypes, ReportsEveryUnresolvedType)
+{
+    const char *source_code = "import lib;\n"
+                              "data D { a: Missing, b: int, c: S, d: li::X };\n"
+                              "service S { fn f(x: Other) -> Missing; };\n";
+    Parser *parser = minissd_create_parser(source_code);
+    AstNode *ast = minissd_parse(parser);
+    ASSERT_NE(ast, nullptr);
+    Diagnostics diagnostics = {};
+    ASSERT_FALSE(minissd_resolve_types(ast, &diagnostics));
+    ASSERT_EQ(diagnostics.count, 5u);
+    ASSERT_EQ(diagnostics.items[0].code, MINISSD_DIAGNOSTIC_UNKNOWN_TYPE);
+    ASSERT_STREQ(diagnostics.items[0].message, "Unknown type 'Missing' in data 'D'");
+    ASSERT_EQ(diagnostics.items[0].node, ast->next);
+    ASSERT_EQ(diagnostics.items[0].element, &minissd_get_properties(ast->next)->type);
+    ASSERT_EQ(diagnostics.items[1].code, MINISSD_DIAGNOSTIC_NOT_A_TYPE);
+    ASSERT_STREQ(diagnostics.items[1].message, "Not a type 'S' in data 'D'");
+    ASSERT_STREQ(diagnostics.items[2].message, "Unknown type 'li::X' in data 'D'");
+    ASSERT_STREQ(diagnostics.items[3].message, "Unknown type 'Other' in service 'S'");
+    ASSERT_STREQ(diagnostics.items[4].message, "Unknown type 'Missing' in service 'S'");
+    ASSERT_EQ(minissd_get_properties(ast->next)->next->type.kind, MINISSD_TYPE_BUILTIN);
+
+    // Diagnostics accumulate over passes until freed
+    ASSERT_FALSE(minissd_resolve_types(ast, &diagnostics));
+    ASSERT_EQ(diagnostics.count, 10u);
+    ASSERT_FALSE(minissd_resolve_types(ast, nullptr));
+    minissd_free_diagnostics(&diagnostics);
+    ASSERT_EQ(diagnostics.count, 0u);
+    minissd_free_ast(ast);
+    minissd_free_parser(parser);
+}
+
+TEST(Validate, AcceptsDistinctNames)
+{
+    const char *source_code = "import a::b; import c::b;\n"
+                              "data D { a: int, b: int };\n"
+                              "enum E { A, B = 5, C, D = 1 };\n"
+                              "service S { fn f(a: int, b: int); fn g(a: int); event f(a: int); };\n";
+    Parser *parser = minissd_create_parser(source_code);
+    AstNode *ast = minissd_parse(parser);
+    ASSERT_NE(ast, nullptr);
+    Diagnostics diagnostics = {};
+    ASSERT_TRUE(minissd_validate(ast, &diagnostics));
+    ASSERT_EQ(diagnostics.count, 0u);
+    minissd_free_ast(ast);
+    minissd_free_parser(parser);
+}
+
+TEST(Validate, CollectsEveryProblem)
+{
+    const char *source_code = "import a::b; import a::b;\n"
+                              "enum MyEnum { Value1, Value2 = 42, Value3, Value4 = 42, Value1 = 7, Value5 = 43 };\n"
+                              "data MyData { field1: string, field2: int, field1: string, field2: int };\n"
+                              "data MyEnum { x: int };\n"
+                              "service S { fn f(a: int, a: int); fn f(); event e(b: int, c: int, b: int); event e(); };\n";
+    Parser *parser = minissd_create_parser(source_code);
+    AstNode *ast = minissd_parse(parser);
+    ASSERT_NE(ast, nullptr);
+    std::vector<AstNode *> nodes = node_list(ast);
+    Diagnostics diagnostics = {};
+    ASSERT_FALSE(minissd_validate(ast, &diagnostics));
+    std::vector<std::string> messages;
+    for (size_t i = 0; i < diagnostics.count; i++)
+    {
+        messages.push_back(diagnostics.items[i].message);
+    }
+    std::vector<std::string> expected = {
+        "Duplicate import 'a::b'",
+        "Duplicate enum value 'Value4' in enum 'MyEnum'",
+        "Duplicate variant 'Value1' in enum 'MyEnum'",
+        "Duplicate enum value 'Value5' in enum 'MyEnum'",
+        "Duplicate property 'field1' in data 'MyData'",
+        "Duplicate property 'field2' in data 'MyData'",
+        "Duplicate declaration 'MyEnum'",
+        "Duplicate argument 'a' in service 'S'",
+        "Duplicate handler 'f' in service 'S'",
+        "Duplicate argument 'b' in service 'S'",
+        "Duplicate event 'e' in service 'S'",
+    };
+    ASSERT_EQ(messages, expected);
+    ASSERT_EQ(diagnostics.items[0].node, nodes[1]);
+    ASSERT_EQ(diagnostics.items[1].code, MINISSD_DIAGNOSTIC_DUPLICATE_VALUE);
+    ASSERT_EQ(diagnostics.items[6].node, nodes[4]);
+    ASSERT_FALSE(minissd_validate(ast, nullptr));
+    minissd_free_diagnostics(&diagnostics);
+    minissd_free_ast(ast);
+    minissd_free_parser(parser);
+}
+
+TEST(Validate, EmptyServiceAndLargeScopes)
+{
+    std::string source_code = "enum Big {";
+    for (int i = 0; i < 1000; i++)
+    {
+        source_code += " V" + std::to_string(i) + (i == 999 ? " = 3," : ",");
+    }
+    source_code += " };\nservice S { fn f(); };";
+    Parser *parser = minissd_create_parser(source_code.c_str());
+    AstNode *ast = minissd_parse(parser);
+    ASSERT_NE(ast, nullptr);
+    Diagnostics diagnostics = {};
+    ASSERT_FALSE(minissd_validate(ast, &diagnostics));
+    ASSERT_EQ(diagnostics.count, 1u);
+    ASSERT_STREQ(diagnostics.items[0].message, "Duplicate enum value 'V999' in enum 'Big'");
+
+    // A service emptied by hand
+    Service *service = &ast->next->node.service_node;
+    Handler *handlers = service->opt_ll_handlers;
+    service->opt_ll_handlers = nullptr;
+    ASSERT_FALSE(minissd_validate(ast, &diagnostics));
+    ASSERT_EQ(diagnostics.count, 3u);
+    ASSERT_EQ(diagnostics.items[2].code, MINISSD_DIAGNOSTIC_EMPTY_SERVICE);
+    ASSERT_STREQ(diagnostics.items[2].message, "Empty service 'S'");
+    service->opt_ll_handlers = handlers;
+
+    minissd_free_diagnostics(&diagnostics);
+    minissd_free_ast(ast);
+    minissd_free_parser(parser);
+}
+
+TEST(EnumTable, EffectiveValues)
+{
+    const char *source_code = "enum MyEnum { Value1, Value2 = 42, Value3, Value4 = 0, Value5 };";
+    Parser *parser = minissd_create_parser(source_code);
+    AstNode *ast = minissd_parse(parser);
+    ASSERT_NE(ast, nullptr);
+    std::vector<int> values;
+    for (EnumVariant const *v = minissd_get_enum_variants(ast); v; v = minissd_get_next_enum_variant(v))
+    {
+        values.push_back(minissd_get_enum_variant_effective_value(v));
+    }
+    ASSERT_EQ(values, std::vector<int>({ 0, 42, 43, 0, 1 }));
+    bool has_value = true;
+    ASSERT_EQ(minissd_get_enum_variant_value(minissd_get_enum_variants(ast), &has_value), 0);
+    ASSERT_FALSE(has_value);
+
+    EnumTable *table = minissd_build_enum_table(ast);
+    ASSERT_NE(table, nullptr);
+    ASSERT_EQ(table->count, 5u);
+    ASSERT_EQ(table->min, 0);
+    ASSERT_EQ(table->max, 43);
+    ASSERT_FALSE(table->unique);
+    ASSERT_FALSE(table->dense);
+    std::vector<std::string> by_value, by_name;
+    for (size_t i = 0; i < table->count; i++)
+    {
+        by_value.push_back(table->by_value[i].name);
+        by_name.push_back(table->by_name[i].name);
+    }
+    ASSERT_EQ(by_value, std::vector<std::string>({ "Value1", "Value4", "Value5", "Value2", "Value3" }));
+    ASSERT_EQ(by_name, std::vector<std::string>({ "Value1", "Value2", "Value3", "Value4", "Value5" }));
+    // Equal values in source order
+    ASSERT_STREQ(minissd_enum_find_value(table, 0)->name, "Value1");
+    ASSERT_EQ(minissd_enum_find_value(table, 43)->value, 43);
+    ASSERT_STREQ(minissd_enum_find_value(table, 1)->name, "Value5");
+    ASSERT_EQ(minissd_enum_find_value(table, 2), nullptr);
+    ASSERT_EQ(minissd_enum_find_value(table, 100), nullptr);
+    ASSERT_EQ(minissd_enum_find_name(table, "Value3", 6)->value, 43);
+    ASSERT_EQ(minissd_enum_find_name(table, "Value", 5), nullptr);
+    ASSERT_EQ(minissd_enum_find_name(table, "Value30", 7), nullptr);
+    minissd_free_enum_table(table);
+
+    ASSERT_EQ(minissd_build_enum_table(nullptr), nullptr);
+    minissd_free_ast(ast);
+    minissd_free_parser(parser);
+}
+
+TEST(EnumTable, DenseTables)
+{
+    std::string source_code = "enum Dense { B = 5, A, D, C }; enum Sparse { X = 1, Y = 3 }; data D { x: int };";
+    Parser *parser = minissd_create_parser(source_code.c_str());
+    minissd_set_parser_flags(parser, MINISSD_PARSE_ZERO_COPY);
+    AstNode *ast = minissd_parse(parser);
+    ASSERT_NE(ast, nullptr);
+    EnumTable *dense = minissd_build_enum_table(ast);
+    ASSERT_TRUE(dense->unique);
+    ASSERT_TRUE(dense->dense);
+    for (int v = 5; v <= 8; v++)
+    {
+        ASSERT_EQ(minissd_enum_find_value(dense, v)->value, v);
+    }
+    ASSERT_EQ(std::string(minissd_enum_find_value(dense, 7)->name, 1), "D");
+    ASSERT_EQ(minissd_enum_find_name(dense, "C", 1)->value, 8);
+    EnumTable *sparse = minissd_build_enum_table(ast->next);
+    ASSERT_TRUE(sparse->unique);
+    ASSERT_FALSE(sparse->dense);
+    ASSERT_EQ(minissd_enum_find_value(sparse, 2), nullptr);
+    ASSERT_EQ(minissd_enum_find_value(sparse, 3)->name_length, 1u);
+    ASSERT_EQ(minissd_build_enum_table(ast->next->next), nullptr);
+    minissd_free_enum_table(dense);
+    minissd_free_enum_table(sparse);
+    minissd_free_ast(ast);
+    minissd_free_parser(parser);
+}
+
+TEST_F(ParserTest, InvalidInput_ImpliedEnumValueOverflows)
+{
+    const char *source_code = "enum E { A = 2147483647, B };";
+    parser = minissd_create_parser(source_code);
+    ast = minissd_parse(parser);
+    ASSERT_EQ(ast, nullptr);
+    ASSERT_STREQ(parser->error, "Error: Integer does not fit into an int at line 1, column 29");
+}
+
+TEST_F(ParserTest, InlineOptionalsNeedNoAllocations)
+{
+    const char *source_code = "data D { a: 4 of int, b: list of int };\n"
+                              "enum E { X = 3, Y };\n"
+                              "service S { fn f(x: int) -> 2 of D; fn g(); };";
+    parser = minissd_create_parser(source_code);
+    minissd_set_parser_flags(parser, MINISSD_PARSE_ZERO_COPY);
+    ast = minissd_parse(parser);
+    ASSERT_NE(ast, nullptr);
+    // Types and integers live in their owner, leaving one allocation per
+    // node, member and argument and the components of the service
+    ASSERT_EQ(parser->allocation_count, 3u + 2u + 2u + 2u + 1u + 1u);
+
+    Property const *a = minissd_get_properties(ast);
+    ASSERT_EQ(minissd_get_property_type(a), &a->type);
+    ASSERT_EQ(*minissd_get_type_count(&a->type), 4);
+    ASSERT_TRUE(a->type.has_count);
+    ASSERT_EQ(minissd_get_type_count(&a->next->type), nullptr);
+    ASSERT_TRUE(minissd_get_type_is_list(&a->next->type));
+
+    bool has_value = false;
+    EnumVariant const *x = minissd_get_enum_variants(ast->next);
+    ASSERT_EQ(minissd_get_enum_variant_value(x, &has_value), 3);
+    ASSERT_TRUE(has_value);
+    ASSERT_EQ(minissd_get_enum_variant_value(x->next, &has_value), 0);
+    ASSERT_FALSE(has_value);
+
+    Handler const *f = minissd_get_handlers(ast->next->next);
+    ASSERT_EQ(*minissd_get_type_count(minissd_get_handler_return_type(f)), 2);
+    ASSERT_EQ(minissd_get_handler_return_type(f->next), nullptr);
+    ASSERT_EQ(minissd_get_argument_type(f->opt_ll_arguments), &f->opt_ll_arguments->type);
+}